@@ -0,0 +1,552 @@
+/******************************************************************************/
+/*                                                                            */
+/* File Name : HW3_Benchmark_D.c                                              */
+/*                                                                            */
+/* Throughput and latency benchmark for my_list.c. Every comma separated      */
+/* option is swept, and every combination is reported as ops/sec together    */
+/* with p50/p99/p999 latency per operation type.                              */
+/*                                                                            */
+/* build : gcc -std=c99 -O2 -o bench HW3_Benchmark_D.c my_list.c -lpthread -lm*/
+/* usage : ./bench [-th=1,2,4] [-dist=uniform,zipf] [-theta=0.99]             */
+/*                 [-read=90] [-size=1000] [-batch=1] [-ops=N]                */
+/*                 [-csv=file] [-json=file] [-seed=N] [-trace=file]           */
+/*                 [-wal=file] [-combine] [-numa=node]                        */
+/*                                                                            */
+/* With -batch above 1 the ops of a batch run together inside list_batch, so  */
+/* latency is only measured per call, on the "batch" line. The lines of the   */
+/* op types then report their count and ops/sec only, with no percentiles.    */
+/* -combine measures the list in flat-combining mode. -numa places the nodes  */
+/* of the list on the given NUMA node, and its batches on the node's CPUs.    */
+/* -wal logs every change of the measured phase into a fresh write-ahead log, */
+/* to measure durable throughput.                                             */
+/* -trace dumps the most recent calls of every thread on exit, my_list.c must */
+/* be built with -DLIST_TRACE. Building it with -DLIST_STATS also prints      */
+/* contention stats after every run.                                          */
+/*                                                                            */
+/******************************************************************************/
+
+#define _GNU_SOURCE
+#include "my_list.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <math.h>
+#include <unistd.h>
+
+#define RED_START 		"\033[1;31m"
+#define GREEN_START 	"\033[1;32m"
+#define COLOR_END 		"\033[0m"
+
+#define MAX_SWEEP		16
+#define MAX_THREADS		1024
+#define MAX_BATCH		1024
+
+// log-linear latency histogram: 2^SUB_BITS buckets per power of two
+#define SUB_BITS		5
+#define SUB_BUCKETS		(1 << SUB_BITS)
+#define NUM_BUCKETS		((64 - SUB_BITS) * SUB_BUCKETS)
+
+enum { B_FIND, B_COMPUTE, B_INSERT, B_REMOVE, B_UPDATE, B_BATCH, B_NUM_OPS };
+
+static const char* op_names[B_NUM_OPS] = { "find", "compute", "insert",
+										   "remove", "update", "batch" };
+
+typedef struct histogram_t{
+	unsigned long long count;
+	unsigned long long sum_ns;
+	unsigned long long buckets[NUM_BUCKETS];
+} histogram;
+
+typedef struct sweep_t{
+	int num;
+	long values[MAX_SWEEP];
+} sweep;
+
+typedef struct run_conf_t{
+	int threads;
+	bool zipf;
+	int read_pct;
+	int size;
+	int batch;
+} run_conf;
+
+typedef struct zipf_table_t{
+	int n;
+	double* cdf;
+} zipf_table;
+
+typedef struct bench_thread_t{
+	const run_conf* 	conf;
+	linked_list_t* 		list;
+	const zipf_table* 	zipf;
+	unsigned long long 	rng;
+	long long 			ops;
+	histogram 			hist[B_NUM_OPS];
+} bench_thread;
+
+static sweep 		g_threads 	= { 4, { 1, 2, 4, 8 } };
+static sweep 		g_sizes 	= { 1, { 1000 } };
+static sweep 		g_reads 	= { 1, { 90 } };
+static sweep 		g_batches 	= { 1, { 1 } };
+static bool 		g_dists[2] 	= { true, false };	// uniform, zipf
+static double 		g_theta 	= 0.99;
+static long long 	g_ops 		= 100000;
+static unsigned long long g_seed = 1;
+static const char* 	g_csv_path 	= NULL;
+static const char* 	g_json_path = NULL;
+static const char* 	g_trace_path = NULL;
+static const char* 	g_wal_path 	= NULL;
+static bool 		g_combine 	= false;
+static int 			g_numa 		= -1;
+
+static int 			g_token = 42;
+
+//*****************************************************************************/
+//---------------------------------<HELPERS>----------------------------------*/
+//*****************************************************************************/
+
+static inline unsigned long long next_rand(unsigned long long* s){
+	unsigned long long x = *s;	// xorshift64*
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*s = x;
+	return x * 0x2545F4914F6CDD1DULL;
+}
+
+static inline double next_unit(unsigned long long* s){
+	return (next_rand(s) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static inline unsigned long long now_ns(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int token_value(void* data){
+	return *(int*)data;
+}
+
+static inline int bucket_of(unsigned long long ns){
+	if(ns < SUB_BUCKETS)
+		return (int)ns;
+	int msb = 63 - __builtin_clzll(ns);
+	int shift = msb - SUB_BITS;
+	return (shift + 1) * SUB_BUCKETS + (int)((ns >> shift) & (SUB_BUCKETS - 1));
+}
+
+static inline unsigned long long bucket_value(int bucket){
+	if(bucket < SUB_BUCKETS)
+		return bucket;
+	int shift = bucket / SUB_BUCKETS - 1;
+	unsigned long long low = (unsigned long long)(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+	return low + ((1ULL << shift) >> 1);	// middle of the bucket
+}
+
+static inline void record(histogram* h, unsigned long long ns){
+	h->count++;
+	h->sum_ns += ns;
+	h->buckets[bucket_of(ns)]++;
+}
+
+static unsigned long long percentile(const histogram* h, double p){
+	unsigned long long target = (unsigned long long)ceil(h->count * p), seen = 0;
+	int i;
+	if(!target)
+		target = 1;
+	for(i=0;i<NUM_BUCKETS;i++){
+		seen += h->buckets[i];
+		if(seen >= target)
+			return bucket_value(i);
+	}
+	return 0;
+}
+
+/**
+ * zipf_init : precomputes the CDF of a Zipfian distribution over n ranks.
+ */
+static bool zipf_init(zipf_table* z, int n, double theta){
+	int i;
+	double sum = 0;
+	z->n = n;
+	z->cdf = malloc(sizeof(double) * n);
+	if(!z->cdf)
+		return false;
+	for(i=0;i<n;i++){
+		sum += 1.0 / pow(i + 1, theta);
+		z->cdf[i] = sum;
+	}
+	for(i=0;i<n;i++)
+		z->cdf[i] /= sum;
+	return true;
+}
+
+static inline int zipf_rank(const zipf_table* z, double u){
+	int lo = 0, hi = z->n - 1;
+	while(lo < hi){
+		int mid = (lo + hi) / 2;
+		if(z->cdf[mid] < u)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/**
+ * pick_key : returns a key in [0, 2*size). Zipfian ranks are scattered over
+ * the key range so the hot keys are not all next to the head of the list.
+ */
+static inline int pick_key(bench_thread* t){
+	int range = 2 * t->conf->size;
+	if(!t->zipf)
+		return (int)(next_rand(&t->rng) % range);
+	long long rank = zipf_rank(t->zipf, next_unit(&t->rng));
+	return (int)((rank * 2654435761LL) % range);
+}
+
+static inline int pick_op(bench_thread* t){
+	int r = (int)(next_rand(&t->rng) % 100);
+	if(r < t->conf->read_pct)
+		return (next_rand(&t->rng) % 4) ? B_FIND : B_COMPUTE;
+	switch(next_rand(&t->rng) % 3){
+	case 0: 	return B_INSERT;
+	case 1: 	return B_REMOVE;
+	default: 	return B_UPDATE;
+	}
+}
+
+//*****************************************************************************/
+//-------------------------------<BENCHMARK>----------------------------------*/
+//*****************************************************************************/
+
+static inline void run_one(linked_list_t* list, int op, int key){
+	int res;
+	switch(op){
+	case B_FIND:	list_find(list, key);							break;
+	case B_COMPUTE:	list_compute(list, key, token_value, &res);		break;
+	case B_INSERT:	list_insert(list, key, &g_token);				break;
+	case B_REMOVE:	list_remove(list, key);							break;
+	case B_UPDATE:	list_update(list, key, &g_token);				break;
+	}
+}
+
+static void* bench_thread_main(void* param){
+	bench_thread* t = (bench_thread*)param;
+	op_t ops[MAX_BATCH];
+	static const int batch_kind[] = { CONTAINS, COMPUTE, INSERT, REMOVE, UPDATE };
+	long long i;
+	int j, batch = t->conf->batch;
+	for(i=0;i<t->ops;i+=batch){
+		if(batch == 1){
+			int op = pick_op(t), key = pick_key(t);
+			unsigned long long start = now_ns();
+			run_one(t->list, op, key);
+			record(&t->hist[op], now_ns() - start);
+			continue;
+		}
+		memset(ops, 0, sizeof(op_t) * batch);
+		for(j=0;j<batch;j++){
+			int op = pick_op(t);
+			t->hist[op].count++;			// counted, not timed
+			ops[j].op = batch_kind[op];
+			ops[j].key = pick_key(t);
+			ops[j].data = &g_token;
+			ops[j].compute_func = token_value;
+		}
+		unsigned long long start = now_ns();
+		list_batch(t->list, batch, ops);
+		record(&t->hist[B_BATCH], now_ns() - start);
+	}
+	return NULL;
+}
+
+/**
+ * prefill : inserts size random keys out of the key range [0, 2*size).
+ */
+static void prefill(linked_list_t* list, int size, unsigned long long seed){
+	int range = 2 * size, i;
+	int* keys = malloc(sizeof(int) * range);
+	if(!keys)
+		return;
+	for(i=0;i<range;i++)
+		keys[i] = i;
+	for(i=range-1;i>0;i--){		// shuffle, so nodes are not allocated in key order
+		int j = (int)(next_rand(&seed) % (i + 1)), tmp = keys[i];
+		keys[i] = keys[j];
+		keys[j] = tmp;
+	}
+	for(i=0;i<size;i++)
+		list_insert(list, keys[i], &g_token);
+	free(keys);
+}
+
+static void write_results(const run_conf* c, double elapsed, histogram* total,
+						  FILE* csv, FILE* json, bool* first_json){
+	int op;
+	unsigned long long all = 0;
+	for(op=0;op<B_NUM_OPS;op++)
+		if(op != B_BATCH)
+			all += total[op].count;
+	fprintf(stdout, "threads=%-4d dist=%-7s read=%3d%% size=%-7d batch=%-4d "
+			"%12.0f ops/sec\n", c->threads, c->zipf ? "zipf" : "uniform",
+			c->read_pct, c->size, c->batch, all / elapsed);
+	for(op=0;op<B_NUM_OPS;op++){
+		histogram* h = &total[op];
+		if(!h->count)
+			continue;
+		double rate = h->count / elapsed;
+		if(c->batch > 1 && op != B_BATCH){	// ran inside a batch, see the header
+			fprintf(stdout, "    %-8s count=%-10llu %.0f ops/sec\n", op_names[op],
+					h->count, rate);
+			if(csv)
+				fprintf(csv, "%d,%s,%.3f,%d,%d,%d,%s,%llu,%.0f,,,,\n",
+						c->threads, c->zipf ? "zipf" : "uniform", c->zipf ? g_theta : 0,
+						c->read_pct, c->size, c->batch, op_names[op], h->count, rate);
+			if(json){
+				fprintf(json, "%s\n  {\"threads\": %d, \"dist\": \"%s\", \"theta\": %.3f, "
+						"\"read_pct\": %d, \"size\": %d, \"batch\": %d, \"op\": \"%s\", "
+						"\"count\": %llu, \"ops_per_sec\": %.0f, \"p50_ns\": null, "
+						"\"p99_ns\": null, \"p999_ns\": null, \"mean_ns\": null}",
+						*first_json ? "" : ",", c->threads, c->zipf ? "zipf" : "uniform",
+						c->zipf ? g_theta : 0, c->read_pct, c->size, c->batch,
+						op_names[op], h->count, rate);
+				*first_json = false;
+			}
+			continue;
+		}
+		unsigned long long p50 = percentile(h, 0.50), p99 = percentile(h, 0.99),
+						   p999 = percentile(h, 0.999);
+		double mean = (double)h->sum_ns / h->count;
+		fprintf(stdout, "    %-8s count=%-10llu p50=%-9llu p99=%-9llu p999=%-9llu "
+				"mean=%.0f ns\n", op_names[op], h->count, p50, p99, p999, mean);
+		if(csv)
+			fprintf(csv, "%d,%s,%.3f,%d,%d,%d,%s,%llu,%.0f,%llu,%llu,%llu,%.0f\n",
+					c->threads, c->zipf ? "zipf" : "uniform", c->zipf ? g_theta : 0,
+					c->read_pct, c->size, c->batch, op_names[op], h->count, rate,
+					p50, p99, p999, mean);
+		if(json){
+			fprintf(json, "%s\n  {\"threads\": %d, \"dist\": \"%s\", \"theta\": %.3f, "
+					"\"read_pct\": %d, \"size\": %d, \"batch\": %d, \"op\": \"%s\", "
+					"\"count\": %llu, \"ops_per_sec\": %.0f, \"p50_ns\": %llu, "
+					"\"p99_ns\": %llu, \"p999_ns\": %llu, \"mean_ns\": %.0f}",
+					*first_json ? "" : ",", c->threads, c->zipf ? "zipf" : "uniform",
+					c->zipf ? g_theta : 0, c->read_pct, c->size, c->batch,
+					op_names[op], h->count, rate, p50, p99, p999, mean);
+			*first_json = false;
+		}
+	}
+}
+
+/**
+ * print_list_stats : prints the contention summary of the list, available
+ * when my_list.c was built with -DLIST_STATS.
+ */
+static void print_list_stats(linked_list_t* list){
+	static const char* lock_names[LIST_LOCK_CLASSES] = { "node", "data", "main" };
+	list_stats_t stats;
+	unsigned long long walks = 0, hops = 0;
+	int i;
+	if(list_stats(list, &stats))
+		return;
+	for(i=0;i<LIST_STATS_BUCKETS;i++){
+		walks += stats.traversal_hist[i];
+		hops += stats.traversal_hist[i] * (i ? 1ULL << (i - 1) : 0);	// lower bound
+	}
+	fprintf(stdout, "    stats    walks=%llu min_avg_len=%llu insert_errors=%llu\n",
+			walks, walks ? hops / walks : 0, stats.op_errors[LIST_OP_INSERT]);
+	for(i=0;i<LIST_LOCK_CLASSES;i++)
+		fprintf(stdout, "    %-8s acquires=%-10llu contended=%-10llu wait=%llu ns\n",
+				lock_names[i], stats.lock_acquires[i], stats.lock_contended[i],
+				stats.lock_wait_ns[i]);
+}
+
+static bool run(const run_conf* c, FILE* csv, FILE* json, bool* first_json){
+	zipf_table zipf = { 0, NULL };
+	histogram total[B_NUM_OPS];
+	int i, op, b;
+	bench_thread* threads = calloc(c->threads, sizeof(*threads));
+	pthread_t* tids = malloc(sizeof(*tids) * c->threads);
+	linked_list_t* list = list_alloc();
+	if(list && g_numa >= 0 && list_set_option(list, LIST_OPT_NUMA_NODE, g_numa)){
+		fprintf(stderr, RED_START ">>>ERROR: no NUMA node %d" COLOR_END "\n", g_numa);
+		list_free(list);
+		list = NULL;
+	}
+	if(!threads || !tids || !list || (c->zipf && !zipf_init(&zipf, 2 * c->size, g_theta))){
+		free(threads);
+		free(tids);
+		list_free(list);
+		return false;
+	}
+	prefill(list, c->size, g_seed);
+	if(g_combine)
+		list_set_option(list, LIST_OPT_COMBINING, 1);
+	if(g_wal_path){
+		unlink(g_wal_path);
+		if(list_wal_attach(list, g_wal_path, 0)){
+			fprintf(stderr, RED_START ">>>ERROR: could not create %s" COLOR_END "\n", g_wal_path);
+			list_free(list);
+			free(zipf.cdf);
+			free(threads);
+			free(tids);
+			return false;
+		}
+	}
+	for(i=0;i<c->threads;i++){
+		threads[i].conf = c;
+		threads[i].list = list;
+		threads[i].zipf = c->zipf ? &zipf : NULL;
+		threads[i].rng = (g_seed + 1) * 0x9E3779B97F4A7C15ULL + i;
+		threads[i].ops = g_ops;
+	}
+	unsigned long long start = now_ns();
+	for(i=0;i<c->threads;i++)
+		pthread_create(&tids[i], NULL, bench_thread_main, &threads[i]);
+	for(i=0;i<c->threads;i++)
+		pthread_join(tids[i], NULL);
+	double elapsed = (now_ns() - start) * 1e-9;
+
+	memset(total, 0, sizeof(total));
+	for(i=0;i<c->threads;i++)
+		for(op=0;op<B_NUM_OPS;op++){
+			total[op].count += threads[i].hist[op].count;
+			total[op].sum_ns += threads[i].hist[op].sum_ns;
+			for(b=0;b<NUM_BUCKETS;b++)
+				total[op].buckets[b] += threads[i].hist[op].buckets[b];
+		}
+	write_results(c, elapsed, total, csv, json, first_json);
+	print_list_stats(list);
+
+	list_free(list);
+	if(g_wal_path)
+		unlink(g_wal_path);
+	free(zipf.cdf);
+	free(threads);
+	free(tids);
+	return true;
+}
+
+//*****************************************************************************/
+//---------------------------------<OPTIONS>----------------------------------*/
+//*****************************************************************************/
+
+static void parseError(){
+	fprintf(stderr, RED_START ">>>Usage: [-th=1,2,4] [-dist=uniform,zipf] [-theta=0.99] "
+			"[-read=90] [-size=1000] [-batch=1] [-ops={ops_per_thread}] "
+			"[-csv={file}] [-json={file}] [-seed={seed}] [-trace={file}] [-wal={file}] [-combine] [-numa={node}]\n");
+	fprintf(stderr, ">>>Parameters: up to %d values per sweep, 0 < threads <= %d, "
+			"0 < batch <= %d, 0 <= read <= 100" COLOR_END "\n",
+			MAX_SWEEP, MAX_THREADS, MAX_BATCH);
+	exit(1);
+}
+
+static void parseSweep(const char* str, sweep* s, long min, long max){
+	char* end;
+	s->num = 0;
+	do{
+		if(s->num == MAX_SWEEP)
+			parseError();
+		long v = strtol(str, &end, 10);
+		if(end == str || v < min || v > max)
+			parseError();
+		s->values[s->num++] = v;
+		str = end + 1;
+	} while(*end == ',');
+	if(*end)
+		parseError();
+}
+
+static void parseOptions(char** options, int size){
+	int i;
+	for(i=0;i<size;++i){
+		char* opt = options[i];
+		if(strncmp(opt, "-th=", 4) == 0)
+			parseSweep(opt + 4, &g_threads, 1, MAX_THREADS);
+		else if(strncmp(opt, "-size=", 6) == 0)
+			parseSweep(opt + 6, &g_sizes, 1, 1 << 28);
+		else if(strncmp(opt, "-read=", 6) == 0)
+			parseSweep(opt + 6, &g_reads, 0, 100);
+		else if(strncmp(opt, "-batch=", 7) == 0)
+			parseSweep(opt + 7, &g_batches, 1, MAX_BATCH);
+		else if(strncmp(opt, "-dist=", 6) == 0){
+			g_dists[0] = strstr(opt + 6, "uniform") != NULL;
+			g_dists[1] = strstr(opt + 6, "zipf") != NULL;
+			if(!g_dists[0] && !g_dists[1])
+				parseError();
+		}
+		else if(strncmp(opt, "-theta=", 7) == 0)
+			g_theta = atof(opt + 7);
+		else if(strncmp(opt, "-ops=", 5) == 0)
+			g_ops = atoll(opt + 5);
+		else if(strncmp(opt, "-seed=", 6) == 0)
+			g_seed = strtoull(opt + 6, NULL, 10);
+		else if(strncmp(opt, "-csv=", 5) == 0)
+			g_csv_path = opt + 5;
+		else if(strncmp(opt, "-json=", 6) == 0)
+			g_json_path = opt + 6;
+		else if(strncmp(opt, "-trace=", 7) == 0)
+			g_trace_path = opt + 7;
+		else if(strncmp(opt, "-wal=", 5) == 0)
+			g_wal_path = opt + 5;
+		else if(strcmp(opt, "-combine") == 0)
+			g_combine = true;
+		else if(strncmp(opt, "-numa=", 6) == 0)
+			g_numa = atoi(opt + 6);
+		else
+			parseError();
+	}
+	if(g_ops <= 0 || g_theta <= 0)
+		parseError();
+}
+
+int main(int argc, char** argv){
+	int d, t, s, r, b;
+	bool first_json = true;
+	FILE *csv = NULL, *json = NULL;
+	parseOptions(argv + 1, argc - 1);
+	if(g_csv_path && !(csv = fopen(g_csv_path, "w")))
+		parseError();
+	if(g_json_path && !(json = fopen(g_json_path, "w")))
+		parseError();
+	if(csv)
+		fprintf(csv, "threads,dist,theta,read_pct,size,batch,op,count,ops_per_sec,"
+				"p50_ns,p99_ns,p999_ns,mean_ns\n");
+	if(json)
+		fprintf(json, "[");
+
+	for(d=0;d<2;d++){
+		if(!g_dists[d])
+			continue;
+		for(s=0;s<g_sizes.num;s++)
+			for(r=0;r<g_reads.num;r++)
+				for(b=0;b<g_batches.num;b++)
+					for(t=0;t<g_threads.num;t++){
+						run_conf c = { (int)g_threads.values[t], d == 1,
+									   (int)g_reads.values[r], (int)g_sizes.values[s],
+									   (int)g_batches.values[b] };
+						if(!run(&c, csv, json, &first_json)){
+							fprintf(stderr, RED_START ">>>ERROR: allocation failed"
+									COLOR_END "\n");
+							return 1;
+						}
+					}
+	}
+
+	if(json){
+		fprintf(json, "\n]\n");
+		fclose(json);
+	}
+	if(csv)
+		fclose(csv);
+	if(g_trace_path && list_trace_dump(g_trace_path)){
+		fprintf(stderr, RED_START ">>>ERROR: could not dump the trace, was my_list.c "
+				"built with -DLIST_TRACE?" COLOR_END "\n");
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,341 @@
+// Offline linearizability checker for histories recorded by list_history.c.
+//
+// Every my_list.h operation touches a single key, so a history is
+// linearizable iff the sub-history of every key is linearizable against a
+// sequential model of one map entry (P-compositionality). Each key is checked
+// with the Wing & Gong search, memoized on (set of linearized ops, state) as
+// done by Lowe and by porcupine.
+//
+// A compute that did not show the data it ran on (answered from a memo, or
+// run by a batch) is checked by its result instead: it must return what a
+// compute of the same function that did show the data returned on the value
+// the model holds, and what the last compute of that function returned
+// since the value was written.
+//
+// build : g++ -std=c++11 -O2 -o lincheck HW3_Linearizability_Checker_E.cpp
+// usage : ./lincheck history_file [-v]
+
+#include <iostream> // Out stuff
+#include <fstream> // File stuff
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <random>
+
+#include <vector> // STL stuff
+#include <map>
+#include <unordered_set>
+#include <algorithm>
+
+extern "C" {
+#include "list_history.h"
+}
+
+using namespace std;
+
+#define RED_START "\033[1;31m"
+#define GREEN_START "\033[1;32m"
+#define COLOR_END "\033[0m"
+
+// result codes of my_list.c the model has to tell apart
+#define NOT_EX_ERROR -5
+#define MISMATCH_ERROR -7
+
+static const char* op_names[] = { "INSERT", "REMOVE", "FIND", "UPDATE", "COMPUTE",
+                                  "UPSERT", "UPDATE_IF", "GET_OR_INSERT" };
+
+struct State{
+  bool present;
+  uint64_t value;
+  uint64_t memo_func;    // the last compute on value, 0 if none
+  int32_t memo_result;
+  bool operator==(const State& o) const {
+    return present == o.present && (!present || (value == o.value &&
+           memo_func == o.memo_func && (!memo_func || memo_result == o.memo_result)));
+  }
+};
+
+// what computes that showed their data returned, by (compute_func, data)
+static map<pair<uint64_t, uint64_t>, int32_t> computed;
+
+// Records what the given compute returned, if it showed its data. A function
+// that returned two results on the same data is not checked on it.
+static void learn(const hist_event_t& e, map<pair<uint64_t, uint64_t>, bool>& unsure){
+  if(e.op != HIST_COMPUTE || e.result != 0 || (e.flags & HIST_F_NO_OUT)) return;
+  pair<uint64_t, uint64_t> at(e.func, e.out);
+  auto found = computed.find(at);
+  if(found == computed.end()){
+    if(!unsure.count(at)) computed[at] = e.computed;
+  }
+  else if(found->second != e.computed){
+    computed.erase(found);
+    unsure[at] = true;
+  }
+}
+
+// Checks what a compute returned on state s, and remembers it in next.
+static bool checkComputed(const hist_event_t& e, const State& s, State& next){
+  if(e.flags & HIST_F_NO_OUT){
+    auto found = computed.find(make_pair(e.func, s.value));
+    if(found != computed.end() && found->second != e.computed) return false;
+  }
+  else if(e.out != s.value) return false;
+  if(s.memo_func == e.func && s.memo_result != e.computed) return false;
+  next.memo_func = e.func;
+  next.memo_result = e.computed;
+  return true;
+}
+
+// Applies e to the sequential model. Returns false if e could not have
+// returned what it did when executed on state s.
+static bool apply(const hist_event_t& e, const State& s, State& next){
+  next = s;
+  next.memo_func = 0;    // kept by the ops that leave the value as it is
+  switch(e.op){
+    case HIST_INSERT:
+      if(s.present) return e.result < 0;
+      next.present = true; next.value = e.data;
+      return e.result == 0;
+    case HIST_REMOVE:
+      if(!s.present) return e.result < 0;
+      next.present = false;
+      return e.result == 0;
+    case HIST_FIND:
+      next.memo_func = s.memo_func;
+      return e.result == (s.present ? 1 : 0);
+    case HIST_UPDATE:
+      if(!s.present) return e.result < 0;
+      next.value = e.data;
+      return e.result == 0;
+    case HIST_COMPUTE:
+      if(!s.present) return e.result < 0;
+      return e.result == 0 && checkComputed(e, s, next);
+    case HIST_UPSERT:
+      next.present = true; next.value = e.data;
+      return e.result == (s.present ? 1 : 0);
+    case HIST_UPDATE_IF:
+      if(!s.present) return e.result == NOT_EX_ERROR;
+      if(s.value != e.expected){
+        next.memo_func = s.memo_func;
+        return e.result == MISMATCH_ERROR;
+      }
+      next.value = e.data;
+      return e.result == 0;
+    case HIST_GET_OR_INSERT:
+      if(s.present){
+        next.memo_func = s.memo_func;
+        return e.result == 1 && e.out == s.value;
+      }
+      next.present = true; next.value = e.out;
+      return e.result == 0;
+  }
+  return false;
+}
+
+struct Entry{
+  int op;        // index into the ops of the key
+  bool is_call;
+  int prev, next;
+  int match;     // the return entry of a call
+};
+
+struct CacheKey{
+  uint64_t h1, h2;
+  State state;
+  bool operator==(const CacheKey& o) const {
+    return h1 == o.h1 && h2 == o.h2 && state == o.state;
+  }
+};
+
+struct CacheHash{
+  size_t operator()(const CacheKey& k) const {
+    return k.h1 ^ (k.state.present ? (k.state.value ^ k.state.memo_func) * 0x9E3779B97F4A7C15ULL + 1
+                                   : 0);
+  }
+};
+
+static vector<uint64_t> zobrist1, zobrist2;
+
+// Wing & Gong search over the history of one key. On failure, stuck is set to
+// the earliest op that was still pending in the deepest linearization found.
+static bool checkKey(const vector<hist_event_t>& ops, int& stuck){
+  int n = ops.size();
+  vector<Entry> entries(2 * n + 1);
+  vector<pair<pair<uint64_t, int>, int> > order; // ((time, is_return), entry)
+  for(int i = 0 ; i < n ; i++){
+    entries[2 * i + 1] = {i, true, 0, 0, 2 * i + 2};
+    entries[2 * i + 2] = {i, false, 0, 0, 0};
+    order.push_back(make_pair(make_pair(ops[i].invoke, 0), 2 * i + 1));
+    order.push_back(make_pair(make_pair(ops[i].response, 1), 2 * i + 2));
+  }
+  sort(order.begin(), order.end()); // calls before returns on equal stamps
+  int last = 0; // entry 0 is the head sentinel
+  for(auto& o : order){
+    entries[last].next = o.second;
+    entries[o.second].prev = last;
+    last = o.second;
+  }
+  entries[last].next = -1;
+
+  auto lift = [&](int call){
+    Entry& c = entries[call];
+    entries[c.prev].next = c.next;
+    if(c.next >= 0) entries[c.next].prev = c.prev;
+    Entry& r = entries[c.match];
+    entries[r.prev].next = r.next;
+    if(r.next >= 0) entries[r.next].prev = r.prev;
+  };
+  auto unlift = [&](int call){
+    Entry& r = entries[entries[call].match];
+    entries[r.prev].next = entries[call].match;
+    if(r.next >= 0) entries[r.next].prev = entries[call].match;
+    Entry& c = entries[call];
+    entries[c.prev].next = call;
+    if(c.next >= 0) entries[c.next].prev = call;
+  };
+
+  unordered_set<CacheKey, CacheHash> cache;
+  vector<pair<int, State> > stack;
+  State state = {false, 0, 0, 0};
+  uint64_t h1 = 0, h2 = 0;
+  size_t deepest = 0;
+  stuck = entries[entries[0].next].op;
+  int entry = entries[0].next;
+  while(entries[0].next >= 0){
+    Entry& e = entries[entry];
+    if(e.is_call){
+      State next;
+      if(apply(ops[e.op], state, next)){
+        CacheKey key = {h1 ^ zobrist1[e.op], h2 ^ zobrist2[e.op], next};
+        if(cache.insert(key).second){
+          stack.push_back(make_pair(entry, state));
+          state = next; h1 = key.h1; h2 = key.h2;
+          lift(entry);
+          if(stack.size() > deepest && entries[0].next >= 0){
+            deepest = stack.size();
+            stuck = entries[entries[0].next].op;
+          }
+          entry = entries[0].next;
+          continue;
+        }
+      }
+      entry = e.next;
+    }
+    else{
+      if(stack.empty()) return false;
+      entry = stack.back().first;
+      state = stack.back().second;
+      stack.pop_back();
+      h1 ^= zobrist1[entries[entry].op];
+      h2 ^= zobrist2[entries[entry].op];
+      unlift(entry);
+      entry = entries[entry].next;
+    }
+  }
+  return true;
+}
+
+static void printOp(const hist_event_t& e){
+  cout << "  [" << e.invoke << ", " << e.response << "] " << op_names[e.op]
+       << "(key=" << e.key << ", data=0x" << hex << e.data;
+  if(e.op == HIST_UPDATE_IF) cout << ", expected=0x" << e.expected;
+  if(e.op == HIST_COMPUTE || e.op == HIST_GET_OR_INSERT){
+    if(e.flags & HIST_F_NO_OUT) cout << ", observed=?";
+    else cout << ", observed=0x" << e.out;
+  }
+  if(e.op == HIST_COMPUTE) cout << ", func=0x" << e.func << dec << ", computed=" << e.computed;
+  cout << dec << ") -> " << e.result << endl;
+}
+
+// Prints the op the search got stuck on, the ops that completed right before
+// it and the ops concurrent with it.
+static void explain(const vector<hist_event_t>& ops, int stuck){
+  const hist_event_t& s = ops[stuck];
+  vector<const hist_event_t*> before, concurrent;
+  for(const hist_event_t& e : ops){
+    if(e.response < s.invoke) before.push_back(&e);
+    else if(&e != &s && e.invoke <= s.response) concurrent.push_back(&e);
+  }
+  sort(before.begin(), before.end(), [](const hist_event_t* a, const hist_event_t* b){
+    return a->response < b->response;
+  });
+  cout << "  no valid linearization reaches past:" << endl;
+  printOp(s);
+  cout << "  last completed ops before it:" << endl;
+  for(size_t i = before.size() > 5 ? before.size() - 5 : 0 ; i < before.size() ; i++)
+    printOp(*before[i]);
+  cout << "  concurrent ops:" << endl;
+  for(size_t i = 0 ; i < concurrent.size() && i < 20 ; i++)
+    printOp(*concurrent[i]);
+}
+
+int main(int argc, char** argv){
+  if(argc < 2 || argc > 3 || (argc == 3 && strcmp(argv[2], "-v"))){
+    cerr << RED_START << ">>>Usage: history_file [-v]" << COLOR_END << endl;
+    return 1;
+  }
+  bool verbose = argc == 3;
+  ifstream in(argv[1], ios::binary);
+  hist_header_t header;
+  if(!in.read((char*)&header, sizeof(header)) || header.magic != HIST_MAGIC ||
+     header.version != HIST_VERSION || header.event_size != sizeof(hist_event_t)){
+    cerr << RED_START << ">>>ERROR: " << argv[1] << " is not a history file" << COLOR_END << endl;
+    return 1;
+  }
+
+  map<int, vector<hist_event_t> > per_key;
+  map<pair<uint64_t, uint64_t>, bool> unsure;
+  size_t total = 0;
+  hist_chunk_t chunk;
+  while(in.read((char*)&chunk, sizeof(chunk))){
+    vector<hist_event_t> events(chunk.count);
+    if(!in.read((char*)events.data(), sizeof(hist_event_t) * chunk.count)){
+      cerr << RED_START << ">>>ERROR: truncated history file" << COLOR_END << endl;
+      return 1;
+    }
+    for(const hist_event_t& e : events){
+      if(e.op > HIST_GET_OR_INSERT || e.response < e.invoke){
+        cerr << RED_START << ">>>ERROR: corrupted event in history file" << COLOR_END << endl;
+        return 1;
+      }
+      per_key[e.key].push_back(e);
+      learn(e, unsure);
+    }
+    total += chunk.count;
+  }
+
+  mt19937_64 rng(0x5EED);
+  size_t longest = 0;
+  for(auto& k : per_key) longest = max(longest, k.second.size());
+  for(size_t i = 0 ; i < longest ; i++){
+    zobrist1.push_back(rng());
+    zobrist2.push_back(rng());
+  }
+
+  int failed = 0;
+  for(auto& k : per_key){
+    vector<hist_event_t>& ops = k.second;
+    sort(ops.begin(), ops.end(), [](const hist_event_t& a, const hist_event_t& b){
+      return a.invoke < b.invoke;
+    });
+    int stuck;
+    bool ok = checkKey(ops, stuck);
+    if(!ok){
+      failed++;
+      cout << RED_START << ">>>NOT LINEARIZABLE: key " << k.first << " (" << ops.size()
+           << " ops)" << COLOR_END << endl;
+      explain(ops, stuck);
+    }
+    else if(verbose)
+      cout << ">>>INFO: key " << k.first << " linearizable (" << ops.size() << " ops)" << endl;
+  }
+
+  if(failed){
+    cout << RED_START << ">>>[Failed] " << failed << " of " << per_key.size()
+         << " keys are not linearizable" << COLOR_END << endl;
+    return 1;
+  }
+  cout << GREEN_START << ">>>[OK] " << total << " ops over " << per_key.size()
+       << " keys are linearizable" << COLOR_END << endl;
+  return 0;
+}
@@ -5,12 +5,17 @@
 #include <cstring>
 #include <random>
 #include <cstdarg> // va va va stuff
+#include <cstdio>
+#include <csignal>
+#include <cstdint>
 
 #include <vector> // STL stuff
 #include <string> // another STL stuff
 #include <map> // another another STL stuff
 #include <unordered_set>
 
+#include "list_replay.h" // stream stuff
+
 using namespace std;
 
 static inline string format(const char* fmt, ...){
@@ -62,6 +67,11 @@ string main_tail = "\n\treturn 0;\n}\n";
 int g_num_of_list_operations = 1000; // Default values
 int g_num_of_threads = 10;  // Default values
 bool isValgrindOn = false;   // Default values
+bool g_stream = false;      // Default values
+string g_stream_path = "";  // Default values, empty pipes into the harness
+long long g_num_of_stream_operations = 1000; // Default values
+int g_key_range = 201;      // Default values, keys -100 to 100
+unsigned int g_seed = 0;    // Default values, 0 is a random seed
 
 // Will be used as MAX_KEY aswell
 #define MAX_OPS_PER_BATCH 100
@@ -374,9 +384,147 @@ void createAndRunNonDeterministicTest(vector<string>& names){
 #define GREEN_START "\033[1;32m"
 #define COLOR_END "\033[0m"
 
+// Stream mode: no C is generated, the ops are written as list_replay.h
+// records to HW3_Replay_Harness_H, with the result every op must have. The
+// expected state is the name of every key in the key range, or -1, in a flat
+// vector, so runs of any length take the memory of the key range only.
+#define STREAM_BUFFER_RECORDS 4096
+#define MAX_KEY_RANGE (1 << 28)
+
+struct FlatState{
+  int min_key;
+  vector<int8_t> names;       // of every key, -1 if absent
+  vector<uint32_t> batch_of;  // the last batch that used the key
+  int size;
+};
+
+FILE* g_stream_out = nullptr;
+vector<replay_record_t> g_stream_buffer;
+
+void flushRecords(){
+  size_t count = g_stream_buffer.size();
+  if(count && fwrite(g_stream_buffer.data(), sizeof(replay_record_t), count, g_stream_out) != count){
+    cerr << RED_START << ">>>ERROR: writing the stream failed" << COLOR_END << endl;
+    exit(1);
+  }
+  g_stream_buffer.clear();
+}
+
+void emitRecord(int key, int op, int name, bool fail){
+  replay_record_t record = {key, (uint8_t)op, (uint8_t)name, (uint16_t)(fail ? REPLAY_F_FAIL : 0)};
+  g_stream_buffer.push_back(record);
+  if(g_stream_buffer.size() == STREAM_BUFFER_RECORDS) flushRecords();
+}
+
+void streamOp(FlatState& state, Operation op, int key, int name){
+  int8_t& current = state.names[key - state.min_key];
+  bool fail = current < 0;
+  switch(op){
+    case Operation::INSERT:
+    fail = !fail;
+    if(!fail){
+      current = name;
+      state.size++;
+    }
+    break;
+    case Operation::REMOVE:
+    if(!fail){
+      current = -1;
+      state.size--;
+    }
+    name = 0;
+    break;
+    case Operation::UPDATE:
+    if(!fail) current = name;
+    break;
+    case Operation::COMPUTE:
+    name = fail ? 0 : current; // the data it must see
+    break;
+    default:
+    name = 0;
+  }
+  emitRecord(key, (int)op, name, fail);
+}
+
+// The ops of a batch are on different keys, so whatever order they run in,
+// their results are the ones of running them one after the other.
+void streamBatch(FlatState& state, uint32_t batch){
+  uniform_int_distribution<int> ops_per_batch(2, max(2, min(g_num_of_threads, g_key_range)));
+  uniform_int_distribution<int> key_rand(0, g_key_range - 1);
+  uniform_int_distribution<int> name_rand(0, REPLAY_NUM_NAMES - 1);
+  uniform_int_distribution<int> op_rand(0, 4);
+  int ops = min(ops_per_batch(rng), g_key_range);
+  emitRecord(ops, REPLAY_BATCH, 0, false);
+  for(int i = 0 ; i < ops ; i++){
+    int index;
+    do{
+      index = key_rand(rng);
+    } while(state.batch_of[index] == batch);
+    state.batch_of[index] = batch;
+    streamOp(state, (Operation)op_rand(rng), state.min_key + index, name_rand(rng));
+  }
+}
+
+void generateStream(FILE* out){
+  uniform_int_distribution<int> key_rand(0, g_key_range - 1);
+  uniform_int_distribution<int> name_rand(0, REPLAY_NUM_NAMES - 1);
+  uniform_int_distribution<int> op_rand(0, 6);
+
+  FlatState state = {-(g_key_range / 2), vector<int8_t>(g_key_range, -1),
+                     vector<uint32_t>(g_key_range, 0), 0};
+  replay_header_t header = {REPLAY_MAGIC, REPLAY_VERSION, sizeof(replay_record_t), (uint32_t)g_key_range};
+  uint32_t batch = 0;
+  g_stream_out = out;
+  g_stream_buffer.reserve(STREAM_BUFFER_RECORDS);
+  if(fwrite(&header, sizeof(header), 1, out) != 1){
+    cerr << RED_START << ">>>ERROR: writing the stream failed" << COLOR_END << endl;
+    exit(1);
+  }
+  for(long long line = 0 ; line < g_num_of_stream_operations ; line++){
+    Operation next_op = (Operation)op_rand(rng);
+    if(next_op == Operation::SIZE)
+      emitRecord(state.size, REPLAY_SIZE, 0, false);
+    else if(next_op == Operation::BATCH)
+      streamBatch(state, ++batch);
+    else
+      streamOp(state, next_op, state.min_key + key_rand(rng), name_rand(rng));
+  }
+  emitRecord(0, REPLAY_END, 0, false);
+  flushRecords();
+}
+
+void createAndRunStream(){
+  signal(SIGPIPE, SIG_IGN); // a harness that fails first is reported by it
+  if(!g_stream_path.empty()){
+    FILE* out = fopen(g_stream_path.c_str(), "wb");
+    if(!out){
+      cerr << RED_START << ">>>ERROR: cannot create " << g_stream_path << COLOR_END << endl;
+      exit(1);
+    }
+    generateStream(out);
+    if(fclose(out)){
+      cerr << RED_START << ">>>ERROR: writing the stream failed" << COLOR_END << endl;
+      exit(1);
+    }
+    return;
+  }
+  if(system("gcc -std=c99 -O2 -o replay.out HW3_Replay_Harness_H.c my_list.c -lpthread"))
+    exit(1);
+  FILE* out = popen(isValgrindOn ? "valgrind --leak-check=full ./replay.out -" : "./replay.out -", "w");
+  if(!out){
+    cerr << RED_START << ">>>ERROR: cannot start the harness" << COLOR_END << endl;
+    exit(1);
+  }
+  generateStream(out);
+  if(pclose(out)) exit(1);
+}
+
 void MyparseError(){
 	cerr << RED_START << ">>>Usage: [-valgrind] [-ops={num_of_ops}] [-th={num_of_threads}]" << endl;
+	cerr << ">>>       [-stream[={stream_file}]] [-keys={key_range}] [-seed={seed}]" << endl;
     cerr << ">>>Parameters: 0 < num_of_ops <= 12000 and 0 < num_of_threads <= 30" << endl;
+    cerr << ">>>With -stream: 0 < num_of_ops, 0 < num_of_threads <= " << REPLAY_MAX_BATCH
+         << " and 0 < key_range <= " << MAX_KEY_RANGE << endl;
    	cerr << ">>>Try again." << COLOR_END << endl;
    	exit(1);
 }
@@ -390,6 +538,9 @@ bool is_number(const std::string& s)
 }
 
 void parseOptions(char** options, int size){
+	for(int i=0;i<size;++i) // the limits depend on it
+		if(string(options[i]).compare(0,7,"-stream") == 0) g_stream = true;
+	int max_threads = g_stream ? REPLAY_MAX_BATCH : 30;
 	for(int i=0;i<size;++i){
 		string optionStr = string(options[i]);
 		if(optionStr.compare(0,4,"-th=") == 0){
@@ -399,26 +550,44 @@ void parseOptions(char** options, int size){
 				cout << MAGENTA_START << ">>>NOTE: num_of_threads is at least 1, changing to 1" << COLOR_END << endl;
 				g_num_of_threads = 1;
 			}
-			if(g_num_of_threads > 30){
-				cout << MAGENTA_START << ">>>NOTE: num_of_threads is at most 30, changing to 30" << COLOR_END << endl;
-				g_num_of_threads = 30;
+			if(g_num_of_threads > max_threads){
+				cout << MAGENTA_START << format(">>>NOTE: num_of_threads is at most %d, changing to %d", max_threads, max_threads) << COLOR_END << endl;
+				g_num_of_threads = max_threads;
 			}
 		}
 		else if(optionStr.compare(0,5,"-ops=") == 0){
 			if(!is_number(optionStr.substr(5))) MyparseError();
-			g_num_of_list_operations = atoi(optionStr.substr(5).c_str());
-			if(g_num_of_list_operations <=0) {
+			g_num_of_stream_operations = strtoll(optionStr.substr(5).c_str(), NULL, 10);
+			if(g_num_of_stream_operations <=0) {
 				cout << MAGENTA_START << ">>>NOTE: num_of_list_operations is at least 1, changing to 1" << COLOR_END << endl;
-				g_num_of_list_operations = 1;
+				g_num_of_stream_operations = 1;
 			}
-			if(g_num_of_list_operations > 12000){
+			if(!g_stream && g_num_of_stream_operations > 12000){
       			cout << MAGENTA_START << ">>>NOTE: num_of_list_operations at most 12000, changing to 12000" << COLOR_END << endl;
-      			g_num_of_list_operations = 12000;
-    		}		
+      			g_num_of_stream_operations = 12000;
+    		}
+			g_num_of_list_operations = (int)min(g_num_of_stream_operations, 12000LL);
 		}
 		else if(optionStr.compare("-valgrind")==0){
 			isValgrindOn = true;
 		}
+		else if(optionStr.compare("-stream")==0){
+			g_stream_path = "";
+		}
+		else if(optionStr.compare(0,8,"-stream=") == 0){
+			g_stream_path = optionStr.substr(8);
+			if(g_stream_path.empty()) MyparseError();
+		}
+		else if(g_stream && optionStr.compare(0,6,"-keys=") == 0){
+			if(!is_number(optionStr.substr(6))) MyparseError();
+			long long keys = strtoll(optionStr.substr(6).c_str(), NULL, 10);
+			if(keys <= 0 || keys > MAX_KEY_RANGE) MyparseError();
+			g_key_range = (int)keys;
+		}
+		else if(optionStr.compare(0,6,"-seed=") == 0){
+			if(!is_number(optionStr.substr(6))) MyparseError();
+			g_seed = (unsigned int)strtoul(optionStr.substr(6).c_str(), NULL, 10);
+		}
 		else{
 			MyparseError();
 		}
@@ -429,6 +598,18 @@ int main(int argc, char **argv){
 	if(argc > 1){
 		parseOptions(argv+1,argc-1);
 	}
+	if(g_seed) rng.seed(g_seed);
+
+  if(g_stream){
+    cout << GREEN_START << format(">>>RUNNING WITH: THREADS = %d, OPS = %lld, KEYS = %d, VALGRIND = %s", g_num_of_threads, g_num_of_stream_operations, g_key_range, isValgrindOn ? "ON" : "OFF") << COLOR_END << endl;
+    if(g_stream_path.empty())
+      cout << GREEN_START << ">>>INFO: Streaming ops into the replay harness - replay.out" << COLOR_END << endl;
+    else
+      cout << GREEN_START << format(">>>INFO: Writing ops to %s, run it with HW3_Replay_Harness_H", g_stream_path.c_str()) << COLOR_END << endl;
+    cout.flush();
+    createAndRunStream();
+    return 0;
+  }
 
 	cout << GREEN_START << format(">>>RUNNING WITH: THREADS = %d, OPS = %d, VALGRIND = %s", g_num_of_threads, g_num_of_list_operations, isValgrindOn ? "ON" : "OFF") << COLOR_END << endl;
 
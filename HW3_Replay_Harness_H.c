@@ -0,0 +1,214 @@
+/******************************************************************************/
+/*                                                                            */
+/* File Name : HW3_Replay_Harness_H.c                                         */
+/*                                                                            */
+/* Runs an op stream of HW3_Random_Test_Generator_B -stream (list_replay.h)   */
+/* against my_list.c and checks every result against the one recorded in the  */
+/* stream. The stream is read through a fixed buffer, so runs of any length   */
+/* take the memory of the list alone, and it can come from a pipe.            */
+/*                                                                            */
+/* build : gcc -std=c99 -O2 -o replay HW3_Replay_Harness_H.c my_list.c        */
+/*             -lpthread                                                      */
+/* usage : ./replay [-skiplist | -blink] {stream_file | -}                    */
+/*                                                                            */
+/******************************************************************************/
+
+#define _GNU_SOURCE
+#include "my_list.h"
+#include "list_replay.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define RED_START 		"\033[1;31m"
+#define GREEN_START 	"\033[1;32m"
+#define COLOR_END 		"\033[0m"
+
+#define READ_RECORDS	4096	// records read from the stream at once
+
+static char* 			g_names[REPLAY_NUM_NAMES] = REPLAY_NAMES;
+static const char* 		g_path = NULL;
+static const char* 		g_backend_names[LIST_BACKENDS] = { "LIST", "SKIPLIST", "BLINK" };
+static int 				g_backend = LIST_BACKEND_LIST;
+
+static replay_record_t 	g_buffer[READ_RECORDS];
+static size_t 			g_next = 0;
+static size_t 			g_filled = 0;
+static unsigned long long g_count = 0;	// records taken so far
+
+static int hash_test(void* data){
+	const char* str = data;
+	unsigned int hash = 7;
+	for( ; *str ; str++)
+		hash = hash * 31 + *str;
+	return (int)hash;
+}
+
+static inline unsigned long long now_ns(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void fail(const char* what){
+	fprintf(stderr, RED_START ">>>ERROR: %s at record %llu" COLOR_END "\n", what, g_count);
+	exit(1);
+}
+
+/**
+ * next_record : takes the next record of the stream. Returns 0 on success,
+ * 1 at the end of the stream.
+ */
+static int next_record(FILE* stream, replay_record_t* record){
+	if(g_next == g_filled){
+		g_filled = fread(g_buffer, sizeof(replay_record_t), READ_RECORDS, stream);
+		g_next = 0;
+		if(!g_filled)
+			return 1;
+	}
+	*record = g_buffer[g_next++];
+	g_count++;
+	if(record->op > REPLAY_END || record->name >= REPLAY_NUM_NAMES)
+		fail("corrupt record");
+	return 0;
+}
+
+/**
+ * check : compares the result of an op with the expected one.
+ */
+static void check(const replay_record_t* record, int res, int computed){
+	int failed = record->flags & REPLAY_F_FAIL;
+	switch(record->op){
+	case REPLAY_CONTAINS:
+		if(res != !failed)
+			fail("wrong list_find result");
+		break;
+	case REPLAY_COMPUTE:
+		if(!failed && computed != hash_test(g_names[record->name]))
+			fail("wrong list_compute value");
+		/* fall through */
+	default:
+		if(failed ? res == 0 : res != 0)
+			fail(failed ? "op succeeded where it should fail" : "op failed");
+	}
+}
+
+/**
+ * run_single : runs a record that is not part of a batch.
+ */
+static void run_single(linked_list_t* list, const replay_record_t* record){
+	void* data = g_names[record->name];
+	int res = 0, computed = 0;
+	switch(record->op){
+	case REPLAY_INSERT:
+		res = list_insert(list, record->key, data);
+		break;
+	case REPLAY_REMOVE:
+		res = list_remove(list, record->key);
+		break;
+	case REPLAY_CONTAINS:
+		res = list_find(list, record->key);
+		break;
+	case REPLAY_UPDATE:
+		res = list_update(list, record->key, data);
+		break;
+	case REPLAY_COMPUTE:
+		res = list_compute(list, record->key, hash_test, &computed);
+		break;
+	case REPLAY_SIZE:
+		if(list_size(list) != record->key)
+			fail("wrong list_size");
+		return;
+	}
+	check(record, res, computed);
+}
+
+/**
+ * run_batch : reads the ops of a batch and runs them with list_batch.
+ */
+static void run_batch(FILE* stream, linked_list_t* list, int num_ops){
+	static replay_record_t 	records[REPLAY_MAX_BATCH];
+	static op_t 			ops[REPLAY_MAX_BATCH];
+	int i;
+	if(num_ops <= 0 || num_ops > REPLAY_MAX_BATCH)
+		fail("bad batch size");
+	for(i=0;i<num_ops;i++){
+		if(next_record(stream, &records[i]))
+			fail("stream ends inside a batch");
+		if(records[i].op > REPLAY_COMPUTE)
+			fail("bad op in a batch");
+		memset(&ops[i], 0, sizeof(op_t));
+		ops[i].key = records[i].key;
+		ops[i].data = g_names[records[i].name];
+		ops[i].op = records[i].op;	// same order as op_t
+		ops[i].compute_func = hash_test;
+	}
+	list_batch(list, num_ops, ops);
+	for(i=0;i<num_ops;i++)
+		check(&records[i], ops[i].result, (int)(long long)ops[i].data);
+}
+
+static void parseError(){
+	fprintf(stderr, RED_START ">>>Usage: [-skiplist | -blink] {stream_file | -}" COLOR_END "\n");
+	exit(1);
+}
+
+static void parseOptions(char** options, int size){
+	int i;
+	for(i=0;i<size;++i){
+		if(strcmp(options[i], "-skiplist") == 0)
+			g_backend = LIST_BACKEND_SKIPLIST;
+		else if(strcmp(options[i], "-blink") == 0)
+			g_backend = LIST_BACKEND_BLINK;
+		else if(!g_path)
+			g_path = options[i];
+		else
+			parseError();
+	}
+	if(!g_path)
+		parseError();
+}
+
+int main(int argc, char** argv){
+	replay_header_t header;
+	replay_record_t record;
+	unsigned long long start;
+	parseOptions(argv + 1, argc - 1);
+	FILE* stream = strcmp(g_path, "-") ? fopen(g_path, "rb") : stdin;
+	if(!stream){
+		fprintf(stderr, RED_START ">>>ERROR: cannot open %s" COLOR_END "\n", g_path);
+		return 1;
+	}
+	if(fread(&header, sizeof(header), 1, stream) != 1 || header.magic != REPLAY_MAGIC ||
+	   header.version != REPLAY_VERSION || header.record_size != sizeof(replay_record_t)){
+		fprintf(stderr, RED_START ">>>ERROR: not a replay stream" COLOR_END "\n");
+		return 1;
+	}
+	linked_list_t* list = list_alloc_backend(g_backend);
+	if(!list){
+		fprintf(stderr, RED_START ">>>ERROR: allocation failed" COLOR_END "\n");
+		return 1;
+	}
+	fprintf(stdout, GREEN_START ">>>RUNNING WITH: KEYS = %u, BACKEND = %s" COLOR_END "\n",
+			header.key_range, g_backend_names[g_backend]);
+	fflush(stdout);
+	start = now_ns();
+	while(1){
+		if(next_record(stream, &record))
+			fail("stream ends without its end record");
+		if(record.op == REPLAY_END)
+			break;
+		if(record.op == REPLAY_BATCH)
+			run_batch(stream, list, record.key);
+		else
+			run_single(list, &record);
+	}
+	fprintf(stdout, ">>>INFO: %llu records in %.3f sec\n", g_count,
+			(double)(now_ns() - start) / 1e9);
+	if(stream != stdin)
+		fclose(stream);
+	list_free(list);
+	fprintf(stdout, GREEN_START ">>>[OK]" COLOR_END "\n");
+	return 0;
+}
@@ -1,8 +1,14 @@
+#define _GNU_SOURCE
 #include "my_list.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <sched.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
 
 #define LIST_FOR_EACH(list) for(int i = 0; i < list_size((list)) ; ++i)
 
@@ -301,6 +307,1014 @@ bool testSequential2(){
 	return true;
 }
 
+bool testUpsert(){
+	linked_list_t* list = list_alloc();
+	void* found = NULL;
+	int result;
+	ASSERT_NON_ZERO(list_upsert(NULL,1984,"Jon"));
+	ASSERT_NON_ZERO(list_upsert(list,1984,NULL));
+	ASSERT_NON_ZERO(list_update_if(list,1984,NULL,"Jon"));
+	ASSERT_NON_ZERO(list_get_or_insert(NULL,1984,"Jon",&found));
+
+	ASSERT_ZERO(list_upsert(list,66,"Jon"));			// inserted
+	ASSERT_TEST(list_upsert(list,66,"Jon Snow") == 1);	// updated
+	ASSERT_TEST(list_size(list) == 1);
+	ASSERT_ZERO(list_compute(list,66,youComputeNothing,&result));
+	ASSERT_TEST(result == 2);
+
+	ASSERT_NON_ZERO(list_update_if(list,66,"Jon","Aegon"));
+	ASSERT_NON_ZERO(list_update_if(list,44,NULL,"Sansa"));
+	found = NULL;
+	ASSERT_TEST(list_get_or_insert(list,66,"Ghost",&found) == 1);
+	ASSERT_ZERO(list_update_if(list,66,found,"Aegon Targaryen"));
+	ASSERT_ZERO(list_compute(list,66,youComputeNothing,&result));
+	ASSERT_TEST(result == 6);
+
+	ASSERT_ZERO(list_get_or_insert(list,44,"Sansa",&found));
+	ASSERT_TEST(strcmp((char*)found,"Sansa") == 0);
+	ASSERT_TEST(list_size(list) == 2);
+
+	op_t ops[3];
+	memset(ops, 0, sizeof(ops));
+	ops[0].key = 11; ops[0].data = "Rickon"; ops[0].op = UPSERT;
+	ops[1].key = 44; ops[1].data = "Arya"; ops[1].op = GET_OR_INSERT;
+	ops[2].key = 66; ops[2].data = "Jon"; ops[2].op = UPDATE_IF;
+	ops[2].expected = "not the data";
+	list_batch(list,3,ops);
+	ASSERT_ZERO(ops[0].result);
+	ASSERT_TEST(ops[1].result == 1);
+	ASSERT_TEST(strcmp((char*)ops[1].data,"Sansa") == 0);
+	ASSERT_NON_ZERO(ops[2].result);
+	ASSERT_TEST(list_size(list) == 3);
+
+	list_free(list);
+	return true;
+}
+
+bool testStats(){
+	linked_list_t* list = list_alloc();
+	list_stats_t stats;
+	ASSERT_NON_ZERO(list_stats(NULL,&stats));
+	ASSERT_NON_ZERO(list_stats(list,NULL));
+	ASSERT_ZERO(list_insert(list,11,"Rickon"));
+	ASSERT_ZERO(list_insert(list,22,"Bran"));
+	ASSERT_NON_ZERO(list_insert(list,22,"Bran"));
+	ASSERT_TEST(list_find(list,22) == 1);
+	if(list_stats(list,&stats) != 0){	// built without -DLIST_STATS
+		list_free(list);
+		return true;
+	}
+	ASSERT_TEST(stats.ops[LIST_OP_INSERT] == 3);
+	ASSERT_TEST(stats.op_errors[LIST_OP_INSERT] == 1);
+	ASSERT_TEST(stats.ops[LIST_OP_FIND] == 1);
+	ASSERT_TEST(stats.lock_acquires[LIST_LOCK_MAIN] == 4);
+	unsigned long long walks = 0;
+	for(int i=0;i<LIST_STATS_BUCKETS;++i)
+		walks += stats.traversal_hist[i];
+	ASSERT_TEST(walks == 4);
+	list_free(list);
+	return true;
+}
+
+
+bool testSnapshot(){
+	static char names[4][16] = { "Rickon", "Bran", "Arya", "Sansa" };
+	const char* path = "HW3_Sequential_Test_A.img";
+	linked_list_t* list = list_alloc();
+	linked_list_t* arr[2];
+	int result;
+	ASSERT_NON_ZERO(list_save(NULL,path,16));
+	ASSERT_TEST(list_load(NULL) == NULL);
+	ASSERT_TEST(list_load("no such snapshot") == NULL);
+	for(int i=0;i<4;++i)
+		ASSERT_ZERO(list_insert(list,(4-i)*11,names[i]));
+
+	ASSERT_ZERO(list_save(list,path,16));			// payloads copied
+	linked_list_t* copy = list_load(path);
+	ASSERT_TEST(copy != NULL);
+	ASSERT_TEST(list_size(copy) == 4);
+	ASSERT_ZERO(list_compute(copy,33,youComputeNothing,&result));
+	ASSERT_TEST(result == 1);
+	ASSERT_ZERO(list_insert(copy,55,"Jon"));
+	ASSERT_ZERO(list_split(copy,2,arr));				// both keep the mapping
+	ASSERT_ZERO(list_compute(arr[1],44,youComputeNothing,&result));
+	ASSERT_TEST(result == 2);
+	list_free(arr[0]);
+	ASSERT_ZERO(list_compute(arr[1],22,youComputeNothing,&result));
+	ASSERT_TEST(result == 2);
+	list_free(arr[1]);
+
+	ASSERT_ZERO(list_save(list,path,0));			// pointers saved as is
+	copy = list_load(path);
+	ASSERT_TEST(copy != NULL);
+	ASSERT_TEST(list_size(copy) == 4);
+	ASSERT_ZERO(list_update_if(copy,11,names[3],"Sansa Stark"));
+	ASSERT_ZERO(list_compute(copy,11,youComputeNothing,&result));
+	ASSERT_TEST(result == 3);
+	list_free(copy);
+
+	FILE* file = fopen(path,"wb");				// not a snapshot
+	ASSERT_TEST(file != NULL);
+	fputs("Winter is coming, and this is no snapshot",file);
+	fclose(file);
+	ASSERT_TEST(list_load(path) == NULL);
+	remove(path);
+	list_free(list);
+	return true;
+}
+
+
+bool testWal(){
+	static char names[5][16] = { "Rickon", "Bran", "Arya", "Sansa", "Jon" };
+	const char* log = "HW3_Sequential_Test_A.wal";
+	const char* snapshot = "HW3_Sequential_Test_A.snap";
+	linked_list_t* list = list_alloc();
+	int result;
+	remove(log);
+	remove(snapshot);
+	ASSERT_NON_ZERO(list_wal_attach(NULL,log,16));
+	ASSERT_NON_ZERO(list_checkpoint(list,snapshot));	// no log attached
+	ASSERT_ZERO(list_wal_attach(list,log,16));
+	ASSERT_NON_ZERO(list_wal_attach(list,log,16));
+	ASSERT_TEST(list_try_insert(list,11,names[0]) == -11);	// waits for the disk
+	for(int i=0;i<4;++i)
+		ASSERT_ZERO(list_insert(list,(i+1)*11,names[i]));
+	ASSERT_ZERO(list_remove(list,11));
+	ASSERT_ZERO(list_update(list,22,names[4]));
+	op_t ops[2];
+	memset(ops, 0, sizeof(ops));
+	ops[0].key = 55; ops[0].data = names[0]; ops[0].op = UPSERT;
+	ops[1].key = 33; ops[1].op = REMOVE;
+	list_batch(list,2,ops);
+	ASSERT_ZERO(ops[0].result);
+	ASSERT_ZERO(ops[1].result);
+	list_free(list);		// everything is on disk already
+
+	list = list_recover(NULL,log,16);
+	ASSERT_TEST(list != NULL);
+	ASSERT_TEST(list_size(list) == 3);		// 22, 44, 55
+	ASSERT_ZERO(list_compute(list,22,youComputeNothing,&result));
+	ASSERT_TEST(result == 1);				// Jon
+	ASSERT_ZERO(list_compute(list,55,youComputeNothing,&result));
+	ASSERT_TEST(result == 2);				// Rickon
+	ASSERT_ZERO(list_checkpoint(list,snapshot));
+	ASSERT_ZERO(list_insert(list,66,names[2]));
+	ASSERT_ZERO(list_remove(list,44));
+	list_free(list);
+
+	FILE* file = fopen(log,"ab");			// a record torn by a crash
+	ASSERT_TEST(file != NULL);
+	fputs("Winter is coming",file);
+	fclose(file);
+	ASSERT_TEST(list_recover(snapshot,log,8) == NULL);	// other payload size
+	list = list_recover(snapshot,log,16);
+	ASSERT_TEST(list != NULL);
+	ASSERT_TEST(list_size(list) == 3);		// 22, 55, 66
+	ASSERT_TEST(list_find(list,44) == 0);
+	ASSERT_ZERO(list_compute(list,66,youComputeNothing,&result));
+	ASSERT_TEST(result == 2);				// Arya
+	ASSERT_TEST(list_upsert(list,22,names[3]) == 1);
+	list_free(list);
+	list = list_recover(snapshot,log,16);
+	ASSERT_TEST(list != NULL);
+	ASSERT_ZERO(list_compute(list,22,youComputeNothing,&result));
+	ASSERT_TEST(result == 2);				// Sansa
+	list_free(list);
+	remove(log);
+	remove(snapshot);
+	return true;
+}
+
+
+static linked_list_t* g_list;
+
+static int removeWhileComputing(void* data){
+	if(list_remove(g_list,7) != 0)	// must not wait for this very compute
+		return -1;
+	return youComputeNothing(data);
+}
+
+bool testRemoveDuringCompute(){
+	int result;
+	g_list = list_alloc();
+	ASSERT_ZERO(list_insert(g_list,7,"Daenerys"));
+	ASSERT_ZERO(list_insert(g_list,8,"Jorah"));
+	ASSERT_ZERO(list_compute(g_list,7,removeWhileComputing,&result));
+	ASSERT_TEST(result == 3);
+	ASSERT_TEST(list_find(g_list,7) == 0);
+	ASSERT_TEST(list_size(g_list) == 1);
+	list_synchronize();
+	for(int i=0;i<200;++i){				// enough retired nodes to recycle them
+		ASSERT_ZERO(list_insert(g_list,i+100,"Hodor"));
+		ASSERT_ZERO(list_remove(g_list,i+100));
+	}
+	ASSERT_TEST(list_size(g_list) == 1);
+	list_free(g_list);
+	return true;
+}
+
+static void batchDone(op_t* ops, int num_ops, void* arg){
+	__atomic_store_n((int*)arg, ops[num_ops-1].result == 0 ? 1 : -1, __ATOMIC_RELEASE);
+}
+
+bool testBatchSubmit(){
+	linked_list_t* list = list_alloc();
+	list_ticket_t* ticket = NULL;
+	int done = 0;
+	op_t ops[4];
+	ASSERT_NON_ZERO(list_batch_submit(NULL,ops,4,&ticket));
+	ASSERT_NON_ZERO(list_batch_submit(list,ops,0,&ticket));
+	ASSERT_NON_ZERO(list_batch_submit_cb(list,ops,4,NULL,NULL));
+	ASSERT_NON_ZERO(list_batch_wait(NULL));
+
+	memset(ops, 0, sizeof(ops));
+	for(int i=0;i<4;++i){
+		ops[i].key = i; ops[i].data = "Bran"; ops[i].op = INSERT;
+	}
+	ASSERT_ZERO(list_batch_submit(list,ops,4,&ticket));
+	ASSERT_ZERO(list_batch_wait(ticket));
+	for(int i=0;i<4;++i)
+		ASSERT_ZERO(ops[i].result);
+	ASSERT_TEST(list_size(list) == 4);
+
+	for(int i=0;i<4;++i){
+		ops[i].op = COMPUTE; ops[i].compute_func = youComputeNothing;
+	}
+	ASSERT_ZERO(list_batch_submit(list,ops,4,&ticket));
+	while(!list_batch_poll(ticket))
+		sched_yield();
+	ASSERT_TEST(list_batch_poll(ticket) == 1);
+	ASSERT_ZERO(list_batch_wait(ticket));
+	for(int i=0;i<4;++i)
+		ASSERT_TEST(ops[i].result == 0 && ops[i].data == (void*)1);
+
+	for(int i=0;i<4;++i)
+		ops[i].op = REMOVE;
+	ASSERT_ZERO(list_batch_submit_cb(list,ops,4,batchDone,&done));
+	while(!__atomic_load_n(&done, __ATOMIC_ACQUIRE))
+		sched_yield();
+	ASSERT_TEST(done == 1);
+	ASSERT_TEST(list_size(list) == 0);
+	list_free(list);
+	return true;
+}
+
+bool testCombining(){
+	linked_list_t* list = list_alloc();
+	linked_list_t* arr[2];
+	void* found = NULL;
+	int result;
+	ASSERT_NON_ZERO(list_set_option(NULL,LIST_OPT_COMBINING,1));
+	ASSERT_NON_ZERO(list_set_option(list,LIST_OPTIONS,1));
+	ASSERT_ZERO(list_set_option(list,LIST_OPT_COMBINING,1));
+
+	ASSERT_ZERO(list_insert(list,3,"Tyrion"));
+	ASSERT_ZERO(list_insert(list,1,"Cersei"));
+	ASSERT_NON_ZERO(list_insert(list,3,"Jaime"));
+	ASSERT_TEST(list_find(list,3) == 1);
+	ASSERT_TEST(list_find(list,2) == 0);
+	ASSERT_ZERO(list_update(list,1,"Tywin"));
+	ASSERT_NON_ZERO(list_update(list,2,"Tywin"));
+	ASSERT_TEST(list_upsert(list,1,"Joffrey") == 1);
+	ASSERT_ZERO(list_upsert(list,2,"Myrcella"));
+	ASSERT_TEST(list_update_if(list,2,"Tommen","Tommen") == -7);
+	ASSERT_TEST(list_get_or_insert(list,2,"Tommen",&found) == 1);
+	ASSERT_ZERO(list_update_if(list,2,found,"Tommen"));
+	ASSERT_ZERO(list_get_or_insert(list,4,"Kevan",&found));
+	ASSERT_TEST(strcmp((char*)found,"Kevan") == 0);
+	ASSERT_ZERO(list_compute(list,2,youComputeNothing,&result));
+	ASSERT_TEST(result == 2);
+	ASSERT_ZERO(list_remove(list,3));
+	ASSERT_NON_ZERO(list_remove(list,3));
+	ASSERT_TEST(list_size(list) == 3);
+
+	ASSERT_ZERO(list_split(list,2,arr));	// the new lists combine too
+	ASSERT_ZERO(list_insert(arr[0],5,"Lancel"));
+	ASSERT_TEST(list_size(arr[0]) == 3);
+	ASSERT_ZERO(list_set_option(arr[1],LIST_OPT_COMBINING,0));
+	ASSERT_ZERO(list_remove(arr[1],2));
+	ASSERT_TEST(list_size(arr[1]) == 0);
+	list_free(arr[0]);
+	list_free(arr[1]);
+	return true;
+}
+
+bool testElimination(){
+	linked_list_t* list = list_alloc();
+	list_ticket_t* ticket;
+	int result;
+	op_t ops[9];
+	ASSERT_ZERO(list_set_option(list,LIST_OPT_ELIMINATION,1));
+	ASSERT_ZERO(list_insert(list,1,"Robb"));
+	ASSERT_ZERO(list_insert(list,2,"Talisa"));
+
+	memset(ops, 0, sizeof(ops));
+	ops[0].key = 5; ops[0].data = "Walder"; ops[0].op = INSERT;
+	ops[1].key = 1; ops[1].data = "Catelyn"; ops[1].op = INSERT;
+	ops[2].key = 5; ops[2].op = REMOVE;						// cancels ops[0]
+	ops[3].key = 1; ops[3].op = REMOVE;
+	ops[4].key = 2; ops[4].data = "Edmure"; ops[4].op = UPDATE;
+	ops[5].key = 1; ops[5].data = "Grey Wind"; ops[5].op = GET_OR_INSERT;
+	ops[6].key = 2; ops[6].data = "Roslin"; ops[6].op = UPDATE;
+	ops[7].key = 2; ops[7].compute_func = youComputeNothing; ops[7].op = COMPUTE;
+	ops[8].key = 5; ops[8].op = CONTAINS;
+	list_batch(list,9,ops);
+	ASSERT_ZERO(ops[0].result);
+	ASSERT_NON_ZERO(ops[1].result);
+	ASSERT_ZERO(ops[2].result);
+	ASSERT_ZERO(ops[3].result);
+	ASSERT_ZERO(ops[4].result);
+	ASSERT_ZERO(ops[5].result);
+	ASSERT_TEST(strcmp((char*)ops[5].data,"Grey Wind") == 0);
+	ASSERT_ZERO(ops[6].result);
+	ASSERT_ZERO(ops[7].result);
+	ASSERT_TEST(ops[8].result == 0);
+	ASSERT_TEST(list_size(list) == 2);
+	ASSERT_ZERO(list_compute(list,2,youComputeNothing,&result));
+	ASSERT_TEST(result == 2);							// "Roslin"
+	ASSERT_ZERO(list_compute(list,1,youComputeNothing,&result));
+	ASSERT_TEST(result == 2);							// "Grey Wind"
+
+	memset(ops, 0, sizeof(ops));
+	ops[0].key = 3; ops[0].data = "Sansa"; ops[0].op = UPSERT;
+	ops[1].key = 3; ops[1].data = "Ramsay"; ops[1].op = UPDATE_IF;
+	ops[1].expected = "Sansa";
+	ops[2].key = 3; ops[2].data = "Theon"; ops[2].op = UPDATE_IF;
+	ops[2].expected = "Sansa";
+	ASSERT_ZERO(list_batch_submit(list,ops,3,&ticket));
+	ASSERT_ZERO(list_batch_wait(ticket));
+	ASSERT_ZERO(ops[0].result);
+	ASSERT_ZERO(ops[1].result);
+	ASSERT_TEST(ops[2].result == -7);
+	ASSERT_ZERO(list_compute(list,3,youComputeNothing,&result));
+	ASSERT_TEST(result == 2);							// "Ramsay"
+	list_free(list);
+	return true;
+}
+
+bool testNuma(){
+	linked_list_t* list = list_alloc();
+	linked_list_t* arr[2];
+	op_t ops[4];
+	cpu_set_t all, mine, after;
+	int i, result;
+	ASSERT_NON_ZERO(list_set_option(list,LIST_OPT_NUMA_NODE,-2));
+	ASSERT_ZERO(list_set_option(list,LIST_OPT_NUMA_NODE,0));	// every machine has it
+	for(i=0;i<1000;++i)
+		ASSERT_ZERO(list_insert(list,i,"Hodor"));
+	for(i=0;i<1000;i+=2)
+		ASSERT_ZERO(list_remove(list,i));
+	for(i=0;i<100;i+=2)								// reuses the freed nodes
+		ASSERT_ZERO(list_upsert(list,i,"Hodor"));
+	list_synchronize();
+	memset(ops, 0, sizeof(ops));
+	for(i=0;i<4;++i){
+		ops[i].key = 2000+i; ops[i].data = "Meera"; ops[i].op = INSERT;
+	}
+	list_batch(list,4,ops);							// on pinned threads
+	for(i=0;i<4;++i)
+		ASSERT_ZERO(ops[i].result);
+	ASSERT_TEST(list_size(list) == 554);
+	ASSERT_ZERO(sched_getaffinity(0,sizeof(all),&all));
+	CPU_ZERO(&mine);
+	CPU_SET(sched_getcpu(),&mine);
+	ASSERT_ZERO(sched_setaffinity(0,sizeof(mine),&mine));
+	ops[0].key = 2000; ops[0].op = CONTAINS;
+	list_batch(list,1,ops);							// inline, the caller stays as it is
+	ASSERT_TEST(ops[0].result == 1);
+	ASSERT_ZERO(sched_getaffinity(0,sizeof(after),&after));
+	ASSERT_TEST(CPU_EQUAL(&mine,&after));
+	ASSERT_ZERO(sched_setaffinity(0,sizeof(all),&all));
+	ASSERT_ZERO(list_compute(list,2001,youComputeNothing,&result));
+	ASSERT_TEST(result == 3);
+	ASSERT_ZERO(list_split(list,2,arr));
+	ASSERT_ZERO(list_set_option(arr[1],LIST_OPT_NUMA_NODE,-1));
+	ASSERT_ZERO(list_insert(arr[0],-1,"Jojen"));
+	ASSERT_ZERO(list_insert(arr[1],-1,"Jojen"));
+	ASSERT_TEST(list_size(arr[0]) + list_size(arr[1]) == 556);
+	list_free(arr[0]);
+	list_free(arr[1]);
+	return true;
+}
+
+bool testPrefetch(){
+	linked_list_t* list = list_alloc();
+	linked_list_t* arr[3];
+	ASSERT_NON_ZERO(list_set_option(list,LIST_OPT_PREFETCH,-1));
+	ASSERT_NON_ZERO(list_set_option(list,LIST_OPT_PREFETCH,3));
+	ASSERT_ZERO(list_set_option(list,LIST_OPT_PREFETCH,2));
+	for(int i=0;i<100;++i)
+		ASSERT_ZERO(list_insert(list,99-i,"Arya"));
+	ASSERT_TEST(list_find(list,98) == 1);
+	ASSERT_ZERO(list_remove(list,98));
+	ASSERT_TEST(list_size(list) == 99);
+	ASSERT_ZERO(list_split(list,3,arr));
+	ASSERT_TEST(list_size(arr[0]) + list_size(arr[1]) + list_size(arr[2]) == 99);
+	ASSERT_ZERO(list_set_option(arr[0],LIST_OPT_PREFETCH,0));
+	ASSERT_TEST(list_find(arr[0],0) == 1);
+	for(int i=0;i<3;++i)
+		list_free(arr[i]);
+	return true;
+}
+
+bool testCompact(){
+	linked_list_t* list = list_alloc();
+	linked_list_t* arr[2];
+	int i, result;
+	ASSERT_TEST(list_compact(list) == 0);
+	for(i=0;i<2000;++i)								// spans several chunks
+		ASSERT_ZERO(list_insert(list,1999-i,i%2 ? "Bran" : "Sansa"));
+	ASSERT_TEST(list_compact(list) == 2000);
+	ASSERT_TEST(list_compact(list) == 0);			// all in place already
+	ASSERT_TEST(list_size(list) == 2000);
+	ASSERT_ZERO(list_compute(list,1998,youComputeNothing,&result));
+	ASSERT_TEST(result == 1);
+	ASSERT_ZERO(list_compute(list,1999,youComputeNothing,&result));
+	ASSERT_TEST(result == 2);
+	for(i=0;i<2000;i+=4)
+		ASSERT_ZERO(list_remove(list,i));
+	for(i=0;i<2000;i+=8)
+		ASSERT_ZERO(list_insert(list,i,"Rickon"));
+	result = list_compact(list);					// only the new nodes move
+	ASSERT_TEST(result > 0 && result < 1750);
+	ASSERT_ZERO(list_update(list,8,"Robb"));
+	ASSERT_ZERO(list_compute(list,8,youComputeNothing,&result));
+	ASSERT_TEST(result == 1);
+	ASSERT_TEST(list_find(list,4) == 0 && list_find(list,5) == 1);
+	ASSERT_TEST(list_size(list) == 1750);
+	list_synchronize();								// frees the old nodes
+	ASSERT_ZERO(list_split(list,2,arr));
+	ASSERT_TEST(list_compact(arr[0]) == 875);		// every other node is gone
+	ASSERT_TEST(list_size(arr[0]) + list_size(arr[1]) == 1750);
+	list_free(arr[0]);
+	list_free(arr[1]);
+	return true;
+}
+
+static int g_release;
+
+static int waitForRelease(void* data){
+	while(!__atomic_load_n(&g_release, __ATOMIC_ACQUIRE))
+		sched_yield();
+	return youComputeNothing(data);
+}
+
+static void* slowCompute(void* res){
+	int result;
+	*(int*)res = list_compute(g_list,5,waitForRelease,&result);
+	return NULL;
+}
+
+static struct timespec* deadlineIn(struct timespec* ts, long ms){
+	clock_gettime(CLOCK_REALTIME, ts);
+	ts->tv_nsec += ms * 1000000;
+	ts->tv_sec += ts->tv_nsec / 1000000000;
+	ts->tv_nsec %= 1000000000;
+	return ts;
+}
+
+bool testDeadlines(){
+	pthread_t slow, blocked;
+	struct timespec deadline;
+	int slow_res = -1, blocked_res = -1, result, tries;
+	g_list = list_alloc();
+	g_release = 0;
+	ASSERT_ZERO(list_set_option(g_list,LIST_OPT_EXCLUSIVE_COMPUTE,1));	// computes hold the data lock
+	for(int i=0;i<10;++i)
+		ASSERT_ZERO(list_insert(g_list,i,"Brienne"));
+	ASSERT_ZERO(list_try_insert(g_list,10,"Podrick"));
+	ASSERT_TEST(list_try_insert(g_list,10,"Podrick") == -3);
+	ASSERT_TEST(list_try_find(g_list,10) == 1);
+	ASSERT_ZERO(list_try_update(g_list,10,"Tormund"));
+	ASSERT_ZERO(list_try_compute(g_list,10,youComputeNothing,&result));
+	ASSERT_TEST(result == 2);
+	ASSERT_NON_ZERO(list_try_compute(g_list,10,NULL,&result));
+	ASSERT_ZERO(list_try_remove(g_list,10));
+	ASSERT_TEST(list_try_remove(g_list,10) == -4);
+
+	ASSERT_ZERO(pthread_create(&slow,NULL,slowCompute,&slow_res));	// keeps 5 busy
+	for(tries=0;tries<1000000;tries++){
+		if(list_try_compute(g_list,5,youComputeNothing,&result) == -12)
+			break;
+		sched_yield();
+	}
+	ASSERT_TEST(list_compute_timed(g_list,5,youComputeNothing,&result,
+								   deadlineIn(&deadline,20)) == -12);
+	ASSERT_TEST(list_find_timed(g_list,9,deadlineIn(&deadline,20)) == 1);
+
+	ASSERT_ZERO(pthread_create(&blocked,NULL,slowCompute,&blocked_res));	// waits on 5
+	for(tries=0;tries<1000000;tries++){									// holding 4 and 5
+		if(list_try_find(g_list,9) == -12)
+			break;
+		sched_yield();
+	}
+	ASSERT_TEST(list_find_timed(g_list,9,deadlineIn(&deadline,20)) == -12);
+	ASSERT_TEST(list_try_update(g_list,7,"Jaime") == -12);
+	ASSERT_TEST(list_try_find(g_list,3) == 1);
+	__atomic_store_n(&g_release, 1, __ATOMIC_RELEASE);
+	pthread_join(slow,NULL);
+	pthread_join(blocked,NULL);
+	ASSERT_TEST(slow_res == 0 && blocked_res == 0);
+	ASSERT_TEST(list_find_timed(g_list,9,deadlineIn(&deadline,0)) == 1);	// free locks are taken anyway
+	ASSERT_TEST(list_update_timed(g_list,7,"Jaime",&deadline) == 0);
+	ASSERT_TEST(list_size(g_list) == 10);
+	list_free(g_list);
+
+	g_list = list_alloc_backend(LIST_BACKEND_BLINK);	// calls enter through the index
+	g_release = 0;
+	ASSERT_ZERO(list_set_option(g_list,LIST_OPT_EXCLUSIVE_COMPUTE,1));
+	ASSERT_ZERO(list_set_option(g_list,LIST_OPT_NUMA_NODE,0));
+	for(int i=0;i<1000;++i)
+		ASSERT_ZERO(list_try_insert(g_list,i,"Brienne"));
+	ASSERT_ZERO(pthread_create(&slow,NULL,slowCompute,&slow_res));
+	ASSERT_ZERO(pthread_create(&blocked,NULL,slowCompute,&blocked_res));
+	for(tries=0;tries<1000000;tries++){
+		if(list_try_find(g_list,5) == -12)
+			break;
+		sched_yield();
+	}
+	ASSERT_TEST(list_try_find(g_list,999) == 1);		// not behind 4 and 5
+	ASSERT_ZERO(list_try_insert(g_list,1000,"Podrick"));
+	ASSERT_ZERO(list_try_remove(g_list,998));
+	__atomic_store_n(&g_release, 1, __ATOMIC_RELEASE);
+	pthread_join(slow,NULL);
+	pthread_join(blocked,NULL);
+	ASSERT_TEST(list_size(g_list) == 1000);
+	list_free(g_list);
+	return true;
+}
+
+bool testCompactDuringCompute(){
+	pthread_t slow;
+	int slow_res = -1, result, tries;
+	g_list = list_alloc();
+	g_release = 0;
+	ASSERT_ZERO(list_set_option(g_list,LIST_OPT_EXCLUSIVE_COMPUTE,1));
+	for(int i=0;i<10;++i)
+		ASSERT_ZERO(list_insert(g_list,i,"Brienne"));
+	ASSERT_ZERO(pthread_create(&slow,NULL,slowCompute,&slow_res));	// keeps 5 busy
+	for(tries=0;tries<1000000;tries++){
+		if(list_try_compute(g_list,5,youComputeNothing,&result) == -12)
+			break;
+		sched_yield();
+	}
+	ASSERT_TEST(list_compact(g_list) == 9);			// 5 stays where it is
+	ASSERT_TEST(list_try_compute(g_list,5,youComputeNothing,&result) == -12);
+	__atomic_store_n(&g_release, 1, __ATOMIC_RELEASE);
+	pthread_join(slow,NULL);
+	ASSERT_ZERO(slow_res);
+	ASSERT_TEST(list_compact(g_list) == 1);
+	ASSERT_ZERO(list_compute(g_list,5,youComputeNothing,&result));
+	ASSERT_TEST(result == 3);
+	list_free(g_list);
+	return true;
+}
+
+bool testExport(){
+	linked_list_t* list = list_alloc();
+	int keys[8];
+	void* data[8];
+	int* all_keys = NULL;
+	void** all_data = NULL;
+	char* names[3] = {"Arya", "Sansa", "Bran"};
+	ASSERT_NON_ZERO(list_export(NULL,keys,data,8));
+	ASSERT_NON_ZERO(list_export(list,keys,data,-1));
+	ASSERT_TEST(list_export(list,keys,data,8) == 0);
+	ASSERT_TEST(list_export_alloc(list,&all_keys,&all_data) == 0);
+	ASSERT_TEST(all_keys == NULL && all_data == NULL);
+	for(int i=0;i<3000;++i)
+		ASSERT_ZERO(list_insert(list,(i*7)%3000,names[i%3]));	// key%3 == i%3
+	ASSERT_TEST(list_export(list,keys,data,8) == 3000);		// only 8 fit
+	for(int i=0;i<8;++i)
+		ASSERT_TEST(keys[i] == i && data[i] == names[i%3]);
+	ASSERT_TEST(list_export(list,NULL,data,2) == 3000);
+	ASSERT_TEST(list_export(list,NULL,NULL,0) == 3000);
+	ASSERT_TEST(list_export_alloc(list,&all_keys,&all_data) == 3000);
+	for(int i=0;i<3000;++i)
+		ASSERT_TEST(all_keys[i] == i && all_data[i] == names[i%3]);
+	free(all_keys);
+	free(all_data);
+	ASSERT_TEST(list_export_alloc(list,&all_keys,NULL) == 3000);
+	ASSERT_TEST(all_keys[2999] == 2999);
+	free(all_keys);
+	list_free(list);
+	return true;
+}
+
+static int g_computes;
+
+static int countingCompute(void* data){
+	__atomic_add_fetch(&g_computes, 1, __ATOMIC_RELAXED);
+	return youComputeNothing(data);
+}
+
+bool testMemoize(){
+	linked_list_t* list = list_alloc();
+	linked_list_t* arr[2];
+	char name[16] = "Samwell";
+	op_t ops[3];
+	int result, computes;
+	g_computes = 0;
+	ASSERT_ZERO(list_insert(list,1,name));
+	ASSERT_ZERO(list_insert(list,2,"Gilly"));
+	ASSERT_ZERO(list_compute(list,1,countingCompute,&result));
+	ASSERT_ZERO(list_compute(list,1,countingCompute,&result));
+	ASSERT_TEST(g_computes == 2);					// off by default
+	ASSERT_ZERO(list_set_option(list,LIST_OPT_MEMOIZE,1));
+	ASSERT_ZERO(list_compute(list,1,countingCompute,&result));
+	ASSERT_ZERO(list_compute(list,1,countingCompute,&result));
+	ASSERT_TEST(g_computes == 3 && result == 2);
+	ASSERT_ZERO(list_compute(list,1,youComputeNothing,&result));
+	ASSERT_ZERO(list_compute(list,1,countingCompute,&result));	// another function
+	ASSERT_TEST(g_computes == 4);
+	strcpy(name, "Samwell Tarly");
+	ASSERT_ZERO(list_update(list,1,name));			// same pointer, new data
+	ASSERT_ZERO(list_compute(list,1,countingCompute,&result));
+	ASSERT_TEST(g_computes == 5 && result == 3);
+	ASSERT_TEST(list_upsert(list,1,name) == 1);
+	ASSERT_ZERO(list_try_compute(list,1,countingCompute,&result));
+	ASSERT_ZERO(list_try_compute(list,1,countingCompute,&result));
+	ASSERT_TEST(g_computes == 6);
+
+	memset(ops, 0, sizeof(ops));					// batches share the memo
+	ops[0].key = 2; ops[0].op = COMPUTE; ops[0].compute_func = countingCompute;
+	ops[1].key = 1; ops[1].op = COMPUTE; ops[1].compute_func = countingCompute;
+	ops[2].key = 1; ops[2].op = UPDATE_IF; ops[2].expected = name; ops[2].data = "Sam";
+	list_batch(list,2,ops);
+	ASSERT_TEST(g_computes == 7 && ops[1].data == (void*)3);
+	ASSERT_ZERO(list_set_option(list,LIST_OPT_ELIMINATION,1));
+	list_batch(list,3,ops);							// the update joins the computes
+	ASSERT_ZERO(ops[2].result);
+	ASSERT_ZERO(list_compute(list,1,countingCompute,&result));
+	ASSERT_TEST(result == 1);
+	ASSERT_ZERO(list_compact(list) < 0);
+	ASSERT_ZERO(list_split(list,2,arr));
+	ASSERT_ZERO(list_compute(arr[0],1,countingCompute,&result));
+	computes = g_computes;
+	ASSERT_ZERO(list_compute(arr[0],1,countingCompute,&result));
+	ASSERT_TEST(g_computes == computes && result == 1);
+	list_free(arr[0]);
+	list_free(arr[1]);
+	return true;
+}
+
+static int incrementShared(void* data){
+	return ++*(int*)data;
+}
+
+/**
+ * fillShared : what the child process of testShared does. Returns 0 if all
+ * of its calls worked.
+ */
+static int fillShared(const char* name){
+	linked_list_t* list = list_open_shared(name, sizeof(int), 0);
+	int i, result, failed = !list;
+	for(i=100;i<200 && !failed;i++)
+		failed = list_insert(list,i,&i) || list_compute(list,i-100,incrementShared,&result);
+	list_free(list);
+	return failed;
+}
+
+bool testShared(){
+	char name[32];
+	int value = 7, result, status, i;
+	void* found;
+	op_t ops[2];
+	pid_t child;
+	snprintf(name, sizeof(name), "/hw3_test_%d", (int)getpid());
+	linked_list_t* list = list_open_shared(name, sizeof(int), 300);
+	ASSERT_NON_ZERO(list);
+	ASSERT_ZERO(list_open_shared(name, sizeof(long long), 300));	// another data size
+	for(i=0;i<100;i++)
+		ASSERT_ZERO(list_insert(list,i,&i));
+	child = fork();
+	if(child == 0)
+		_exit(fillShared(name));
+	ASSERT_TEST(child > 0 && waitpid(child, &status, 0) == child);
+	ASSERT_TEST(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	ASSERT_TEST(list_size(list) == 200);
+	ASSERT_ZERO(list_compute(list,150,incrementShared,&result));
+	ASSERT_TEST(result == 151);
+	ASSERT_ZERO(list_compute(list,50,incrementShared,&result));
+	ASSERT_TEST(result == 52);										// once by the child
+	ASSERT_TEST(list_get_or_insert(list,50,&value,&found) == 1);
+	ASSERT_TEST(*(int*)found == 52);								// zero-copy
+	ASSERT_ZERO(list_update_if(list,50,&value,&value) != -7);
+	value = 52;
+	ASSERT_ZERO(list_update_if(list,50,&value,&value));
+	ASSERT_ZERO(list_remove(list,50));
+	ASSERT_TEST(list_find(list,50) == 0);
+	ASSERT_ZERO(list_insert(list,50,&value));						// reuses the node
+
+	memset(ops, 0, sizeof(ops));
+	ops[0].key = 300; ops[0].op = INSERT; ops[0].data = &value;
+	ops[1].key = 150; ops[1].op = COMPUTE; ops[1].compute_func = incrementShared;
+	list_batch(list,2,ops);
+	ASSERT_TEST(ops[0].result == 0 && ops[1].data == (void*)152);
+
+	ASSERT_TEST(list_set_option(list,LIST_OPT_COMBINING,1) == -11);
+	ASSERT_TEST(list_compact(list) == -11);
+	ASSERT_TEST(list_export(list,NULL,NULL,0) == -11);
+	ASSERT_TEST(list_try_find(list,1) == -11);
+	for(i=201;i<300;i++)
+		ASSERT_ZERO(list_insert(list,i,&i));
+	ASSERT_TEST(list_insert(list,-1,&i) == -2);					// full
+	ASSERT_ZERO(list_unlink_shared(name));
+	ASSERT_TEST(list_size(list) == 300);							// still mapped
+	list_free(list);
+	ASSERT_ZERO(list_unlink_shared(name) == 0);
+	return true;
+}
+
+
+static bool backendCalls(int backend){
+	linked_list_t* list = list_alloc_backend(backend);
+	linked_list_t* arr[3];
+	op_t ops[4];
+	int i, result, size;
+	ASSERT_NON_ZERO(list);
+	for(i=0;i<4000;i+=2)
+		ASSERT_ZERO(list_insert(list,i,"Bran"));
+	for(i=3999;i>0;i-=2)							// between indexed nodes
+		ASSERT_ZERO(list_insert(list,i,"Hodor"));
+	ASSERT_TEST(list_size(list) == 4000);
+	ASSERT_TEST(list_insert(list,2500,"Hodor") == -3);
+	for(i=0;i<4000;i+=3)
+		ASSERT_ZERO(list_remove(list,i));
+	for(i=1;i<4000;i++)
+		ASSERT_TEST(list_find(list,i) == (i % 3 != 0));
+	ASSERT_ZERO(list_insert(list,3,"Summer"));		// a removed key comes back
+	ASSERT_ZERO(list_compute(list,3,youComputeNothing,&result));
+	ASSERT_TEST(result == 2);
+	ASSERT_TEST(list_upsert(list,3,"Hodor") == 1);
+	ASSERT_ZERO(list_update_if(list,3,"Hodor","Meera"));
+
+	memset(ops, 0, sizeof(ops));
+	ops[0].key = 4001; ops[0].op = INSERT; ops[0].data = "Jojen";
+	ops[1].key = 1; ops[1].op = REMOVE;
+	ops[2].key = 3998; ops[2].op = UPDATE; ops[2].data = "Meera";
+	ops[3].key = 4000; ops[3].op = GET_OR_INSERT; ops[3].data = "Osha";
+	list_batch(list,4,ops);
+	for(i=0;i<4;i++)
+		ASSERT_ZERO(ops[i].result);
+	size = list_size(list);
+	ASSERT_TEST(list_compact(list) == size);
+	ASSERT_ZERO(list_remove(list,3));				// after its node moved
+	ASSERT_TEST(list_find(list,3) == 0 && list_find(list,3997) == 1);
+	ASSERT_ZERO(list_split(list,3,arr));
+	for(i=0;i<3;i++){								// the lists keep the index
+		ASSERT_ZERO(list_insert(arr[i],-1,"Rickon"));
+		ASSERT_TEST(list_size(arr[i]) == (size - 1 + 2 - i) / 3 + 1);
+	}
+	ASSERT_TEST(list_find(arr[0],4000) + list_find(arr[1],4000) + list_find(arr[2],4000) == 1);
+	for(i=0;i<3;i++)
+		list_free(arr[i]);
+	return true;
+}
+
+bool testSkipList(){
+	ASSERT_ZERO(list_alloc_backend(LIST_BACKENDS));
+	return backendCalls(LIST_BACKEND_SKIPLIST);
+}
+
+#define WINDOW 64
+
+static void* slideWindow(void* arg){
+	for(int low=1000;low<1000+20000;++low){	// keeps keys low+1 to low+WINDOW
+		list_remove(g_list,low);
+		list_insert(g_list,low+WINDOW,"Hodor");
+	}
+	__atomic_store_n((int*)arg, 1, __ATOMIC_RELEASE);
+	return NULL;
+}
+
+static bool backendExport(int backend){
+	pthread_t writer;
+	int keys[2 * WINDOW], done = 0, i, count;
+	g_list = list_alloc_backend(backend);
+	for(i=0;i<WINDOW;i++)							// where calls enter the window
+		ASSERT_ZERO(list_insert(g_list,i,"Bran"));
+	for(i=0;i<WINDOW;i++)
+		ASSERT_ZERO(list_insert(g_list,1000+i,"Hodor"));
+	ASSERT_ZERO(pthread_create(&writer,NULL,slideWindow,&done));
+	while(!__atomic_load_n(&done, __ATOMIC_ACQUIRE)){	// always a snapshot
+		count = list_export(g_list,keys,NULL,2 * WINDOW) - WINDOW;
+		ASSERT_TEST(count == WINDOW || count == WINDOW - 1);
+		ASSERT_TEST(keys[WINDOW + count - 1] - keys[WINDOW] == count - 1);
+	}
+	pthread_join(writer,NULL);
+	list_free(g_list);
+	return true;
+}
+
+bool testSkipListExport(){
+	return backendExport(LIST_BACKEND_SKIPLIST);
+}
+
+bool testSnapshotWindow(){
+	const char* path = "HW3_Sequential_Test_A.img";
+	pthread_t writer;
+	linked_list_t* copy;
+	int keys[2 * WINDOW], done = 0, i, count;
+	char* data[2 * WINDOW];
+	g_list = list_alloc_backend(LIST_BACKEND_SKIPLIST);
+	for(i=0;i<WINDOW;i++)
+		ASSERT_ZERO(list_insert(g_list,i,"Bran"));
+	for(i=0;i<WINDOW;i++)
+		ASSERT_ZERO(list_insert(g_list,1000+i,"Hodor"));
+	ASSERT_ZERO(pthread_create(&writer,NULL,slideWindow,&done));
+	while(!__atomic_load_n(&done, __ATOMIC_ACQUIRE)){	// saved while it slides
+		ASSERT_ZERO(list_save(g_list,path,5));
+		copy = list_load(path);
+		ASSERT_TEST(copy != NULL);
+		count = list_export(copy,keys,(void**)data,2 * WINDOW) - WINDOW;
+		ASSERT_TEST(count == WINDOW || count == WINDOW - 1);
+		ASSERT_TEST(keys[WINDOW + count - 1] - keys[WINDOW] == count - 1);
+		for(i=0;i<WINDOW+count;i++)
+			ASSERT_TEST(strncmp(data[i], i < WINDOW ? "Bran" : "Hodor", 5) == 0);
+		list_free(copy);
+	}
+	pthread_join(writer,NULL);
+	remove(path);
+	list_free(g_list);
+	return true;
+}
+
+bool testBlinkTree(){
+	linked_list_t* list = list_alloc_backend(LIST_BACKEND_BLINK);
+	int i;
+	ASSERT_NON_ZERO(list);
+	for(i=20000;i>=0;i-=2)							// splits on the left
+		ASSERT_ZERO(list_insert(list,i,"Hodor"));
+	ASSERT_ZERO(list_insert(list,-1000000,"Bran"));
+	ASSERT_ZERO(list_insert(list,1000000,"Bran"));
+	for(i=1;i<20000;i+=2)							// and in between
+		ASSERT_ZERO(list_insert(list,i,"Hodor"));
+	for(i=0;i<20000;i++)
+		if(i % 64 != 7)								// leaves go empty
+			ASSERT_ZERO(list_remove(list,i));
+	for(i=-1;i<=20001;i++)
+		ASSERT_TEST(list_find(list,i) == (i % 64 == 7 || i == 20000));
+	ASSERT_TEST(list_find(list,-1000000) == 1 && list_find(list,1000000) == 1);
+	ASSERT_ZERO(list_remove(list,-1000000));
+	ASSERT_ZERO(list_insert(list,3,"Summer"));		// in an emptied leaf
+	ASSERT_TEST(list_size(list) == 313 + 3);
+	list_free(list);
+	return backendCalls(LIST_BACKEND_BLINK) && backendExport(LIST_BACKEND_BLINK);
+}
+
+static int sleepyCompute(void* data){
+	struct timespec nap = {0, 4000000};	// 4ms, in which the others can run
+	nanosleep(&nap, NULL);
+	return youComputeNothing(data);
+}
+
+static double secondsSince(struct timespec* start){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+bool testBatchStrategies(){
+	linked_list_t* list = list_alloc();
+	op_t ops[2000];
+	struct timespec start;
+	void* vowels = (void*)(long long)youComputeNothing("Arya");
+	int i;
+	memset(ops, 0, sizeof(ops));
+	for(i=0;i<2000;i++){							// on the executor
+		ops[i].key = i; ops[i].data = "Arya"; ops[i].op = INSERT;
+	}
+	list_batch(list,2000,ops);
+	for(i=0;i<2000;i++)
+		ASSERT_ZERO(ops[i].result);
+	ASSERT_TEST(list_size(list) == 2000);
+	for(i=0;i<4;i++){								// inline
+		ops[i].key = 2 * i; ops[i].op = REMOVE;
+	}
+	ops[3].op = CONTAINS; ops[3].key = 0;
+	list_batch(list,4,ops);
+	ASSERT_ZERO(ops[0].result);
+	ASSERT_ZERO(ops[1].result);
+	ASSERT_ZERO(ops[2].result);
+	ASSERT_TEST(ops[3].result == 0 || ops[3].result == 1);	// races the remove
+	ASSERT_TEST(list_size(list) == 1997);
+
+	for(i=0;i<8;i++){
+		ops[i].key = 1 + 2 * i; ops[i].op = COMPUTE; ops[i].compute_func = sleepyCompute;
+	}
+	list_batch(list,8,ops);							// learns how slow they are
+	for(i=0;i<8;i++)
+		ASSERT_TEST(ops[i].result == 0 && ops[i].data == vowels);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	list_batch(list,8,ops);							// a thread each
+	ASSERT_TEST(secondsSince(&start) < 0.024);		// not 8 naps in a row
+	for(i=0;i<8;i++)
+		ASSERT_TEST(ops[i].result == 0 && ops[i].data == vowels);
+	list_free(list);
+	return true;
+}
+
+bool testBatchMulti(){
+	linked_list_t* list = list_alloc();
+	linked_list_t* lists[4];
+	op_t* ops[4];
+	int counts[4] = { 3000, 10, 0, 1 };
+	int i, j;
+	ASSERT_TEST(list_split(list,4,lists) == 0);
+	ASSERT_TEST(list_batch_multi(NULL,4,ops,counts) < 0);
+	ASSERT_TEST(list_batch_multi(lists,0,ops,counts) < 0);
+	ASSERT_TEST(list_batch_multi(lists,4,NULL,counts) < 0);
+	ASSERT_TEST(list_batch_multi(lists,4,ops,NULL) < 0);
+	for(i=0;i<4;i++)
+		ops[i] = counts[i] ? calloc(counts[i], sizeof(op_t)) : NULL;
+	counts[1] = -1;
+	ASSERT_TEST(list_batch_multi(lists,4,ops,counts) < 0);
+	counts[1] = 10;
+	for(i=0;i<4;i++)								// most ops on the first list
+		for(j=0;j<counts[i];j++){
+			ops[i][j].key = j; ops[i][j].data = "Arya"; ops[i][j].op = INSERT;
+		}
+	ops[3][0].key = 5;
+	ASSERT_ZERO(list_batch_multi(lists,4,ops,counts));
+	for(i=0;i<4;i++){
+		for(j=0;j<counts[i];j++)
+			ASSERT_ZERO(ops[i][j].result);
+		ASSERT_TEST(list_size(lists[i]) == counts[i]);
+	}
+	for(i=0;i<4;i++)
+		for(j=0;j<counts[i];j++){
+			ops[i][j].op = j % 2 ? REMOVE : CONTAINS;
+			ops[i][j].key = j % 3 ? j : -1;
+		}
+	ASSERT_ZERO(list_batch_multi(lists,4,ops,counts));
+	for(i=0;i<4;i++)
+		for(j=0;j<counts[i];j++){
+			if(j % 3)
+				ASSERT_TEST(ops[i][j].result == (j % 2 ? 0 : 1));
+			else
+				ASSERT_TEST(j % 2 ? ops[i][j].result < 0 : ops[i][j].result == 0);
+		}
+	ASSERT_TEST(list_size(lists[0]) == 3000 - 1000);
+	ASSERT_TEST(list_size(lists[3]) == 1);
+	for(i=0;i<4;i++){
+		free(ops[i]);
+		list_free(lists[i]);
+	}
+	return true;
+}
+
+static int g_inside, g_most_inside;
+
+static int overlapCompute(void* data){
+	int inside = __atomic_add_fetch(&g_inside, 1, __ATOMIC_ACQ_REL), most;
+	while((most = __atomic_load_n(&g_most_inside, __ATOMIC_RELAXED)) < inside &&
+		  !__atomic_compare_exchange_n(&g_most_inside, &most, inside, 0,
+									   __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+	sleepyCompute(data);
+	sleepyCompute(data);
+	__atomic_sub_fetch(&g_inside, 1, __ATOMIC_ACQ_REL);
+	return youComputeNothing(data);
+}
+
+static void* overlapOnOne(void* res){
+	int result;
+	*(int*)res = list_compute(g_list,1,overlapCompute,&result);
+	return NULL;
+}
+
+static void* keepUpdating(void* arg){
+	for(int i=0;i<20000;++i)
+		list_update(g_list,1,i % 2 ? "Arya" : "Hodor");
+	__atomic_store_n((int*)arg, 1, __ATOMIC_RELEASE);
+	return NULL;
+}
+
+bool testComputeSharing(){
+	pthread_t first, second, writer;
+	int first_res = -1, second_res = -1, done = 0, result;
+	g_list = list_alloc();
+	ASSERT_ZERO(list_insert(g_list,1,"Arya"));
+	for(int exclusive=0;exclusive<=1;++exclusive){
+		ASSERT_ZERO(list_set_option(g_list,LIST_OPT_EXCLUSIVE_COMPUTE,exclusive));
+		g_most_inside = 0;
+		ASSERT_ZERO(pthread_create(&first,NULL,overlapOnOne,&first_res));
+		ASSERT_ZERO(pthread_create(&second,NULL,overlapOnOne,&second_res));
+		pthread_join(first,NULL);
+		pthread_join(second,NULL);
+		ASSERT_TEST(first_res == 0 && second_res == 0);
+		ASSERT_TEST(g_most_inside == (exclusive ? 1 : 2));	// side by side by default
+	}
+	ASSERT_ZERO(list_set_option(g_list,LIST_OPT_EXCLUSIVE_COMPUTE,0));
+	ASSERT_ZERO(pthread_create(&writer,NULL,keepUpdating,&done));
+	while(!__atomic_load_n(&done, __ATOMIC_ACQUIRE)){		// never a torn pointer
+		ASSERT_ZERO(list_compute(g_list,1,youComputeNothing,&result));
+		ASSERT_TEST(result == 2);
+	}
+	pthread_join(writer,NULL);
+	list_free(g_list);
+	return true;
+}
 
 int main(){
 	RUN_TEST(testFreeErrors);
@@ -314,6 +1328,29 @@ int main(){
 	RUN_TEST(testBatchErrors);
 	RUN_TEST(testSequential1);
 	RUN_TEST(testSequential2);
+	RUN_TEST(testUpsert);
+	RUN_TEST(testStats);
+	RUN_TEST(testSnapshot);
+	RUN_TEST(testWal);
+	RUN_TEST(testRemoveDuringCompute);
+	RUN_TEST(testBatchSubmit);
+	RUN_TEST(testCombining);
+	RUN_TEST(testElimination);
+	RUN_TEST(testNuma);
+	RUN_TEST(testPrefetch);
+	RUN_TEST(testCompact);
+	RUN_TEST(testDeadlines);
+	RUN_TEST(testCompactDuringCompute);
+	RUN_TEST(testExport);
+	RUN_TEST(testMemoize);
+	RUN_TEST(testShared);
+	RUN_TEST(testSkipList);
+	RUN_TEST(testSkipListExport);
+	RUN_TEST(testSnapshotWindow);
+	RUN_TEST(testBlinkTree);
+	RUN_TEST(testBatchStrategies);
+	RUN_TEST(testBatchMulti);
+	RUN_TEST(testComputeSharing);
 
 	return 0;
 }
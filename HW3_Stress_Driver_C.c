@@ -0,0 +1,524 @@
+/******************************************************************************/
+/*                                                                            */
+/* File Name : HW3_Stress_Driver_C.c                                          */
+/*                                                                            */
+/* In-process concurrency stress driver for my_list.c. Every thread owns the  */
+/* keys congruent to its id modulo the number of threads, so its results are  */
+/* fully predictable while its traversals still race with all other threads. */
+/* The same seed always produces the same op streams and the same end state.  */
+/* With -history all threads race on all keys instead, and every call is     */
+/* recorded for HW3_Linearizability_Checker_E.                                */
+/*                                                                            */
+/* build : gcc -std=c99 -O2 -o stress HW3_Stress_Driver_C.c list_history.c    */
+/*             my_list.c -lpthread                                            */
+/* usage : ./stress [-ops=N] [-th=N] [-keys=N] [-batch=N] [-seed=N]           */
+/*                  [-history=file] [-combine] [-eliminate] [-compact]        */
+/*                  [-memoize] [-skiplist] [-blink]                           */
+/*                                                                            */
+/* -combine runs the list in flat-combining mode, -eliminate collapses the    */
+/* ops of a batch that share a key, -compact runs list_compact over and over  */
+/* on a background thread while the others work, -memoize caches the results  */
+/* of computes, and -skiplist and -blink run the list on LIST_BACKEND_SKIPLIST */
+/* and LIST_BACKEND_BLINK.                                                    */
+/*                                                                            */
+/******************************************************************************/
+
+#define _GNU_SOURCE
+#include "my_list.h"
+#include "list_history.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#define RED_START 		"\033[1;31m"
+#define GREEN_START 	"\033[1;32m"
+#define COLOR_END 		"\033[0m"
+
+#define MAX_THREADS		1024
+#define MAX_BATCH		64
+#define NUM_TOKENS		256
+#define MAX_REPORTS		10
+#define HIST_CAPACITY	65536
+
+enum { DRV_INSERT, DRV_REMOVE, DRV_FIND, DRV_UPDATE, DRV_COMPUTE, DRV_UPSERT,
+	   DRV_UPDATE_IF, DRV_GET_OR_INSERT, DRV_BATCH, DRV_NUM_OPS };
+
+static const char* drv_names[DRV_NUM_OPS] = { "insert", "remove", "find",
+	"update", "compute", "upsert", "update_if", "get_or_insert", "batch" };
+
+static long long 		g_num_of_ops 	= 1000000;
+static int 				g_num_of_threads = 64;
+static int 				g_num_of_keys 	= 4096;
+static int 				g_max_batch 	= 8;
+static unsigned long long g_seed 		= 0;
+static const char* 		g_history_path 	= NULL;
+static bool 			g_combine 		= false;
+static bool 			g_eliminate 	= false;
+static bool 			g_compact 		= false;
+static bool 			g_memoize 		= false;
+static int 				g_backend 		= LIST_BACKEND_LIST;
+static int 				g_running;
+
+static int 				g_tokens[NUM_TOKENS];
+static linked_list_t* 	g_list;
+static int 				g_reports;
+static pthread_mutex_t 	g_report_lock = PTHREAD_MUTEX_INITIALIZER;
+
+typedef struct thread_ctx_t{
+	int 				id;
+	unsigned long long 	rng;
+	long long 			ops;
+	long long 			failures;
+	int 				num_keys;
+	unsigned char* 		present;	// expected state of the owned keys
+	int* 				value;		// token index of each present key
+	hist_thread_t* 		hist;
+} thread_ctx;
+
+static int token_value(void* data){
+	return *(int*)data;
+}
+
+static int token_negated(void* data){	// so histories mix compute functions
+	return -*(int*)data;
+}
+
+static inline unsigned long long next_rand(unsigned long long* s){
+	unsigned long long x = *s;	// xorshift64*
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*s = x;
+	return x * 0x2545F4914F6CDD1DULL;
+}
+
+static inline unsigned long long mix_seed(unsigned long long x){
+	x += 0x9E3779B97F4A7C15ULL;	// splitmix64
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+	x = x ^ (x >> 31);
+	return x ? x : 1;
+}
+
+static void report(thread_ctx* ctx, long long index, const char* what,
+				   int key, int expected, int actual){
+	ctx->failures++;
+	pthread_mutex_lock(&g_report_lock);
+	if(g_reports++ < MAX_REPORTS)
+		fprintf(stdout, RED_START ">>>MISMATCH: seed=%llu thread=%d op=%lld %s key=%d "
+				"expected=%d actual=%d" COLOR_END "\n",
+				g_seed, ctx->id, index, what, key, expected, actual);
+	pthread_mutex_unlock(&g_report_lock);
+}
+
+#define CHECK(ctx,index,what,key,expected,actual) do { \
+	int e_ = (expected), a_ = (actual); \
+	if ((e_ < 0) != (a_ < 0) || (e_ >= 0 && e_ != a_)) \
+		report((ctx), (index), (what), (key), e_, a_); \
+} while (0)
+
+static inline int owned_key(thread_ctx* ctx, int slot){
+	return slot * g_num_of_threads + ctx->id;
+}
+
+/**
+ * run_single : executes one non-batch operation on a random owned key and
+ * checks its result against the thread's expected state.
+ */
+static void run_single(thread_ctx* ctx, int op, long long index){
+	int slot = (int)(next_rand(&ctx->rng) % ctx->num_keys);
+	int key = owned_key(ctx, slot);
+	int tok = (int)(next_rand(&ctx->rng) % NUM_TOKENS);
+	void* data = &g_tokens[tok];
+	bool present = ctx->present[slot];
+	int res;
+	void* out;
+	switch(op){
+	case DRV_INSERT:
+		CHECK(ctx, index, "insert", key, present ? -1 : 0,
+			  list_insert(g_list, key, data));
+		if(!present){ ctx->present[slot] = 1; ctx->value[slot] = tok; }
+		break;
+	case DRV_REMOVE:
+		CHECK(ctx, index, "remove", key, present ? 0 : -1,
+			  list_remove(g_list, key));
+		ctx->present[slot] = 0;
+		break;
+	case DRV_FIND:
+		CHECK(ctx, index, "find", key, present, list_find(g_list, key));
+		break;
+	case DRV_UPDATE:
+		CHECK(ctx, index, "update", key, present ? 0 : -1,
+			  list_update(g_list, key, data));
+		if(present) ctx->value[slot] = tok;
+		break;
+	case DRV_COMPUTE:
+		res = -1;
+		CHECK(ctx, index, "compute", key, present ? 0 : -1,
+			  list_compute(g_list, key, token_value, &res));
+		if(present)
+			CHECK(ctx, index, "compute value", key, ctx->value[slot], res);
+		break;
+	case DRV_UPSERT:
+		CHECK(ctx, index, "upsert", key, present ? 1 : 0,
+			  list_upsert(g_list, key, data));
+		ctx->present[slot] = 1;
+		ctx->value[slot] = tok;
+		break;
+	case DRV_UPDATE_IF:
+		if(present && (next_rand(&ctx->rng) & 1)){	// expect a match
+			CHECK(ctx, index, "update_if", key, 0, list_update_if(g_list, key,
+					&g_tokens[ctx->value[slot]], data));
+			ctx->value[slot] = tok;
+		}
+		else{
+			void* expected = &g_tokens[(tok + 1) % NUM_TOKENS];
+			bool match = present && ctx->value[slot] == (tok + 1) % NUM_TOKENS;
+			CHECK(ctx, index, "update_if", key, match ? 0 : -1,
+				  list_update_if(g_list, key, expected, data));
+			if(match) ctx->value[slot] = tok;
+		}
+		break;
+	case DRV_GET_OR_INSERT:
+		out = NULL;
+		CHECK(ctx, index, "get_or_insert", key, present ? 1 : 0,
+			  list_get_or_insert(g_list, key, data, &out));
+		if(!present){ ctx->present[slot] = 1; ctx->value[slot] = tok; }
+		CHECK(ctx, index, "get_or_insert value", key, ctx->value[slot],
+			  out ? token_value(out) : -1);
+		break;
+	}
+}
+
+/**
+ * run_batch : executes a batch of operations on distinct owned keys, so the
+ * outcome of every op is predictable regardless of the order they run in.
+ */
+static void run_batch(thread_ctx* ctx, long long index){
+	op_t ops[MAX_BATCH];
+	int slots[MAX_BATCH], toks[MAX_BATCH];
+	int n = 1 + (int)(next_rand(&ctx->rng) % g_max_batch), i, j;
+	if(n > ctx->num_keys)
+		n = ctx->num_keys;
+	memset(ops, 0, sizeof(ops));
+	for(i=0;i<n;i++){
+		do{
+			slots[i] = (int)(next_rand(&ctx->rng) % ctx->num_keys);
+			for(j=0;j<i && slots[j] != slots[i];j++);
+		} while(j < i);
+		toks[i] = (int)(next_rand(&ctx->rng) % NUM_TOKENS);
+		ops[i].key = owned_key(ctx, slots[i]);
+		ops[i].data = &g_tokens[toks[i]];
+		ops[i].compute_func = token_value;
+		switch(next_rand(&ctx->rng) % 6){
+		case 0: ops[i].op = INSERT; 	break;
+		case 1: ops[i].op = REMOVE; 	break;
+		case 2: ops[i].op = CONTAINS; 	break;
+		case 3: ops[i].op = UPDATE; 	break;
+		case 4: ops[i].op = COMPUTE; 	break;
+		default: ops[i].op = UPSERT; 	break;
+		}
+	}
+	list_batch(g_list, n, ops);
+	for(i=0;i<n;i++){
+		int slot = slots[i], key = ops[i].key;
+		bool present = ctx->present[slot];
+		switch(ops[i].op){
+		case INSERT:
+			CHECK(ctx, index, "batch insert", key, present ? -1 : 0, ops[i].result);
+			if(!present){ ctx->present[slot] = 1; ctx->value[slot] = toks[i]; }
+			break;
+		case REMOVE:
+			CHECK(ctx, index, "batch remove", key, present ? 0 : -1, ops[i].result);
+			ctx->present[slot] = 0;
+			break;
+		case CONTAINS:
+			CHECK(ctx, index, "batch contains", key, present, ops[i].result);
+			break;
+		case UPDATE:
+			CHECK(ctx, index, "batch update", key, present ? 0 : -1, ops[i].result);
+			if(present) ctx->value[slot] = toks[i];
+			break;
+		case COMPUTE:
+			CHECK(ctx, index, "batch compute", key, present ? 0 : -1, ops[i].result);
+			if(present)
+				CHECK(ctx, index, "batch compute value", key, ctx->value[slot],
+					  (int)(long long)ops[i].data);
+			break;
+		default:
+			CHECK(ctx, index, "batch upsert", key, present ? 1 : 0, ops[i].result);
+			ctx->present[slot] = 1;
+			ctx->value[slot] = toks[i];
+			break;
+		}
+	}
+}
+
+static void* stress_thread(void* param){
+	thread_ctx* ctx = (thread_ctx*)param;
+	long long i;
+	for(i=0;i<ctx->ops;i++){
+		int op = (int)(next_rand(&ctx->rng) % DRV_NUM_OPS);
+		if(op == DRV_BATCH)
+			run_batch(ctx, i);
+		else
+			run_single(ctx, op, i);
+	}
+	return NULL;
+}
+
+/**
+ * history_thread : races on the whole key range, including conflicting ops
+ * inside the same batch. Results cannot be predicted here, so every call is
+ * recorded and checked offline for linearizability instead.
+ */
+static void* history_thread(void* param){
+	static const int batch_kinds[] = { INSERT, REMOVE, CONTAINS, UPDATE, COMPUTE,
+									   UPSERT, UPDATE_IF, GET_OR_INSERT };
+	thread_ctx* ctx = (thread_ctx*)param;
+	op_t ops[MAX_BATCH];
+	long long i;
+	int j, n, res;
+	for(i=0;i<ctx->ops;i++){
+		int op = (int)(next_rand(&ctx->rng) % DRV_NUM_OPS);
+		int key = (int)(next_rand(&ctx->rng) % g_num_of_keys);
+		void* data = &g_tokens[next_rand(&ctx->rng) % NUM_TOKENS];
+		void* expected = &g_tokens[next_rand(&ctx->rng) % NUM_TOKENS];
+		switch(op){
+		case DRV_INSERT:	hist_insert(ctx->hist, g_list, key, data);		break;
+		case DRV_REMOVE:	hist_remove(ctx->hist, g_list, key);			break;
+		case DRV_FIND:		hist_find(ctx->hist, g_list, key);				break;
+		case DRV_UPDATE:	hist_update(ctx->hist, g_list, key, data);		break;
+		case DRV_UPSERT:	hist_upsert(ctx->hist, g_list, key, data);		break;
+		case DRV_COMPUTE:
+			hist_compute(ctx->hist, g_list, key,
+						 (next_rand(&ctx->rng) & 1) ? token_value : token_negated, &res);
+			break;
+		case DRV_UPDATE_IF:
+			hist_update_if(ctx->hist, g_list, key, expected, data);
+			break;
+		case DRV_GET_OR_INSERT:
+			hist_get_or_insert(ctx->hist, g_list, key, data, NULL);
+			break;
+		case DRV_BATCH:
+			n = 1 + (int)(next_rand(&ctx->rng) % g_max_batch);
+			memset(ops, 0, sizeof(op_t) * n);
+			for(j=0;j<n;j++){
+				ops[j].op = batch_kinds[next_rand(&ctx->rng) % 8];
+				ops[j].key = (int)(next_rand(&ctx->rng) % g_num_of_keys);
+				ops[j].data = &g_tokens[next_rand(&ctx->rng) % NUM_TOKENS];
+				ops[j].expected = &g_tokens[next_rand(&ctx->rng) % NUM_TOKENS];
+				ops[j].compute_func = (next_rand(&ctx->rng) & 1) ? token_value : token_negated;
+			}
+			hist_batch(ctx->hist, g_list, n, ops);
+			break;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * verify_final_state : checks that the list holds exactly the keys and values
+ * every thread expects. Per-key mismatches are counted by the owning thread,
+ * the returned value only counts a size mismatch.
+ */
+static long long verify_final_state(thread_ctx* ctxs){
+	long long failures = 0, expected_size = 0;
+	int t, slot, res;
+	for(t=0;t<g_num_of_threads;t++){
+		thread_ctx* ctx = &ctxs[t];
+		for(slot=0;slot<ctx->num_keys;slot++){
+			int key = owned_key(ctx, slot);
+			CHECK(ctx, -1, "final find", key, ctx->present[slot],
+				  list_find(g_list, key));
+			if(ctx->present[slot]){
+				expected_size++;
+				res = -1;
+				list_compute(g_list, key, token_value, &res);
+				CHECK(ctx, -1, "final value", key, ctx->value[slot], res);
+			}
+		}
+	}
+	res = list_size(g_list);
+	if(res != expected_size){
+		fprintf(stdout, RED_START ">>>MISMATCH: final size expected=%lld actual=%d"
+				COLOR_END "\n", expected_size, res);
+		failures++;
+	}
+	return failures;
+}
+
+static void parseError(){
+	fprintf(stderr, RED_START ">>>Usage: [-ops={num_of_ops}] [-th={num_of_threads}] "
+			"[-keys={num_of_keys}] [-batch={max_batch}] [-seed={seed}] "
+			"[-history={file}] [-combine] [-eliminate] [-compact] [-memoize] "
+			"[-skiplist] [-blink]\n");
+	fprintf(stderr, ">>>Parameters: 0 < num_of_threads <= %d, 0 < max_batch <= %d, "
+			"num_of_keys >= num_of_threads" COLOR_END "\n", MAX_THREADS, MAX_BATCH);
+	exit(1);
+}
+
+static void parseOptions(char** options, int size){
+	int i;
+	for(i=0;i<size;++i){
+		char* end;
+		if(strncmp(options[i], "-ops=", 5) == 0)
+			g_num_of_ops = strtoll(options[i] + 5, &end, 10);
+		else if(strncmp(options[i], "-th=", 4) == 0)
+			g_num_of_threads = (int)strtol(options[i] + 4, &end, 10);
+		else if(strncmp(options[i], "-keys=", 6) == 0)
+			g_num_of_keys = (int)strtol(options[i] + 6, &end, 10);
+		else if(strncmp(options[i], "-batch=", 7) == 0)
+			g_max_batch = (int)strtol(options[i] + 7, &end, 10);
+		else if(strncmp(options[i], "-seed=", 6) == 0)
+			g_seed = strtoull(options[i] + 6, &end, 10);
+		else if(strncmp(options[i], "-history=", 9) == 0){
+			g_history_path = options[i] + 9;
+			end = "";
+		}
+		else if(strcmp(options[i], "-combine") == 0){
+			g_combine = true;
+			end = "";
+		}
+		else if(strcmp(options[i], "-eliminate") == 0){
+			g_eliminate = true;
+			end = "";
+		}
+		else if(strcmp(options[i], "-compact") == 0){
+			g_compact = true;
+			end = "";
+		}
+		else if(strcmp(options[i], "-memoize") == 0){
+			g_memoize = true;
+			end = "";
+		}
+		else if(strcmp(options[i], "-skiplist") == 0){
+			g_backend = LIST_BACKEND_SKIPLIST;
+			end = "";
+		}
+		else if(strcmp(options[i], "-blink") == 0){
+			g_backend = LIST_BACKEND_BLINK;
+			end = "";
+		}
+		else
+			parseError();
+		if(*end)
+			parseError();
+	}
+	if(g_num_of_ops <= 0 || g_num_of_threads <= 0 || g_num_of_threads > MAX_THREADS
+	   || g_max_batch <= 0 || g_max_batch > MAX_BATCH
+	   || g_num_of_keys < g_num_of_threads)
+		parseError();
+}
+
+static void* compact_thread(void* param){
+	long long* passes = (long long*)param;
+	while(__atomic_load_n(&g_running, __ATOMIC_ACQUIRE)){
+		if(list_compact(g_list) < 0)
+			return NULL;
+		(*passes)++;
+	}
+	return NULL;
+}
+
+static double now_sec(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char** argv){
+	int t;
+	g_seed = (unsigned long long)time(NULL);
+	parseOptions(argv + 1, argc - 1);
+	fprintf(stdout, GREEN_START ">>>RUNNING WITH: THREADS = %d, OPS = %lld, KEYS = %d, "
+			"BATCH = %d, SEED = %llu" COLOR_END "\n", g_num_of_threads, g_num_of_ops,
+			g_num_of_keys, g_max_batch, g_seed);
+
+	for(t=0;t<NUM_TOKENS;t++)
+		g_tokens[t] = t;
+	g_list = list_alloc_backend(g_backend);
+	thread_ctx* ctxs = calloc(g_num_of_threads, sizeof(*ctxs));
+	pthread_t* threads = malloc(sizeof(*threads) * g_num_of_threads);
+	if(!g_list || !ctxs || !threads)
+		return 1;
+	if(g_combine && list_set_option(g_list, LIST_OPT_COMBINING, 1))
+		return 1;
+	if(g_eliminate && list_set_option(g_list, LIST_OPT_ELIMINATION, 1))
+		return 1;
+	if(g_memoize && hist_set_option(g_list, LIST_OPT_MEMOIZE, 1))
+		return 1;
+	for(t=0;t<g_num_of_threads;t++){
+		thread_ctx* ctx = &ctxs[t];
+		ctx->id = t;
+		ctx->rng = mix_seed(g_seed * MAX_THREADS + t);
+		ctx->ops = g_num_of_ops / g_num_of_threads +
+				   (t < g_num_of_ops % g_num_of_threads);
+		ctx->num_keys = g_num_of_keys / g_num_of_threads +
+						(t < g_num_of_keys % g_num_of_threads);
+		ctx->present = calloc(ctx->num_keys, 1);
+		ctx->value = calloc(ctx->num_keys, sizeof(int));
+		if(!ctx->present || !ctx->value)
+			return 1;
+	}
+	if(g_history_path){
+		if(hist_open(g_history_path, HIST_CAPACITY))
+			parseError();
+		for(t=0;t<g_num_of_threads;t++)
+			if(!(ctxs[t].hist = hist_thread(t)))
+				return 1;
+	}
+
+	pthread_t compactor;
+	long long passes = 0;
+	g_running = 1;
+	if(g_compact && pthread_create(&compactor, NULL, compact_thread, &passes))
+		return 1;
+	double start = now_sec();
+	for(t=0;t<g_num_of_threads;t++)
+		pthread_create(&threads[t], NULL, g_history_path ? history_thread :
+					   stress_thread, &ctxs[t]);
+	for(t=0;t<g_num_of_threads;t++)
+		pthread_join(threads[t], NULL);
+	double elapsed = now_sec() - start;
+	if(g_compact){
+		__atomic_store_n(&g_running, 0, __ATOMIC_RELEASE);
+		pthread_join(compactor, NULL);
+		fprintf(stdout, ">>>INFO: %lld compaction passes\n", passes);
+	}
+
+	long long failures = 0;
+	if(g_history_path){
+		if(hist_close())
+			failures++;
+		fprintf(stdout, ">>>INFO: history written to %s, check it with "
+				"HW3_Linearizability_Checker_E\n", g_history_path);
+	}
+	else
+		failures = verify_final_state(ctxs);
+	for(t=0;t<g_num_of_threads;t++)
+		failures += ctxs[t].failures;
+	fprintf(stdout, ">>>INFO: %lld ops in %.3f sec (%.0f ops/sec), op kinds:",
+			g_num_of_ops, elapsed, g_num_of_ops / elapsed);
+	for(t=0;t<DRV_NUM_OPS;t++)
+		fprintf(stdout, " %s", drv_names[t]);
+	fprintf(stdout, "\n");
+
+	list_free(g_list);
+	for(t=0;t<g_num_of_threads;t++){
+		free(ctxs[t].present);
+		free(ctxs[t].value);
+	}
+	free(ctxs);
+	free(threads);
+	if(failures){
+		fprintf(stdout, RED_START ">>>[Failed] %lld mismatches, rerun with -seed=%llu"
+				COLOR_END "\n", failures, g_seed);
+		return 1;
+	}
+	fprintf(stdout, GREEN_START ">>>[OK]" COLOR_END "\n");
+	return 0;
+}
@@ -0,0 +1,183 @@
+// Tests of concurrent_sorted_list.hpp with what the my_list.h shim never
+// uses: keys that are not ints, a comparator other than std::less, SpinLock
+// nodes, and the calls that take lambdas.
+//
+// build : g++ -std=c++11 -O2 -o templatetest HW3_Template_Test_I.cpp -lpthread
+// usage : ./templatetest
+
+#include <cstdio>
+#include <cstdint>
+#include <cctype>
+#include <string>
+#include <vector>
+#include <thread>
+#include <functional>
+
+#include "concurrent_sorted_list.hpp"
+
+using namespace std;
+
+#define ASSERT_TEST(b) do { \
+  if (!(b)) { \
+    fprintf(stdout, "\nAssertion failed at %s:%d %s ",__FILE__,__LINE__,#b); \
+    return false; \
+  } \
+} while (0)
+
+#define RUN_TEST(test) do { \
+  fprintf(stdout, "Running "#test"... "); \
+  if (test()) { \
+    fprintf(stdout, "[OK]\n"); \
+  } else { \
+    fprintf(stdout, "[Failed]\n"); \
+    failed++; \
+  } \
+} while(0)
+
+typedef ConcurrentSortedList<string, int64_t, greater<string>, SpinLock> Names;
+
+static const char* names[] = { "Arya", "Bran", "Jon", "Rickon", "Robb", "Sansa" };
+#define NAMES 6
+
+static vector<string> keysOf(Names& list){
+  vector<string> keys;
+  list.forEach([&](const string& key, int64_t&){ keys.push_back(key); });
+  return keys;
+}
+
+static bool testOrder(){
+  Names list;
+  for(int i = 0 ; i < NAMES ; i++)
+    ASSERT_TEST(list.insert(names[(i * 5) % NAMES], i));
+  ASSERT_TEST(!list.insert("Jon", 42));
+  vector<string> keys = keysOf(list);           // biggest first
+  ASSERT_TEST(keys.size() == NAMES);
+  for(int i = 0 ; i < NAMES ; i++)
+    ASSERT_TEST(keys[i] == names[NAMES - 1 - i]);
+  ASSERT_TEST(list.contains("Sansa") && !list.contains("Hodor"));
+  ASSERT_TEST(list.remove("Arya") && !list.remove("Arya"));
+  ASSERT_TEST(list.size() == NAMES - 1);
+  ASSERT_TEST(list.updateIf("Bran", 42, 7) == UpdateResult::MISMATCH);
+  return true;
+}
+
+// orders names regardless of case, "bran" and "Bran" being the same key
+struct NoCase{
+  bool operator()(const string& a, const string& b) const {
+    for(size_t i = 0 ; i < a.size() && i < b.size() ; i++)
+      if(tolower(a[i]) != tolower(b[i]))
+        return tolower(a[i]) < tolower(b[i]);
+    return a.size() < b.size();
+  }
+};
+
+static bool testEquivalentKeys(){
+  ConcurrentSortedList<string, int64_t, NoCase, SpinLock> list;
+  ASSERT_TEST(list.insert("Bran", 1));
+  ASSERT_TEST(!list.insert("bRAN", 2));
+  ASSERT_TEST(list.contains("BRAN"));
+  ASSERT_TEST(list.update("bran", 3));
+  string first;
+  int64_t value = 0;
+  list.forEach([&](const string& key, int64_t& v){ first = key; value = v; });
+  ASSERT_TEST(first == "Bran" && value == 3);   // the key as inserted
+  ASSERT_TEST(list.remove("BrAn") && list.size() == 0);
+  return true;
+}
+
+static bool testGetOrInsert(){
+  Names list;
+  int64_t out = 0;
+  ASSERT_TEST(list.getOrInsert("Hodor", 1, &out));
+  ASSERT_TEST(out == 1);
+  ASSERT_TEST(!list.getOrInsert("Hodor", 2, &out));
+  ASSERT_TEST(out == 1);
+  ASSERT_TEST(!list.getOrInsert("Hodor", 3));
+  ASSERT_TEST(list.compute("Hodor", [](int64_t& v){ v += 10; }));
+  ASSERT_TEST(!list.getOrInsert("Hodor", 4, &out));
+  ASSERT_TEST(out == 11);
+  ASSERT_TEST(list.upsert("Bran", 5) && !list.upsert("Bran", 6));
+  ASSERT_TEST(list.getOrInsert("Arya", 7, &out) && list.size() == 3);
+  int64_t sum = 0;
+  list.forEach([&](const string&, int64_t& v){ sum += v; v = 0; });
+  ASSERT_TEST(sum == 11 + 6 + 7);
+  ASSERT_TEST(!list.getOrInsert("Bran", 8, &out));
+  ASSERT_TEST(out == 0);                        // forEach may write
+  return true;
+}
+
+static bool testRemoveInCompute(){
+  Names list;
+  for(int i = 0 ; i < NAMES ; i++)
+    ASSERT_TEST(list.insert(names[i], i));
+  bool removed = false, nested = false;
+  ASSERT_TEST(list.compute("Jon", [&](int64_t& v){
+    removed = list.remove("Jon");               // goes once the compute returns
+    nested = list.compute("Sansa", [](int64_t& s){ s = 100; });
+    v = 42;                                     // still its own node
+  }));
+  ASSERT_TEST(removed && nested);
+  ASSERT_TEST(!list.contains("Jon") && list.size() == NAMES - 1);
+  ASSERT_TEST(!list.compute("Jon", [](int64_t&){}));
+  removed = nested = false;
+  ASSERT_TEST(list.compute("Robb", [&](int64_t&){   // nested on the same node
+    nested = list.compute("Robb", [&](int64_t&){ removed = list.remove("Robb"); });
+  }));
+  ASSERT_TEST(nested && removed && !list.contains("Robb"));
+  ASSERT_TEST(list.insert("Jon", 1) && list.insert("Robb", 2));
+  int64_t sansa = 0;
+  list.forEach([&](const string& key, int64_t& v){ if(key == "Sansa") sansa = v; });
+  ASSERT_TEST(sansa == 100);
+  return true;
+}
+
+#define THREADS 4
+#define ROUNDS 20000
+
+// every thread adds 1 per round to a name, which some thread may remove and
+// insert again meanwhile, so a round counts once the compute found its name
+static bool testConcurrent(){
+  Names list;
+  int64_t counted[THREADS] = { 0 };
+  vector<thread> threads;
+  bool ordered = true;
+  for(int t = 0 ; t < THREADS ; t++)
+    threads.emplace_back([&, t](){
+      unsigned seed = t + 1;
+      for(int i = 0 ; i < ROUNDS ; i++){
+        seed = seed * 1103515245 + 12345;
+        const char* name = names[(seed >> 16) % NAMES];
+        list.getOrInsert(name, 0);
+        if(list.compute(name, [&](int64_t& v){
+             v++;
+             if(((seed >> 8) & 1023) == 0 && list.remove(name))
+               counted[t] -= v;                 // its count goes with it
+           }))
+          counted[t]++;
+      }
+    });
+  for(int i = 0 ; i < 200 ; i++){
+    vector<string> keys = keysOf(list);
+    for(size_t k = 1 ; k < keys.size() ; k++)
+      ordered = ordered && keys[k - 1] > keys[k];
+  }
+  for(size_t t = 0 ; t < threads.size() ; t++)
+    threads[t].join();
+  ASSERT_TEST(ordered);
+  int64_t expected = 0, sum = 0;
+  for(int t = 0 ; t < THREADS ; t++)
+    expected += counted[t];
+  list.forEach([&](const string&, int64_t& v){ sum += v; });
+  ASSERT_TEST(sum == expected);
+  return true;
+}
+
+int main(){
+  int failed = 0;
+  RUN_TEST(testOrder);
+  RUN_TEST(testEquivalentKeys);
+  RUN_TEST(testGetOrInsert);
+  RUN_TEST(testRemoveInCompute);
+  RUN_TEST(testConcurrent);
+  return failed ? 1 : 0;
+}
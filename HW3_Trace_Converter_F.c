@@ -0,0 +1,102 @@
+/******************************************************************************/
+/*                                                                            */
+/* File Name : HW3_Trace_Converter_F.c                                        */
+/*                                                                            */
+/* Converts a dump written by list_trace_dump() into a Chrome trace (open it  */
+/* in chrome://tracing or ui.perfetto.dev), or into folded stacks for         */
+/* flamegraph.pl, where every call is split into lock wait and the rest.      */
+/*                                                                            */
+/* build : gcc -std=c99 -O2 -o trace2json HW3_Trace_Converter_F.c             */
+/* usage : ./trace2json dump_file [-folded] > output                          */
+/*                                                                            */
+/******************************************************************************/
+
+#define _GNU_SOURCE
+#include "my_list.h"
+#include "list_trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define RED_START 		"\033[1;31m"
+#define COLOR_END 		"\033[0m"
+
+static const char* op_names[LIST_OP_KINDS] = { "list_insert", "list_remove",
+	"list_find", "list_size", "list_update", "list_compute", "list_upsert",
+	"list_update_if", "list_get_or_insert", "list_batch" };
+
+static int by_start(const void* a, const void* b){
+	const trace_record_t *x = a, *y = b;
+	return (x->start > y->start) - (x->start < y->start);
+}
+
+static void write_chrome(const trace_record_t* recs, unsigned int count){
+	unsigned int i;
+	unsigned long long base = count ? recs[0].start : 0;
+	fprintf(stdout, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+	for(i=0;i<count;i++){
+		const trace_record_t* r = &recs[i];
+		fprintf(stdout, "%s\n {\"name\": \"%s\", \"cat\": \"my_list\", \"ph\": \"X\", "
+				"\"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f, \"args\": "
+				"{\"key\": %d, \"result\": %d, \"lock_wait_us\": %.3f}}",
+				i ? "," : "", op_names[r->op], r->thread, (r->start - base) / 1000.0,
+				(r->end - r->start) / 1000.0, r->key, r->result, r->lock_wait / 1000.0);
+	}
+	fprintf(stdout, "\n]}\n");
+}
+
+/**
+ * write_folded : one line per thread and call kind, weighted by nanoseconds,
+ * e.g. "thread_12;list_insert;lock_wait 5300".
+ */
+static void write_folded(const trace_record_t* recs, unsigned int count){
+	unsigned int i;
+	for(i=0;i<count;i++){
+		const trace_record_t* r = &recs[i];
+		unsigned long long total = r->end - r->start;
+		unsigned long long wait = r->lock_wait < total ? r->lock_wait : total;
+		if(wait)
+			fprintf(stdout, "thread_%u;%s;lock_wait %llu\n", r->thread,
+					op_names[r->op], wait);
+		if(total - wait)
+			fprintf(stdout, "thread_%u;%s;run %llu\n", r->thread,
+					op_names[r->op], total - wait);
+	}
+}
+
+int main(int argc, char** argv){
+	trace_header_t header;
+	trace_record_t* recs;
+	unsigned int i;
+	FILE* file;
+	if(argc < 2 || argc > 3 || (argc == 3 && strcmp(argv[2], "-folded"))){
+		fprintf(stderr, RED_START ">>>Usage: dump_file [-folded]" COLOR_END "\n");
+		return 1;
+	}
+	if(!(file = fopen(argv[1], "rb")) || fread(&header, sizeof(header), 1, file) != 1
+	   || header.magic != TRACE_MAGIC || header.version != TRACE_VERSION
+	   || header.record_size != sizeof(trace_record_t)){
+		fprintf(stderr, RED_START ">>>ERROR: %s is not a trace dump" COLOR_END "\n", argv[1]);
+		return 1;
+	}
+	recs = malloc(sizeof(trace_record_t) * (header.count ? header.count : 1));
+	if(!recs || fread(recs, sizeof(trace_record_t), header.count, file) != header.count){
+		fprintf(stderr, RED_START ">>>ERROR: truncated trace dump" COLOR_END "\n");
+		return 1;
+	}
+	fclose(file);
+	for(i=0;i<header.count;i++)
+		if(recs[i].op >= LIST_OP_KINDS || recs[i].end < recs[i].start){
+			fprintf(stderr, RED_START ">>>ERROR: corrupted record in trace dump"
+					COLOR_END "\n");
+			return 1;
+		}
+	qsort(recs, header.count, sizeof(trace_record_t), by_start);
+	if(argc == 3)
+		write_folded(recs, header.count);
+	else
+		write_chrome(recs, header.count);
+	free(recs);
+	return 0;
+}
@@ -0,0 +1,154 @@
+/******************************************************************************/
+/*                                                                            */
+/* File Name : HW3_Traversal_Bench_G.c                                        */
+/*                                                                            */
+/* Microbenchmark of the traversal loops of my_list.c on lists that do not    */
+/* fit in cache. The nodes are allocated in a scattered order, as after long  */
+/* insert/remove churn, and every LIST_OPT_PREFETCH distance is measured on   */
+/* full walks (list_size) and on random lookups (list_find), then once more   */
+/* after list_compact has moved the nodes into key order.                     */
+/*                                                                            */
+/* build : gcc -std=c99 -O2 -o travbench HW3_Traversal_Bench_G.c my_list.c    */
+/*             -lpthread                                                      */
+/* usage : ./travbench [-size=262144] [-walks=20] [-finds=200] [-seed=N]      */
+/*                                                                            */
+/******************************************************************************/
+
+#define _GNU_SOURCE
+#include "my_list.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define RED_START 		"\033[1;31m"
+#define GREEN_START 	"\033[1;32m"
+#define COLOR_END 		"\033[0m"
+
+#define MAX_GAP			512		// bytes allocated between two nodes
+
+static int 					g_size 	= 262144;
+static int 					g_walks = 20;
+static int 					g_finds = 200;
+static unsigned long long 	g_seed 	= 1;
+
+static int 					g_token = 42;
+
+static inline unsigned long long next_rand(unsigned long long* s){
+	unsigned long long x = *s;	// xorshift64*
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*s = x;
+	return x * 0x2545F4914F6CDD1DULL;
+}
+
+static inline unsigned long long now_ns(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * build : inserts the keys [0, size) from the largest down, so every insert
+ * is at the head, with a random sized allocation between two nodes. Once the
+ * gaps are freed the nodes are spread over the heap without a fixed stride,
+ * which hardware prefetchers cannot follow.
+ */
+static linked_list_t* build(int size, unsigned long long seed){
+	linked_list_t* list = list_alloc();
+	void** gaps = malloc(sizeof(void*) * size);
+	int i;
+	if(!list || !gaps){
+		free(gaps);
+		list_free(list);
+		return NULL;
+	}
+	for(i=size-1;i>=0;i--){
+		gaps[i] = malloc(1 + next_rand(&seed) % MAX_GAP);
+		list_insert(list, i, &g_token);
+	}
+	for(i=0;i<size;i++)
+		free(gaps[i]);
+	free(gaps);
+	return list;
+}
+
+static void parseError(){
+	fprintf(stderr, RED_START ">>>Usage: [-size={nodes}] [-walks={full_walks}] "
+			"[-finds={lookups}] [-seed={seed}]" COLOR_END "\n");
+	exit(1);
+}
+
+static void parseOptions(char** options, int size){
+	int i;
+	for(i=0;i<size;++i){
+		char* opt = options[i];
+		if(strncmp(opt, "-size=", 6) == 0)
+			g_size = atoi(opt + 6);
+		else if(strncmp(opt, "-walks=", 7) == 0)
+			g_walks = atoi(opt + 7);
+		else if(strncmp(opt, "-finds=", 7) == 0)
+			g_finds = atoi(opt + 7);
+		else if(strncmp(opt, "-seed=", 6) == 0)
+			g_seed = strtoull(opt + 6, NULL, 10);
+		else
+			parseError();
+	}
+	if(g_size <= 0 || g_walks <= 0 || g_finds <= 0)
+		parseError();
+}
+
+/**
+ * measure : times walks and lookups at every prefetch distance. Returns 0 on
+ * success.
+ */
+static int measure(linked_list_t* list, const char* layout){
+	int distance, i;
+	list_size(list);	// the first walk pays for the page faults
+	for(distance=0;distance<=2;distance++){
+		unsigned long long rng = g_seed, start;
+		double walk_ns, find_ns;
+		if(list_set_option(list, LIST_OPT_PREFETCH, distance)){
+			fprintf(stderr, RED_START ">>>ERROR: no prefetch distance %d" COLOR_END "\n",
+					distance);
+			return 1;
+		}
+		start = now_ns();
+		for(i=0;i<g_walks;i++)
+			if(list_size(list) != g_size){
+				fprintf(stderr, RED_START ">>>ERROR: wrong size" COLOR_END "\n");
+				return 1;
+			}
+		walk_ns = (double)(now_ns() - start) / g_walks / g_size;
+		start = now_ns();
+		for(i=0;i<g_finds;i++)
+			list_find(list, (int)(next_rand(&rng) % g_size));
+		find_ns = (double)(now_ns() - start) / g_finds;
+		fprintf(stdout, "%-9s prefetch=%d    walk %7.2f ns/node    find %10.0f ns/op\n",
+				layout, distance, walk_ns, find_ns);
+	}
+	return 0;
+}
+
+int main(int argc, char** argv){
+	parseOptions(argv + 1, argc - 1);
+	linked_list_t* list = build(g_size, g_seed);
+	if(!list){
+		fprintf(stderr, RED_START ">>>ERROR: allocation failed" COLOR_END "\n");
+		return 1;
+	}
+	fprintf(stdout, GREEN_START ">>>RUNNING WITH: SIZE = %d, WALKS = %d, FINDS = %d"
+			COLOR_END "\n", g_size, g_walks, g_finds);
+	if(measure(list, "scattered"))
+		return 1;
+	if(list_compact(list) != g_size){
+		fprintf(stderr, RED_START ">>>ERROR: compaction failed" COLOR_END "\n");
+		return 1;
+	}
+	list_synchronize();	// frees the old nodes
+	if(measure(list, "compacted"))
+		return 1;
+	list_free(list);
+	return 0;
+}
@@ -0,0 +1,403 @@
+#ifndef __CONCURRENT_SORTED_LIST_HPP_
+#define __CONCURRENT_SORTED_LIST_HPP_
+
+// ConcurrentSortedList : a typed, header-only version of the my_list.c list.
+//
+// Same algorithms as my_list.c: a sorted doubly linked list between two
+// anchors, traversed hand-over-hand on per-node locks, with a second per-node
+// lock guarding the value so compute can run without blocking traversals.
+// Unlike my_list.c the key and the value are stored inline in the node, so
+// a compute touches no memory besides the node itself, and keys are ordered
+// by a compile-time comparator.
+//
+// Key     : any copyable type ordered by Compare.
+// Value   : any copyable type, small ones are best (it lives in the node).
+// Compare : a strict weak ordering of keys, std::less<Key> by default.
+// Lock    : the lock type of every node. Anything with lock() / unlock() will
+//           do: std::mutex (the default) or SpinLock below, for short
+//           critical sections on machines with few threads per core.
+//
+// Values are read and written under the value lock, so unlike my_list.c a
+// compute never observes a torn value while an update runs.
+//
+// my_list_shim.cpp implements my_list.h on top of this class.
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+// SpinLock : a test-and-test-and-set lock, yielding after a short spin.
+class SpinLock{
+public:
+  SpinLock() : locked_(false) {}
+  SpinLock(const SpinLock&) = delete;
+  SpinLock& operator=(const SpinLock&) = delete;
+
+  void lock(){
+    for(int spins = 0 ; locked_.exchange(true, std::memory_order_acquire) ; ){
+      while(locked_.load(std::memory_order_relaxed)){
+        if(++spins > 64){
+          std::this_thread::yield();
+          spins = 0;
+        }
+      }
+    }
+  }
+  bool try_lock(){ return !locked_.exchange(true, std::memory_order_acquire); }
+  void unlock(){ locked_.store(false, std::memory_order_release); }
+
+private:
+  std::atomic<bool> locked_;
+};
+
+// result of ConcurrentSortedList::updateIf
+enum class UpdateResult{ UPDATED, MISMATCH, NOT_FOUND };
+
+template <typename Key, typename Value, typename Compare = std::less<Key>,
+          typename Lock = std::mutex>
+class ConcurrentSortedList{
+  // Link : what anchors and nodes share. Anchors carry no key: the first one
+  // is smaller and the last one is bigger than every key.
+  struct Link{
+    Link* prev;
+    Link* next;
+    Lock node_lock;
+  };
+
+  struct Node : Link{
+    Node(const Key& k, const Value& v) : key(k), value(v) {}
+    Key key;
+    Value value;
+    Lock data_lock;
+  };
+
+  // ComputeFrame : a compute running on this thread, innermost first. The
+  // outermost one on a node holds its value lock, so calls from inside it do
+  // not take that lock again. A node removed from inside its own compute is
+  // deleted when that outermost compute returns.
+  struct ComputeFrame{
+    Node* node;
+    bool locked;
+    bool removed;
+    ComputeFrame* outer;
+  };
+
+  static ComputeFrame*& computeFrames(){
+    static thread_local ComputeFrame* top = nullptr;
+    return top;
+  }
+
+  // the outermost frame of this thread computing on the node, if any
+  static ComputeFrame* computeFrameOf(const Node* node){
+    ComputeFrame* found = nullptr;
+    for(ComputeFrame* frame = computeFrames() ; frame ; frame = frame->outer)
+      if(frame->node == node)
+        found = frame;
+    return found;
+  }
+
+public:
+  explicit ConcurrentSortedList(const Compare& compare = Compare()) : cmp_(compare){
+    first_.prev = nullptr;
+    first_.next = &last_;
+    last_.prev = &first_;
+    last_.next = nullptr;
+  }
+
+  ConcurrentSortedList(const ConcurrentSortedList&) = delete;
+  ConcurrentSortedList& operator=(const ConcurrentSortedList&) = delete;
+
+  // Must not run concurrently with any other call, as in my_list.c the list
+  // waits for computes still running on its nodes.
+  ~ConcurrentSortedList(){
+    Link* curr = first_.next;
+    while(curr != &last_){
+      Node* node = static_cast<Node*>(curr);
+      curr = curr->next;
+      node->data_lock.lock();
+      node->data_lock.unlock();
+      delete node;
+    }
+  }
+
+  // Inserts the key with the given value. Fails if the key already exists.
+  bool insert(const Key& key, const Value& value){
+    Node* node = new Node(key, value);
+    Link *prev, *curr;
+    lockPosition(key, prev, curr);
+    if(isKey(curr, key)){
+      unlockPair(prev, curr);
+      delete node;
+      return false;
+    }
+    linkNode(prev, node, curr);
+    unlockPair(prev, curr);
+    return true;
+  }
+
+  // Removes the key. Fails if the key does not exist. Removing a key from
+  // inside a compute on it is allowed: the node goes once the compute returns.
+  bool remove(const Key& key){
+    Link *prev, *curr;
+    lockPosition(key, prev, curr);
+    if(!isKey(curr, key)){
+      unlockPair(prev, curr);
+      return false;
+    }
+    Node* node = static_cast<Node*>(curr);
+    prev->next = node->next;
+    node->next->prev = prev;
+    prev->node_lock.unlock();
+    if(ComputeFrame* frame = computeFrameOf(node)){
+      frame->removed = true;  // this thread holds its value lock
+      node->node_lock.unlock();
+      return true;
+    }
+    node->data_lock.lock();   // waits for a compute still running on it
+    node->data_lock.unlock();
+    node->node_lock.unlock();
+    delete node;
+    return true;
+  }
+
+  bool contains(const Key& key){
+    Link *prev, *curr;
+    lockPosition(key, prev, curr);
+    bool found = isKey(curr, key);
+    unlockPair(prev, curr);
+    return found;
+  }
+
+  size_t size(){
+    size_t count = 0;
+    Link* prev = &first_;
+    prev->node_lock.lock();
+    Link* curr = prev->next;
+    curr->node_lock.lock();
+    while(curr != &last_){
+      count++;
+      advance(prev, curr);
+    }
+    unlockPair(prev, curr);
+    return count;
+  }
+
+  // Sets the value of the key. Fails if the key does not exist.
+  bool update(const Key& key, const Value& value){
+    Link *prev, *curr;
+    bool found = lockValuePosition(key, prev, curr);
+    if(found)
+      setValue(static_cast<Node*>(curr), value);
+    unlockPair(prev, curr);
+    return found;
+  }
+
+  // Calls func(Value&) on the value of the key, holding only the value lock
+  // of its node, so other threads keep walking past it meanwhile. Fails if
+  // the key does not exist.
+  template <typename Func>
+  bool compute(const Key& key, Func&& func){
+    Link *prev, *curr;
+    if(!lockValuePosition(key, prev, curr)){
+      unlockPair(prev, curr);
+      return false;
+    }
+    Node* node = static_cast<Node*>(curr);
+    unlockPair(prev, curr);
+    ComputeFrame frame = { node, !computeFrameOf(node), false, computeFrames() };
+    FrameGuard guard(frame);
+    func(node->value);
+    return true;
+  }
+
+  // Sets the value of the key, inserting it if needed, in a single traversal.
+  // Returns true if the key was inserted.
+  bool upsert(const Key& key, const Value& value){
+    Node* node = new Node(key, value);
+    Link *prev, *curr;
+    bool inserted = !lockValuePosition(key, prev, curr);
+    if(inserted)
+      linkNode(prev, node, curr);
+    else
+      setValue(static_cast<Node*>(curr), value);
+    unlockPair(prev, curr);
+    if(!inserted)
+      delete node;
+    return inserted;
+  }
+
+  // Sets the value of the key only if it currently equals expected.
+  UpdateResult updateIf(const Key& key, const Value& expected, const Value& value){
+    Link *prev, *curr;
+    UpdateResult res = UpdateResult::NOT_FOUND;
+    if(lockValuePosition(key, prev, curr)){
+      Node* node = static_cast<Node*>(curr);
+      res = node->value == expected ? UpdateResult::UPDATED : UpdateResult::MISMATCH;
+      if(res == UpdateResult::UPDATED)
+        node->value = value;
+      unlockValue(node);
+    }
+    unlockPair(prev, curr);
+    return res;
+  }
+
+  // Stores the value of the key into out, inserting the key with the given
+  // value if needed, in a single traversal. Returns true if it was inserted.
+  bool getOrInsert(const Key& key, const Value& value, Value* out = nullptr){
+    Node* node = new Node(key, value);
+    Link *prev, *curr;
+    bool inserted = !lockValuePosition(key, prev, curr);
+    if(inserted){
+      linkNode(prev, node, curr);
+      if(out) *out = value;
+    }
+    else{
+      Node* found = static_cast<Node*>(curr);
+      if(out) *out = found->value;
+      unlockValue(found);
+    }
+    unlockPair(prev, curr);
+    if(!inserted)
+      delete node;
+    return inserted;
+  }
+
+  // Calls func(const Key&, Value&) on every entry in key order, hand-over-hand.
+  // An entry a compute runs on is waited for as lockValuePosition does, with
+  // the walk picking up again from its key.
+  template <typename Func>
+  void forEach(Func&& func){
+    Link* prev = &first_;
+    prev->node_lock.lock();
+    Link* curr = prev->next;
+    curr->node_lock.lock();
+    while(curr != &last_){
+      Node* node = static_cast<Node*>(curr);
+      if(!tryLockValue(node)){
+        Key key = node->key;
+        unlockPair(prev, curr);
+        std::this_thread::yield();
+        lockPosition(key, prev, curr);
+        continue;
+      }
+      func(static_cast<const Key&>(node->key), node->value);
+      unlockValue(node);
+      advance(prev, curr);
+    }
+    unlockPair(prev, curr);
+  }
+
+  // Moves every node into the given n (empty) lists alternately, as
+  // list_split does, leaving this list empty.
+  void splitInto(ConcurrentSortedList* const* out, size_t n){
+    size_t i = 0;
+    first_.node_lock.lock();
+    Link* curr = first_.next;
+    curr->node_lock.lock();   // so a node in use is waited for
+    while(curr != &last_){
+      Link* next = curr->next;
+      next->node_lock.lock();
+      first_.next = next;
+      next->prev = &first_;
+      ConcurrentSortedList* to = out[i];
+      linkNode(to->last_.prev, static_cast<Node*>(curr), &to->last_);
+      curr->node_lock.unlock();
+      curr = next;
+      if(++i == n) i = 0;
+    }
+    curr->node_lock.unlock();
+    first_.node_lock.unlock();
+  }
+
+private:
+  bool isKey(const Link* link, const Key& key) const {
+    return link != &last_ && !cmp_(key, static_cast<const Node*>(link)->key);
+  }
+
+  // FrameGuard : pushes the frame of a compute, and when the compute returns
+  // or throws pops it, releases the value lock and deletes a removed node.
+  struct FrameGuard{
+    explicit FrameGuard(ComputeFrame& frame) : frame_(frame){ computeFrames() = &frame; }
+    ~FrameGuard(){
+      computeFrames() = frame_.outer;
+      if(!frame_.locked)
+        return;
+      frame_.node->data_lock.unlock();
+      if(frame_.removed)
+        delete frame_.node;
+    }
+    ComputeFrame& frame_;
+  };
+
+  static void linkNode(Link* prev, Node* node, Link* next){
+    node->next = next;
+    node->prev = prev;
+    prev->next = node;
+    next->prev = node;
+  }
+
+  // Takes the value lock of the node unless a compute of this thread on the
+  // node holds it already. Never waits.
+  static bool tryLockValue(Node* node){
+    return computeFrameOf(node) || node->data_lock.try_lock();
+  }
+
+  static void unlockValue(Node* node){
+    if(!computeFrameOf(node))
+      node->data_lock.unlock();
+  }
+
+  // sets the value of a node whose value lock was taken, and lets it go
+  static void setValue(Node* node, const Value& value){
+    node->value = value;
+    unlockValue(node);
+  }
+
+  static void advance(Link*& prev, Link*& curr){
+    curr = curr->next;
+    curr->node_lock.lock();
+    prev->node_lock.unlock();
+    prev = curr->prev;
+  }
+
+  static void unlockPair(Link* prev, Link* curr){
+    curr->node_lock.unlock();
+    prev->node_lock.unlock();
+  }
+
+  // Walks hand-over-hand until the first node whose key is not smaller than
+  // the given one, leaving it and its predecessor locked.
+  void lockPosition(const Key& key, Link*& prev, Link*& curr){
+    prev = &first_;
+    prev->node_lock.lock();
+    curr = prev->next;
+    curr->node_lock.lock();
+    while(curr != &last_ && cmp_(static_cast<Node*>(curr)->key, key))
+      advance(prev, curr);
+  }
+
+  // lockPosition, and if the key is there, the value lock of its node too.
+  // A compute may hold that one for long, so rather than wait for it with
+  // the pair locked, which would stall every walk reaching the node, it lets
+  // the pair go and walks again. Returns true if the key is there.
+  bool lockValuePosition(const Key& key, Link*& prev, Link*& curr){
+    while(true){
+      lockPosition(key, prev, curr);
+      if(!isKey(curr, key))
+        return false;
+      if(tryLockValue(static_cast<Node*>(curr)))
+        return true;
+      unlockPair(prev, curr);
+      std::this_thread::yield();
+    }
+  }
+
+  Compare cmp_;
+  Link first_;
+  Link last_;
+};
+
+#endif /* __CONCURRENT_SORTED_LIST_HPP_ */
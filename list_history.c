@@ -0,0 +1,380 @@
+/******************************************************************************/
+/*                                                                            */
+/* File Name : list_history.c                                                 */
+/*                                                                            */
+/******************************************************************************/
+
+//*****************************************************************************/
+//----------------------------------<INCLUDE>---------------------------------*/
+//*****************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <time.h>
+#include "list_history.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+//*****************************************************************************/
+//----------------------------------<DEFINE>----------------------------------*/
+//*****************************************************************************/
+
+#define SUCCES			0
+#define PARAM_ERROR 	-1
+#define ALLOC_ERROR 	-2
+#define FILE_ERROR		-8
+
+//*****************************************************************************/
+//----------------------------------<STRUCT>----------------------------------*/
+//*****************************************************************************/
+
+/**
+ * hist_thread_t : the ring buffer of a single recording thread. Only its
+ * owner writes into it, so no synchronization is needed until it is flushed.
+ */
+struct hist_thread_t{
+	uint32_t 		id_;
+	uint32_t 		count_;
+	hist_event_t* 	events_;
+	hist_thread_t* 	next_;
+};
+
+static FILE* 			g_file;
+static uint32_t 		g_capacity;
+static hist_thread_t* 	g_threads;
+static pthread_mutex_t 	g_lock = PTHREAD_MUTEX_INITIALIZER;
+static linked_list_t* 	g_memo_lists[HIST_MEMO_LISTS];	// written under g_lock
+
+/* the data pointer handed to the compute function of the calling thread */
+static __thread void* 	tls_observed;
+static __thread int 	(*tls_compute) (void *);
+static __thread int 	tls_ran;	// whether list_compute ran it
+
+//*****************************************************************************/
+//-----------------------------<STATIC FUNCTIONS>-----------------------------*/
+//*****************************************************************************/
+
+/**
+ * stamp_invoke / stamp_response : TSC timestamps, fenced so the call cannot
+ * be reordered to before the invoke stamp or after the response stamp.
+ */
+static inline uint64_t stamp_invoke(){
+#if defined(__x86_64__) || defined(__i386__)
+	_mm_lfence();
+	return __rdtsc();
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+static inline uint64_t stamp_response(){
+#if defined(__x86_64__) || defined(__i386__)
+	unsigned int aux;
+	uint64_t tsc = __rdtscp(&aux);
+	_mm_lfence();
+	return tsc;
+#else
+	return stamp_invoke();
+#endif
+}
+
+/**
+ * flush_thread : appends the events of the given thread to the history file
+ * and empties its ring buffer.
+ */
+static void flush_thread(hist_thread_t* t){
+	hist_chunk_t chunk = { t->id_, t->count_ };
+	if(!t->count_)
+		return;
+	pthread_mutex_lock(&g_lock);
+	if(g_file){
+		fwrite(&chunk, sizeof(chunk), 1, g_file);
+		fwrite(t->events_, sizeof(hist_event_t), t->count_, g_file);
+	}
+	pthread_mutex_unlock(&g_lock);
+	t->count_ = 0;
+}
+
+static inline hist_event_t* next_event(hist_thread_t* t){
+	if(t->count_ == g_capacity)
+		flush_thread(t);
+	hist_event_t* e = &t->events_[t->count_++];
+	e->data = e->expected = e->out = e->func = 0;
+	e->computed = 0;
+	e->flags = e->reserved = 0;
+	return e;
+}
+
+#define record(t,event,operation,k)	hist_event_t* event = next_event(t);\
+									(event)->op = (operation);\
+									(event)->key = (k);\
+									(event)->invoke = stamp_invoke()
+
+#define respond(event,res)			(event)->response = stamp_response();\
+									(event)->result = (res)
+
+static int observing_compute(void* data){
+	tls_observed = data;
+	tls_ran = 1;
+	return tls_compute(data);
+}
+
+/**
+ * memoizes : whether hist_set_option turned LIST_OPT_MEMOIZE on for the given
+ * list.
+ */
+static int memoizes(linked_list_t* list){
+	int i;
+	for(i=0;i<HIST_MEMO_LISTS;i++)
+		if(__atomic_load_n(&g_memo_lists[i], __ATOMIC_RELAXED) == list)
+			return 1;
+	return 0;
+}
+
+//*****************************************************************************/
+//--------------------------------<FUNCTIONS>---------------------------------*/
+//*****************************************************************************/
+
+/**
+ * hist_open : Starts recording into the given history file.
+ *
+ * input		: path 				- the history file to create.
+ * 				: events_per_thread - the capacity of each thread's ring buffer.
+ *
+ * output		: N/A
+ *
+ * return value	: 0 in case of success or anything else in case of failure.
+ */
+int hist_open(const char* path, int events_per_thread){
+	hist_header_t header = { HIST_MAGIC, HIST_VERSION, sizeof(hist_event_t), 0 };
+	if(!path || events_per_thread <= 0)	return PARAM_ERROR;
+	pthread_mutex_lock(&g_lock);
+	g_file = fopen(path, "wb");
+	if(!g_file){
+		pthread_mutex_unlock(&g_lock);
+		return FILE_ERROR;
+	}
+	fwrite(&header, sizeof(header), 1, g_file);
+	g_capacity = (uint32_t)events_per_thread;
+	pthread_mutex_unlock(&g_lock);
+	return SUCCES;
+}
+
+/**
+ * hist_close : Flushes every thread's ring buffer and closes the history file.
+ * Must only be called once all recording threads are done.
+ *
+ * return value	: 0 in case of success or anything else in case of failure.
+ */
+int hist_close(){
+	hist_thread_t* t;
+	int res = SUCCES;
+	while((t = g_threads)){
+		flush_thread(t);
+		g_threads = t->next_;
+		free(t->events_);
+		free(t);
+	}
+	pthread_mutex_lock(&g_lock);
+	if(!g_file || fclose(g_file))
+		res = FILE_ERROR;
+	g_file = NULL;
+	pthread_mutex_unlock(&g_lock);
+	return res;
+}
+
+/**
+ * hist_thread : Allocates the ring buffer for a recording thread. Every thread
+ * must use its own buffer.
+ *
+ * input		: thread - the id written into the history for this thread.
+ *
+ * return value	: The new buffer or NULL in case of failure.
+ */
+hist_thread_t* hist_thread(int thread){
+	hist_thread_t* t = (hist_thread_t*) malloc(sizeof(*t));
+	if(!t)
+		return NULL;
+	t->events_ = (hist_event_t*) malloc(sizeof(hist_event_t) * g_capacity);
+	if(!t->events_){
+		free(t);
+		return NULL;
+	}
+	t->id_ = (uint32_t)thread;
+	t->count_ = 0;
+	pthread_mutex_lock(&g_lock);
+	t->next_ = g_threads;
+	g_threads = t;
+	pthread_mutex_unlock(&g_lock);
+	return t;
+}
+
+/**
+ * hist_set_option : Runs list_set_option, noting the lists LIST_OPT_MEMOIZE
+ * is turned on for. hist_compute hands their compute functions to the list
+ * as they are: the memo of a node is keyed by the function, so one wrapper
+ * around all of them would answer one function with the result of another.
+ *
+ * input		: the input of list_set_option.
+ *
+ * return value	: the return value of list_set_option, or ALLOC_ERROR if
+ * 				  more than HIST_MEMO_LISTS lists would memoize.
+ */
+int hist_set_option(linked_list_t* list, int option, long value){
+	int i, slot = -1, res;
+	if(option != LIST_OPT_MEMOIZE)
+		return list_set_option(list, option, value);
+	pthread_mutex_lock(&g_lock);
+	for(i=0;i<HIST_MEMO_LISTS;i++){
+		if(g_memo_lists[i] == list){
+			slot = i;
+			break;
+		}
+		if(!g_memo_lists[i] && slot < 0)
+			slot = i;
+	}
+	if(slot < 0 && value)
+		res = ALLOC_ERROR;
+	else if((res = list_set_option(list, option, value)) == SUCCES && slot >= 0)
+		__atomic_store_n(&g_memo_lists[slot], value ? list : NULL, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&g_lock);
+	return res;
+}
+
+/*
+ * The wrappers below behave exactly like the my_list.h call of the same name
+ * and record it into the given thread's buffer.
+ */
+
+int hist_insert(hist_thread_t* t, linked_list_t* list, int key, void* data){
+	record(t, e, HIST_INSERT, key);
+	e->data = (uint64_t)(uintptr_t)data;
+	int res = list_insert(list, key, data);
+	respond(e, res);
+	return res;
+}
+
+int hist_remove(hist_thread_t* t, linked_list_t* list, int key){
+	record(t, e, HIST_REMOVE, key);
+	int res = list_remove(list, key);
+	respond(e, res);
+	return res;
+}
+
+int hist_find(hist_thread_t* t, linked_list_t* list, int key){
+	record(t, e, HIST_FIND, key);
+	int res = list_find(list, key);
+	respond(e, res);
+	return res;
+}
+
+int hist_update(hist_thread_t* t, linked_list_t* list, int key, void* data){
+	record(t, e, HIST_UPDATE, key);
+	e->data = (uint64_t)(uintptr_t)data;
+	int res = list_update(list, key, data);
+	respond(e, res);
+	return res;
+}
+
+/*
+ * A compute on a list that memoizes, or that was answered from the memo of
+ * its node, does not show the data it ran on. Its event only has what
+ * compute_func returned, which the checker holds against the computes that
+ * did show it.
+ */
+int hist_compute(hist_thread_t* t, linked_list_t* list, int key,
+				 int (*compute_func) (void *), int* result){
+	int memo, res;
+	if(!compute_func || !result)
+		return list_compute(list, key, compute_func, result);
+	memo = memoizes(list);
+	tls_compute = compute_func;
+	tls_observed = NULL;
+	tls_ran = 0;
+	record(t, e, HIST_COMPUTE, key);
+	res = list_compute(list, key, memo ? compute_func : observing_compute, result);
+	respond(e, res);
+	e->func = (uint64_t)(uintptr_t)compute_func;
+	e->out = (uint64_t)(uintptr_t)tls_observed;
+	if(res == 0){
+		e->computed = *result;
+		if(!tls_ran)
+			e->flags = HIST_F_NO_OUT;
+	}
+	return res;
+}
+
+int hist_upsert(hist_thread_t* t, linked_list_t* list, int key, void* data){
+	record(t, e, HIST_UPSERT, key);
+	e->data = (uint64_t)(uintptr_t)data;
+	int res = list_upsert(list, key, data);
+	respond(e, res);
+	return res;
+}
+
+int hist_update_if(hist_thread_t* t, linked_list_t* list, int key,
+				   void* expected, void* data){
+	record(t, e, HIST_UPDATE_IF, key);
+	e->data = (uint64_t)(uintptr_t)data;
+	e->expected = (uint64_t)(uintptr_t)expected;
+	int res = list_update_if(list, key, expected, data);
+	respond(e, res);
+	return res;
+}
+
+int hist_get_or_insert(hist_thread_t* t, linked_list_t* list, int key,
+					   void* data, void** result){
+	void* out = NULL;
+	record(t, e, HIST_GET_OR_INSERT, key);
+	e->data = (uint64_t)(uintptr_t)data;
+	int res = list_get_or_insert(list, key, data, &out);
+	respond(e, res);
+	e->out = (uint64_t)(uintptr_t)out;
+	if(result)
+		*result = out;
+	return res;
+}
+
+/**
+ * hist_batch : Runs list_batch and records every op of the batch with the
+ * invoke and response timestamps of the whole batch, which safely bound the
+ * interval each op actually ran in. The data a COMPUTE op ran on is not
+ * observable here, so only its outcome and result are recorded.
+ */
+void hist_batch(hist_thread_t* t, linked_list_t* list, int num_ops, op_t* ops){
+	static const uint32_t kinds[] = { HIST_INSERT, HIST_REMOVE, HIST_FIND,
+		HIST_UPDATE, HIST_COMPUTE, HIST_UPSERT, HIST_UPDATE_IF, HIST_GET_OR_INSERT };
+	int i;
+	if(!list || num_ops <= 0 || !ops){
+		list_batch(list, num_ops, ops);
+		return;
+	}
+	if(t->count_ + (uint32_t)num_ops > g_capacity)
+		flush_thread(t);
+	uint64_t invoke = stamp_invoke();
+	list_batch(list, num_ops, ops);
+	uint64_t response = stamp_response();
+	for(i=0;i<num_ops;i++){
+		hist_event_t* e = next_event(t);
+		e->op = kinds[ops[i].op];
+		e->key = ops[i].key;
+		e->invoke = invoke;
+		e->response = response;
+		e->result = ops[i].result;
+		e->data = (uint64_t)(uintptr_t)ops[i].data;
+		e->expected = (uint64_t)(uintptr_t)ops[i].expected;
+		if(ops[i].op == COMPUTE){
+			e->flags = HIST_F_NO_OUT;
+			e->func = (uint64_t)(uintptr_t)ops[i].compute_func;
+			e->computed = (int32_t)(intptr_t)ops[i].data;	// list_batch stored the result there
+			e->data = 0;
+		}
+		else if(ops[i].op == GET_OR_INSERT)
+			e->out = e->data;	// list_batch stored the found data back
+	}
+}
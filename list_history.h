@@ -0,0 +1,74 @@
+#ifndef __LIST_HISTORY_H_
+#define __LIST_HISTORY_H_
+
+#include <stdint.h>
+#include "my_list.h"
+
+/*
+ * History recorder for the my_list.h API. Every wrapped call is logged as one
+ * event holding its invoke and response timestamps, arguments and outcome,
+ * into a per-thread ring buffer that is flushed to the history file whenever
+ * it fills up. The file is checked offline by HW3_Linearizability_Checker_E.
+ */
+
+#define HIST_MAGIC		0x5349484cU	/* "LHIS" */
+#define HIST_VERSION	2
+
+typedef enum {
+	HIST_INSERT, HIST_REMOVE, HIST_FIND, HIST_UPDATE, HIST_COMPUTE,
+	HIST_UPSERT, HIST_UPDATE_IF, HIST_GET_OR_INSERT
+} hist_op_t;
+
+/* on-disk layout: a hist_header_t followed by chunks, each of them a
+ * hist_chunk_t followed by count hist_event_t records. */
+typedef struct hist_header_t{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t event_size;
+	uint32_t reserved;
+} hist_header_t;
+
+typedef struct hist_chunk_t{
+	uint32_t thread;
+	uint32_t count;
+} hist_chunk_t;
+
+typedef struct hist_event_t{
+	uint64_t invoke;	/* timestamp taken before the call */
+	uint64_t response;	/* timestamp taken after the call returned */
+	uint64_t data;		/* data argument */
+	uint64_t expected;	/* expected argument of UPDATE_IF */
+	uint64_t out;		/* data observed by COMPUTE / GET_OR_INSERT */
+	uint64_t func;		/* compute_func of COMPUTE */
+	int32_t  key;
+	int32_t  result;
+	int32_t  computed;	/* what compute_func returned to COMPUTE */
+	uint32_t op;
+	uint32_t flags;
+	uint32_t reserved;
+} hist_event_t;
+
+#define HIST_F_NO_OUT	1	/* the data the op observed is unknown */
+#define HIST_MEMO_LISTS	16	/* lists hist_set_option knows to memoize */
+
+typedef struct hist_thread_t hist_thread_t;
+
+int hist_open(const char* path, int events_per_thread);
+int hist_close();
+hist_thread_t* hist_thread(int thread);
+int hist_set_option(linked_list_t* list, int option, long value);
+
+int hist_insert(hist_thread_t* t, linked_list_t* list, int key, void* data);
+int hist_remove(hist_thread_t* t, linked_list_t* list, int key);
+int hist_find(hist_thread_t* t, linked_list_t* list, int key);
+int hist_update(hist_thread_t* t, linked_list_t* list, int key, void* data);
+int hist_compute(hist_thread_t* t, linked_list_t* list, int key,
+				 int (*compute_func) (void *), int* result);
+int hist_upsert(hist_thread_t* t, linked_list_t* list, int key, void* data);
+int hist_update_if(hist_thread_t* t, linked_list_t* list, int key,
+				   void* expected, void* data);
+int hist_get_or_insert(hist_thread_t* t, linked_list_t* list, int key,
+					   void* data, void** result);
+void hist_batch(hist_thread_t* t, linked_list_t* list, int num_ops, op_t* ops);
+
+#endif /* __LIST_HISTORY_H_ */
@@ -0,0 +1,49 @@
+#ifndef __LIST_REPLAY_H_
+#define __LIST_REPLAY_H_
+
+#include <stdint.h>
+
+/*
+ * Binary layout of the op streams written by HW3_Random_Test_Generator_B with
+ * -stream and run by HW3_Replay_Harness_H: a replay_header_t followed by
+ * replay_record_t records, the last of them a REPLAY_END. Every record holds
+ * the expected outcome of its op, so neither side keeps more than the list
+ * and a fixed buffer, however long the stream is. A REPLAY_BATCH record is
+ * followed by the key of it records making up the batch, at most
+ * REPLAY_MAX_BATCH, each on a different key so their results do not depend
+ * on the order the ops run in.
+ */
+
+#define REPLAY_MAGIC		0x4c50524cU	/* "LRPL" */
+#define REPLAY_VERSION		1
+#define REPLAY_MAX_BATCH	1024
+
+typedef enum {
+	REPLAY_INSERT, REPLAY_REMOVE, REPLAY_CONTAINS, REPLAY_UPDATE, REPLAY_COMPUTE,
+	REPLAY_SIZE, REPLAY_BATCH, REPLAY_END
+} replay_op_t;
+
+typedef struct replay_header_t{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t record_size;
+	uint32_t key_range;		/* keys are in [-(key_range / 2), key_range -
+							 * key_range / 2), -100 to 100 for 201 */
+} replay_header_t;
+
+typedef struct replay_record_t{
+	int32_t  key;		/* the expected size for SIZE, the number of ops for
+						 * BATCH */
+	uint8_t  op;		/* replay_op_t */
+	uint8_t  name;		/* data argument, or the data COMPUTE expects */
+	uint16_t flags;
+} replay_record_t;
+
+#define REPLAY_F_FAIL	1	/* the op fails, or CONTAINS does not find */
+
+/* the data of the ops, by name */
+#define REPLAY_NAMES	{ "Sansa", "Tommen", "Jorah", "Tywin", "Robb", "Arya", \
+						  "Cersei", "Jaime", "Daenerys", "Jon", "Lyanna", "Rhaegar" }
+#define REPLAY_NUM_NAMES	12
+
+#endif /* __LIST_REPLAY_H_ */
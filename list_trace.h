@@ -0,0 +1,33 @@
+#ifndef __LIST_TRACE_H_
+#define __LIST_TRACE_H_
+
+#include <stdint.h>
+
+/*
+ * Binary layout of the files written by list_trace_dump() when my_list.c is
+ * built with -DLIST_TRACE: a trace_header_t followed by count trace_record_t
+ * records, in no particular order. Timestamps are CLOCK_MONOTONIC
+ * nanoseconds. HW3_Trace_Converter_F turns a dump into a Chrome trace.
+ */
+
+#define TRACE_MAGIC		0x4352544cU	/* "LTRC" */
+#define TRACE_VERSION	1
+
+typedef struct trace_header_t{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t record_size;
+	uint32_t count;
+} trace_header_t;
+
+typedef struct trace_record_t{
+	uint64_t start;		/* entry into the API call */
+	uint64_t end;		/* return from the API call */
+	uint64_t lock_wait;	/* time spent blocked on contended locks */
+	uint32_t thread;	/* kernel thread id of the caller */
+	int32_t  key;		/* key of the call, num_ops for list_batch */
+	int32_t  result;
+	uint32_t op;		/* LIST_OP_* of my_list.h */
+} trace_record_t;
+
+#endif /* __LIST_TRACE_H_ */
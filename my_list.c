@@ -8,11 +8,23 @@
 //----------------------------------<INCLUDE>---------------------------------*/
 //*****************************************************************************/
 
+#define _GNU_SOURCE
 #include <stdlib.h>
 #include <limits.h>
 #include <pthread.h>
 #include "my_list.h"
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include "list_trace.h"
 
 
 //*****************************************************************************/
@@ -26,11 +38,28 @@
 #define REMOVE_ERROR	-4
 #define NOT_EX_ERROR	-5
 #define LIST_FREE_ERROR -6
+#define MISMATCH_ERROR	-7
 #define FAILURE_ERROR   -10
+#define FILE_ERROR		-8
+#define FORMAT_ERROR	-9
+#define DISABLED_ERROR	-11
+#define TIMEOUT_ERROR	-12
 
 #define VALUE_FOUND 	1
 #define VALUE_NOT_FOUND	0
 
+#define IMAGE_MAGIC		0x474d494cU	// "LIMG"
+#define IMAGE_VERSION	2
+#define WAL_MAGIC		0x4c41574cU	// "LWAL"
+#define WAL_VERSION		1
+#define SHM_MAGIC		0x4c4d4853U	// "SHML"
+#define SHM_VERSION		1
+
+#define BATCH_FIRST_NS		1000		// time per op assumed for a new list
+#define BATCH_INLINE_NS		20000		// a batch expected to take less runs inline
+#define BATCH_FAN_OUT_NS	1000000		// ops slower than this get a thread each
+#define BATCH_LOCAL_OPS		16			// wrappers of an inline batch on the stack
+
 //*****************************************************************************/
 //----------------------------------<MACROS>----------------------------------*/
 //*****************************************************************************/
@@ -38,10 +67,12 @@
 #define link_node(prev,node,curr)	(node)->next_ = (curr);\
 									(node)->prev_ = (prev);\
 									(prev)->next_ = (node);\
-									(curr)->prev_ = (node)
+									(curr)->prev_ = (node);\
+									index_link(node)
 
 
-#define unlink_node(node)			(node)->prev_->next_ = (node)->next_;\
+#define unlink_node(node)			index_unlink(node);\
+									(node)->prev_->next_ = (node)->next_;\
 									(node)->next_->prev_ = (node)->prev_
 
 #define get_first_node(list) 	((list)->first_anchor_->next_)
@@ -49,18 +80,28 @@
 #define get_first_anchor(list) 	((list)->first_anchor_)
 #define get_last_anchor(list)	((list)->last_anchor_)
 
+#if defined(LIST_STATS) || defined(LIST_TRACE)
+#define LIST_INSTRUMENTED
+#endif
+
+#ifdef LIST_INSTRUMENTED
+#define raw_lock(mutex,list,cls)	(timed_lock((mutex),(list),(cls)))
+#else
+#define raw_lock(mutex,list,cls)	(pthread_mutex_lock(mutex))
+#endif
+
 #define init_data_lock(node)	(pthread_mutex_init(&((node)->data_lock_), NULL))
-#define lock_data(node)			(pthread_mutex_lock(&((node)->data_lock_)))
+#define lock_data(node)			raw_lock(&((node)->data_lock_),(node)->list_,LIST_LOCK_DATA)
 #define unlock_data(node)		(pthread_mutex_unlock(&((node)->data_lock_)))
 #define destroy_data_lock(node)	(pthread_mutex_destroy(&((node)->data_lock_)))
 
 #define init_node_lock(node)	(pthread_mutex_init(&((node)->node_lock_), NULL))
-#define lock_node(node)			(pthread_mutex_lock(&((node)->node_lock_)))
+#define lock_node(node)			raw_lock(&((node)->node_lock_),(node)->list_,LIST_LOCK_NODE)
 #define unlock_node(node)		(pthread_mutex_unlock(&((node)->node_lock_)))
 #define destroy_node_lock(node)	(pthread_mutex_destroy(&((node)->node_lock_)))
 
 #define init_cont_lock(list)	(pthread_mutex_init(&((list)->main_lock_), NULL))
-#define lock_container(list)	(pthread_mutex_lock(&((list)->main_lock_)))
+#define lock_container(list)	raw_lock(&((list)->main_lock_),(list),LIST_LOCK_MAIN)
 #define unlock_container(list)	(pthread_mutex_unlock(&((list)->main_lock_)))
 #define destroy_cont_lock(list) (pthread_mutex_destroy(&((list)->main_lock_)))
 
@@ -76,6 +117,55 @@
 #define unlock_and_destroy(node)	unlock_node(node);\
 									destroy_node(node)
 
+#define unlock_and_retire(node)		unlock_node(node);\
+									epoch_retire(node)
+
+#define advance_node(prev,curr)		stats_hop();\
+									(curr) = (curr)->next_;\
+									lock_node(curr);\
+									prefetch_ahead(curr);\
+									unlock_node(prev);\
+									(prev) = (curr)->prev_
+
+#define set_data(node,value)		do { (node)->data_ = (value);\
+										 (node)->version_++;\
+									} while(0)
+
+#define unlock_pair(prev,curr)		unlock_node(curr);\
+									unlock_node(prev)
+
+#define align8(value)	(((value) + 7) & ~((uint64_t)7))
+
+#define is_key_node(list,node,key)	((node) != get_last_anchor(list) && \
+									 (node)->key_ == (key))
+
+#ifdef LIST_INSTRUMENTED
+#define stats_hop()					(tls_hops++)
+#define op_begin(kind,key)			const int op_kind_ = (kind);\
+									const int op_key_ = (key);\
+									const unsigned long long op_start_ = instr_begin();\
+									epoch_enter()
+#define op_return(list,val)			do { int op_res_ = wal_done(val);\
+										 instr_end((list),op_kind_,op_key_,op_start_,op_res_);\
+										 epoch_exit();\
+										 return op_res_; } while(0)
+#define op_return_void(list)		do { instr_end((list),op_kind_,op_key_,op_start_,SUCCES);\
+										 epoch_exit();\
+										 return; } while(0)
+#else
+#define stats_hop()
+#define op_begin(kind,key)			epoch_enter()
+#define op_return(list,val)			do { int op_res_ = wal_done(val);\
+										 epoch_exit();\
+										 return op_res_; } while(0)
+#define op_return_void(list)		do { epoch_exit();\
+										 return; } while(0)
+#endif
+
+#define wal_log(list,key,present,data)	if((list)->wal_)\
+											wal_note((list)->wal_,(key),(present),(data))
+#define wal_done(val)				(tls_wal_own.count_ ? wal_commit_own(val) : (val))
+
 //*****************************************************************************/
 //----------------------------------<STRUCT>----------------------------------*/
 //*****************************************************************************/
@@ -84,19 +174,203 @@ typedef struct linked_list_node_t* linked_list_node;
 
 typedef struct linked_list_t* linked_list;
 
+#define HOME_HEAP		-1	// home_ of a malloc'd node, NUMA pool nodes have their node
+#define HOME_CHUNK		-2	// home_ of a node list_compact moved into a chunk
+
 /**
  * linked_list_node_t : defination of a single node in the linked list.
  */
 struct linked_list_node_t{
 	int 				key_;
+	int 				home_;		// where its memory comes from, HOME_*
 	void* 				data_;
 	pthread_mutex_t 	data_lock_;
 	linked_list_node 	prev_;
 	linked_list_node 	next_;
 	linked_list			list_;
 	pthread_mutex_t 	node_lock_;
+	unsigned 			version_;		// bumped by every write of data_
+	unsigned 			memo_seq_;		// odd while the memo is written
+	int 				(*memo_func_) (void *);
+	int 				memo_result_;	// of memo_func_ on version memo_version_
+	unsigned 			memo_version_;
+	int 				levels_;		// in the index of its list, 0 if none
+	int 				up_lock_;		// of its links, see index_lock
+	void* 				indexed_;		// the index it is linked in, or NULL
+	linked_list_node* 	up_;			// its links in levels [0, levels_)
 };
 
+#define INDEX_LEVELS	16	// of a skip list index, enough for 4^16 keys
+
+/**
+ * list_index_t : the skip list index of a list created with
+ * LIST_BACKEND_SKIPLIST. Level i links, in key order, the nodes with more
+ * than i levels through their up_ links, and the list itself is below it.
+ */
+typedef struct list_index_t{
+	linked_list_node head_[INDEX_LEVELS];
+	int 			 head_locks_[INDEX_LEVELS];	// of the links of the head
+} list_index;
+
+/**
+ * index_backend_t : the index a list backend keeps over the nodes of a list,
+ * see list_alloc_backend. link_ and unlink_ are called by link_node and
+ * unlink_node, find_ returns the last node before a key the index knows of.
+ */
+typedef struct index_backend_t{
+	void* 			 (*create_) (void);
+	void 			 (*destroy_) (void* index);
+	int 			 (*levels_) (void);		// draws those of a new node, or NULL
+	void 			 (*link_) (void* index, linked_list_node node);
+	void 			 (*unlink_) (void* index, linked_list_node node);
+	linked_list_node (*find_) (void* index, int key);
+} index_backend;
+
+/**
+ * list_image_t : a snapshot file mapped by list_load. Nodes loaded from it
+ * point into the mapping, so it is shared by every list holding such nodes
+ * (list_split hands it to all the new lists) and unmapped with the last one.
+ */
+typedef struct list_image_t{
+	void* 					base_;
+	size_t 					length_;
+	int 					refs_;
+	struct list_image_t* 	next_;	// the recovered log, owned by this image
+} list_image;
+
+/**
+ * image_header_t : the header of a snapshot file. It is followed by count int
+ * keys in ascending order, padded to 8 bytes, and count 64 bit values. If
+ * data_size is 0 the values are the data pointers themselves, otherwise they
+ * are file offsets of data_size byte payloads (0 for NULL data) that follow,
+ * each one aligned to 8 bytes. lsn is the log sequence number the snapshot
+ * covers, every log entry up to it is already reflected in the snapshot.
+ */
+typedef struct image_header_t{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t data_size;
+	uint64_t count;
+	uint64_t lsn;
+} image_header;
+
+/**
+ * list_wal_t : the write-ahead log of a list. Callers append their records to
+ * buf_ and wait for them to become durable. Whoever finds no write in
+ * progress becomes the leader, writes the whole buffer with a single
+ * fdatasync and wakes the followers, so concurrent callers share one sync.
+ */
+typedef struct list_wal_t{
+	int 			fd_;
+	char* 			path_;
+	uint64_t 		data_size_;
+	uint64_t 		next_lsn_;	// the last sequence number handed out
+	pthread_mutex_t lock_;
+	pthread_cond_t 	cond_;
+	char* 			buf_;		// records waiting for the next leader
+	size_t 			len_;
+	size_t 			cap_;
+	char* 			spare_;		// the buffer the current leader writes
+	size_t 			spare_cap_;
+	uint64_t 		appended_;	// records appended so far
+	uint64_t 		durable_;	// records synced so far
+	int 			syncing_;
+	int 			error_;		// sticky, set by a failed write
+} list_wal;
+
+/**
+ * wal_header_t / wal_record_t / wal_entry_t : the layout of a log file. The
+ * header is followed by records, each one holding count entries in length
+ * bytes and guarded by a checksum, so a record torn by a crash ends the log.
+ * An entry is the state a mutation left its key in: present or not, and the
+ * data, which is followed by its payload when the log copies payloads.
+ */
+typedef struct wal_header_t{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t data_size;
+} wal_header;
+
+typedef struct wal_record_t{
+	uint32_t count;
+	uint32_t length;
+	uint64_t checksum;
+} wal_record;
+
+typedef struct wal_entry_t{
+	uint64_t lsn;
+	int32_t  key;
+	uint32_t flags;
+	uint64_t value;
+} wal_entry;
+
+#define WAL_PRESENT		1
+#define WAL_PAYLOAD		2
+
+/**
+ * wal_buffer_t : entries logged by a thread and not yet appended to the log.
+ */
+typedef struct wal_buffer_t{
+	list_wal* 	wal_;
+	char* 		data_;
+	size_t 		len_;
+	size_t 		cap_;
+	uint32_t 	count_;
+	int 		error_;
+} wal_buffer;
+
+#define FC_SLOTS		64	// publication slots of a combining list
+
+/**
+ * fc_slot_t : a publication slot of a combining list. A thread publishes its
+ * op in a free slot and waits until a combiner has applied it and cleared
+ * the slot. Slots never share a cache line.
+ */
+typedef struct fc_slot_t{
+	op_t* op_;
+} __attribute__((aligned(64))) fc_slot;
+
+/**
+ * combiner_t : the publication array of a list in flat-combining mode. The
+ * thread holding lock_ applies every published op in a single sorted sweep.
+ */
+typedef struct combiner_t{
+	fc_slot 		slots_[FC_SLOTS];
+	pthread_mutex_t lock_;
+} combiner;
+
+/**
+ * shm_node_t : a node of a shared list. Links are offsets from the start of
+ * its region, which every process maps at an address of its own, and the
+ * data of the node follows it in the region.
+ */
+typedef struct shm_node_t{
+	uint64_t 		prev_;
+	uint64_t 		next_;
+	int 			key_;
+	pthread_mutex_t node_lock_;
+	pthread_mutex_t data_lock_;
+} shm_node;
+
+/**
+ * shm_region_t : the header of the shared memory region of a shared list,
+ * followed by its two anchors and room for its nodes.
+ */
+typedef struct shm_region_t{
+	uint32_t 		magic_;
+	uint32_t 		version_;
+	uint32_t 		ready_;		// set once the creator is done
+	uint32_t 		pad_;
+	uint64_t 		size_;		// of the whole region
+	uint64_t 		data_size_;
+	uint64_t 		node_size_;
+	uint64_t 		first_;
+	uint64_t 		last_;
+	uint64_t 		brk_;		// the first never used node
+	uint64_t 		free_;		// freed nodes, chained through next_
+	pthread_mutex_t lock_;		// of brk_ and free_
+} shm_region;
+
 /**
  * linked_list_t : defination of a single linked list.
  */
@@ -104,281 +378,3426 @@ struct linked_list_t{
 	linked_list_node first_anchor_;
 	linked_list_node last_anchor_;
 	pthread_mutex_t  main_lock_;
+	list_image* 	 image_;
+	list_wal* 		 wal_;
+	combiner* 		 fc_;		// set in flat-combining mode
+	int 			 eliminate_;	// LIST_OPT_ELIMINATION
+	int 			 numa_;			// LIST_OPT_NUMA_NODE
+	int 			 prefetch_;		// LIST_OPT_PREFETCH
+	int 			 memoize_;		// LIST_OPT_MEMOIZE
+	int 			 exclusive_;	// LIST_OPT_EXCLUSIVE_COMPUTE
+	shm_region* 	 shm_;			// set for a shared list
+	void* 			 index_;		// set for the backends with an index
+	const index_backend* backend_;	// of index_
+	int 			 walkers_;		// walks of walk_begin, no call enters the index
+	unsigned long long batch_ns_;	// recent time per batch op, for list_batch
+#ifdef LIST_STATS
+	struct stats_slot_t* stats_;
+#endif
 };
 
 //*****************************************************************************/
-//-----------------------------<STATIC FUNCTIONS>-----------------------------*/
+//------------------------------<INSTRUMENTATION>-----------------------------*/
 //*****************************************************************************/
 
+#ifdef LIST_INSTRUMENTED
+
+static __thread unsigned long long 	tls_hops;		// nodes walked by the call
+static __thread unsigned long long 	tls_lock_wait;	// ns blocked by the call
+
+static inline unsigned long long instr_now(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+#endif /* LIST_INSTRUMENTED */
+
+#ifdef LIST_STATS
+
+#define STATS_SLOTS		16
+#define CACHE_LINE		64
+
 /**
- * init_first_anchor : initializes the anchor at the beginning of the link list.
+ * stats_slot_t : the counters of one group of threads. Every thread always
+ * updates the same slot, and slots never share a cache line, so threads only
+ * contend on counters when there are more of them than STATS_SLOTS.
  */
-static inline void init_first_anchor(linked_list list){
-	list->first_anchor_->prev_ 	= NULL;
-	list->first_anchor_->next_ 	= get_last_anchor(list);
-	list->first_anchor_->list_	= list;
-	list->first_anchor_->key_	= INT_MIN;
-	init_node_locks(list->first_anchor_);
+typedef struct stats_slot_t{
+	list_stats_t counters_;
+} __attribute__((aligned(CACHE_LINE))) stats_slot;
+
+static unsigned int 				g_stats_threads;
+static __thread int 				tls_stats_slot = -1;
+
+#define stats_add(counter,val)	(__atomic_fetch_add(&(counter),(val),__ATOMIC_RELAXED))
+
+static inline int stats_bucket(unsigned long long value){
+	int bucket = value ? 64 - __builtin_clzll(value) : 0;
+	return bucket < LIST_STATS_BUCKETS ? bucket : LIST_STATS_BUCKETS - 1;
+}
+
+static inline list_stats_t* stats_of(linked_list list){
+	if(tls_stats_slot < 0)
+		tls_stats_slot = (int)(__atomic_fetch_add(&g_stats_threads, 1,
+							__ATOMIC_RELAXED) % STATS_SLOTS);
+	return &(list->stats_[tls_stats_slot].counters_);
 }
 
 /**
- * init_last_anchor : initializes the anchor at the end of the link list.
+ * stats_op : accounts a finished API call of the given kind.
  */
-static inline void init_last_anchor(linked_list list){
-	list->last_anchor_->prev_ 	= get_first_anchor(list);
-	list->last_anchor_->next_ 	= NULL;
-	list->last_anchor_->list_	= list;
-	list->last_anchor_->key_	= INT_MAX;
-	init_node_locks(list->last_anchor_);
+static inline void stats_op(linked_list list, int kind, unsigned long long latency,
+							int res){
+	list_stats_t* stats = stats_of(list);
+	stats_add(stats->ops[kind], 1);
+	if(res < 0)
+		stats_add(stats->op_errors[kind], 1);
+	stats_add(stats->op_ns[kind], latency);
+	stats_add(stats->op_latency_hist[kind][stats_bucket(latency)], 1);
+	if(kind != LIST_OP_BATCH)
+		stats_add(stats->traversal_hist[stats_bucket(tls_hops)], 1);
+}
+
+#endif /* LIST_STATS */
+
+#ifdef LIST_TRACE
+
+#define TRACE_RING		4096	// records per thread, a power of two
+
+/**
+ * trace_ring_t : the flight recorder of one thread. Only its owner writes into
+ * it, publishing each record by advancing head_, so recording never locks.
+ * Rings of exited threads are handed to new threads instead of being freed.
+ */
+typedef struct trace_ring_t{
+	unsigned long long 		head_;
+	int 					in_use_;
+	struct trace_ring_t* 	next_;
+	trace_record_t 			records_[TRACE_RING];
+} trace_ring;
+
+static trace_ring* 			g_trace_rings;
+static pthread_key_t 		g_trace_key;
+static pthread_once_t 		g_trace_once = PTHREAD_ONCE_INIT;
+static __thread trace_ring* tls_trace_ring;
+static __thread uint32_t 	tls_trace_tid;
+
+static void trace_release(void* ring){
+	__atomic_store_n(&(((trace_ring*)ring)->in_use_), 0, __ATOMIC_RELEASE);
+}
+
+static void trace_init_key(){
+	pthread_key_create(&g_trace_key, trace_release);
 }
 
 /**
- * destroy_node : destroys the given node.
+ * trace_ring_of_thread : returns the ring of the calling thread, claiming a
+ * released ring or registering a new one on the thread's first traced call.
  */
-static inline void destroy_node(linked_list_node node){
-	destroy_node_locks(node);
-	free(node);
+static trace_ring* trace_ring_of_thread(){
+	trace_ring* ring;
+	int unused = 0;
+	pthread_once(&g_trace_once, trace_init_key);
+	for(ring = __atomic_load_n(&g_trace_rings, __ATOMIC_ACQUIRE); ring; ring = ring->next_){
+		if(!__atomic_load_n(&(ring->in_use_), __ATOMIC_RELAXED) &&
+		   __atomic_compare_exchange_n(&(ring->in_use_), &unused, 1, 0,
+									   __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+			break;
+		unused = 0;
+	}
+	if(!ring){
+		ring = (trace_ring*) calloc(1, sizeof(*ring));
+		if(!ring)
+			return NULL;
+		ring->in_use_ = 1;
+		ring->next_ = __atomic_load_n(&g_trace_rings, __ATOMIC_RELAXED);
+		while(!__atomic_compare_exchange_n(&g_trace_rings, &(ring->next_), ring, 1,
+										   __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+	}
+	pthread_setspecific(g_trace_key, ring);
+	tls_trace_tid = (uint32_t) syscall(SYS_gettid);
+	return tls_trace_ring = ring;
+}
+
+/**
+ * trace_op : appends a finished API call to the calling thread's ring.
+ */
+static inline void trace_op(int kind, int key, unsigned long long start,
+							unsigned long long end, int res){
+	trace_ring* ring = tls_trace_ring;
+	if(!ring && !(ring = trace_ring_of_thread()))
+		return;
+	unsigned long long head = ring->head_;
+	trace_record_t* rec = &(ring->records_[head & (TRACE_RING - 1)]);
+	rec->start 		= start;
+	rec->end 		= end;
+	rec->lock_wait 	= tls_lock_wait;
+	rec->thread 	= tls_trace_tid;
+	rec->key 		= key;
+	rec->result 	= res;
+	rec->op 		= (uint32_t) kind;
+	__atomic_store_n(&(ring->head_), head + 1, __ATOMIC_RELEASE);
+}
+
+#endif /* LIST_TRACE */
+
+#ifdef LIST_INSTRUMENTED
+
+/**
+ * timed_lock : locks the given mutex, timing the wait only if the lock is
+ * contended, so uncontended acquisitions cost a single trylock.
+ */
+static inline int timed_lock(pthread_mutex_t* mutex, linked_list list, int cls){
+#ifdef LIST_STATS
+	list_stats_t* stats = stats_of(list);
+	stats_add(stats->lock_acquires[cls], 1);
+#endif
+	if(!pthread_mutex_trylock(mutex))
+		return SUCCES;
+	unsigned long long start = instr_now();
+	int res = pthread_mutex_lock(mutex);
+	unsigned long long wait = instr_now() - start;
+#ifdef LIST_STATS
+	stats_add(stats->lock_contended[cls], 1);
+	stats_add(stats->lock_wait_ns[cls], wait);
+	stats_add(stats->lock_wait_hist[cls][stats_bucket(wait)], 1);
+#endif
+	tls_lock_wait += wait;
+	return res;
+}
+
+static inline unsigned long long instr_begin(){
+	tls_hops = 0;
+	tls_lock_wait = 0;
+	return instr_now();
+}
+
+/**
+ * instr_end : accounts a finished API call in every enabled instrument.
+ */
+static inline void instr_end(linked_list list, int kind, int key,
+							 unsigned long long start, int res){
+	unsigned long long end = instr_now();
+#ifdef LIST_STATS
+	stats_op(list, kind, end - start, res);
+#endif
+#ifdef LIST_TRACE
+	trace_op(kind, key, start, end, res);
+#endif
 }
 
+#endif /* LIST_INSTRUMENTED */
+
 //*****************************************************************************/
-//--------------------------------<FUNCTIONS>---------------------------------*/
+//----------------------------<EPOCH RECLAMATION>-----------------------------*/
 //*****************************************************************************/
 
+/*
+ * Every API call runs inside an epoch critical section. Removed nodes (and
+ * freed lists) are retired instead of being destroyed, and destroyed only
+ * once every thread inside a critical section has left it, so a compute
+ * still running on a node never waits for, nor is waited for by, its
+ * remover. A global epoch advances once no active thread lags behind it,
+ * and the nodes retired two epochs ago are then destroyed.
+ */
+
+#define EPOCH_ACTIVE	1UL
+#define EPOCH_BATCH		64	// retires between attempts to advance the epoch
+
 /**
- * list_alloc : Creates a new linked list.
- *
- * input		: N/A
- *
- * output		: N/A
- *
- * return value	: A new linked list.
+ * epoch_thread_t : the epoch a thread entered its critical section in, and
+ * whether it is inside one. Records of exited threads are reused.
  */
-linked_list_t* list_alloc(){
-	linked_list list = (linked_list) malloc(sizeof(*list));
-	if(!list)
-		return NULL;
-	list->first_anchor_	= (linked_list_node) malloc(sizeof(*(list->first_anchor_)));
-	list->last_anchor_	= (linked_list_node) malloc(sizeof(*(list->last_anchor_)));
-	if(!list->last_anchor_ || !list->first_anchor_){
-		free(list);
-		return NULL;
-	}
-	init_first_anchor(list);
-	init_last_anchor(list);
-	init_cont_lock(list);
-	return list;
+typedef struct epoch_thread_t{
+	unsigned long 			state_;	// epoch << 1 | EPOCH_ACTIVE
+	int 					in_use_;
+	struct epoch_thread_t* 	next_;
+} __attribute__((aligned(64))) epoch_thread;
+
+static unsigned long 			g_epoch = 2;
+static epoch_thread* 			g_epoch_threads;
+static linked_list_node 		g_limbo[3];	// retired nodes, by epoch % 3
+static unsigned long 			g_retired;
+static pthread_key_t 			g_epoch_key;
+static pthread_once_t 			g_epoch_once = PTHREAD_ONCE_INIT;
+static __thread epoch_thread* 	tls_epoch;
+static __thread int 			tls_epoch_nest;
+
+static void reclaim_node(linked_list_node node);
+
+static void epoch_release(void* thread){
+	__atomic_store_n(&(((epoch_thread*)thread)->in_use_), 0, __ATOMIC_RELEASE);
+}
+
+static void epoch_init_key(){
+	pthread_key_create(&g_epoch_key, epoch_release);
 }
 
 /**
- * list_free : Free the given list.
- *
- * input		: list - the given list to free.
- *
- * output		: N/A
- *
- * return value	: N/A
+ * epoch_of_thread : returns the record of the calling thread, claiming a
+ * released record or registering a new one on the thread's first call.
  */
-void list_free(linked_list_t* list){
-	if (!list) return;
-	linked_list_node anchor, prev, curr;
-	lock_container(list);
-	anchor = get_first_anchor(list);
-	if(!anchor){	// if the lock was acquired after the list was freed
-		unlock_container(list);
+static epoch_thread* epoch_of_thread(){
+	epoch_thread* thread;
+	int unused = 0;
+	pthread_once(&g_epoch_once, epoch_init_key);
+	for(thread = __atomic_load_n(&g_epoch_threads, __ATOMIC_ACQUIRE); thread;
+		thread = thread->next_){
+		if(!__atomic_load_n(&(thread->in_use_), __ATOMIC_RELAXED) &&
+		   __atomic_compare_exchange_n(&(thread->in_use_), &unused, 1, 0,
+									   __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+			break;
+		unused = 0;
+	}
+	if(!thread){
+		if(posix_memalign((void**)&thread, sizeof(*thread), sizeof(*thread)))
+			abort();	// without a record no node could ever be reclaimed
+		thread->state_ = 0;
+		thread->in_use_ = 1;
+		thread->next_ = __atomic_load_n(&g_epoch_threads, __ATOMIC_RELAXED);
+		while(!__atomic_compare_exchange_n(&g_epoch_threads, &(thread->next_), thread,
+										   1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+	}
+	pthread_setspecific(g_epoch_key, thread);
+	return thread;
+}
+
+static inline void epoch_enter(){
+	if(tls_epoch_nest++)
 		return;
+	if(!tls_epoch)
+		tls_epoch = epoch_of_thread();
+	unsigned long epoch = __atomic_load_n(&g_epoch, __ATOMIC_RELAXED);
+	__atomic_store_n(&(tls_epoch->state_), epoch << 1 | EPOCH_ACTIVE, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+static inline void epoch_exit(){
+	if(!--tls_epoch_nest)
+		__atomic_store_n(&(tls_epoch->state_), 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * epoch_advance : moves the global epoch one step forward, unless a thread is
+ * still inside a critical section entered in an older epoch, and destroys the
+ * nodes that were retired two epochs before the new one.
+ */
+static int epoch_advance(){
+	unsigned long epoch = __atomic_load_n(&g_epoch, __ATOMIC_ACQUIRE);
+	epoch_thread* thread;
+	linked_list_node node, next;
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	for(thread = __atomic_load_n(&g_epoch_threads, __ATOMIC_ACQUIRE); thread;
+		thread = thread->next_){
+		unsigned long state = __atomic_load_n(&(thread->state_), __ATOMIC_ACQUIRE);
+		if((state & EPOCH_ACTIVE) && (state >> 1) != epoch)
+			return 0;
 	}
-	get_first_anchor(list) = NULL;	// unlink anchor from list
-	lock_node(anchor);
-	unlock_container(list);
-	prev = anchor;
-	curr = anchor->next_;
-	lock_node(curr);	// so if the node currently in use the process will wait.
-	while(curr != get_last_anchor(list)){
-		prev = curr;
-		curr = curr->next_;
-		lock_node(curr);
-		lock_data(prev);
-		unlock_data(prev);
-		unlock_and_destroy(prev);
+	if(!__atomic_compare_exchange_n(&g_epoch, &epoch, epoch + 1, 0,
+									__ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+		return 0;
+	node = __atomic_exchange_n(&g_limbo[(epoch + 2) % 3], NULL, __ATOMIC_ACQUIRE);
+	for(;node;node = next){
+		next = node->prev_;
+		reclaim_node(node);
 	}
-	unlock_and_destroy(anchor);
-	unlock_and_destroy(curr);
-	destroy_cont_lock(list);
-	free(list);
+	return 1;
 }
 
 /**
- * list_split : Splits the given array into n new lists alternately.
- * the new lists will be stored in the given array and the original array will
- * be free. If there are fewer than n elements in the original list, an empty
- * lists will be generated up to a total of n lists.
- *
- * input		: list 	- the given list.
- * 				: n 	- the number of lists to split to.
- *
- * output		: arr 	- an array to add the new lists to.
- *
- * return value	: 0 in case of success or anything else in case of failure.
+ * epoch_retire : hands an unlinked node over to be destroyed once no thread
+ * can still be using it. Called inside a critical section. The node goes to
+ * the current global epoch, not to the one the caller entered in, which may
+ * be one behind: a thread that entered in the next one may still hold it.
  */
-int list_split(linked_list_t* list, int n, linked_list_t** arr){
-	if (!list || !arr || n <=0)	return PARAM_ERROR;
-	int i;
-	linked_list_node anchor, curr;
-	lock_container(list);
-	anchor = get_first_anchor(list);
-	if(!anchor){	// if the lock was acquired after the list was freed
-		unlock_container(list);
-		return LIST_FREE_ERROR;
+static void epoch_retire(linked_list_node node){
+	unsigned long epoch = __atomic_load_n(&g_epoch, __ATOMIC_SEQ_CST);
+	node->prev_ = __atomic_load_n(&g_limbo[epoch % 3], __ATOMIC_RELAXED);
+	while(!__atomic_compare_exchange_n(&g_limbo[epoch % 3], &(node->prev_), node,
+									   1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+	if(!(__atomic_add_fetch(&g_retired, 1, __ATOMIC_RELAXED) % EPOCH_BATCH))
+		epoch_advance();
+}
+
+//*****************************************************************************/
+//------------------------------<NUMA PLACEMENT>------------------------------*/
+//*****************************************************************************/
+
+/*
+ * The nodes of a list bound to a NUMA node are carved out of chunks whose
+ * pages are bound to that node with mbind(), and the threads of the library
+ * running its batches are pinned to the CPUs of that node. A batch running
+ * inline in the calling thread leaves it as it is, as the affinity of that
+ * thread belongs to the application. Pools are per NUMA node, not
+ * per list, since list_split moves nodes between lists, and live for the
+ * life of the process. Built on the raw syscalls, so libnuma is not needed.
+ */
+
+#define NUMA_MAX_NODES	64
+#define NUMA_CHUNK		(1 << 20)	// bytes mapped at a time
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED	1
+#endif
+
+/**
+ * numa_pool_t : the free nodes and the unused part of the last chunk of one
+ * NUMA node, and the CPUs of that node. Nodes are taken under the lock and
+ * freed without it: a freed node is pushed onto free_ with a CAS, which a
+ * node taken and freed again in between cannot fool, as only the holder of
+ * the lock takes nodes.
+ */
+typedef struct numa_pool_t{
+	pthread_mutex_t 	lock_;
+	linked_list_node 	free_;		// chained through next_
+	char* 				next_;
+	char* 				end_;
+	cpu_set_t 			cpus_;
+	int 				ready_;
+} numa_pool;
+
+static numa_pool 		g_numa_pools[NUMA_MAX_NODES];
+static pthread_mutex_t 	g_numa_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread int 	tls_numa_pinned = -1;	// node the thread is pinned to
+static __thread cpu_set_t tls_numa_cpus;		// its CPUs before the first pin
+
+/**
+ * numa_init_node : prepares the pool of the given NUMA node, reading its
+ * CPUs from sysfs. Fails if the machine has no such node.
+ */
+static int numa_init_node(int node){
+	char path[64], list[4096], *p;
+	numa_pool* pool = &g_numa_pools[node];
+	FILE* file;
+	int res = SUCCES;
+	if(__atomic_load_n(&(pool->ready_), __ATOMIC_ACQUIRE))
+		return SUCCES;
+	pthread_mutex_lock(&g_numa_lock);
+	if(pool->ready_){
+		pthread_mutex_unlock(&g_numa_lock);
+		return SUCCES;
 	}
-	get_first_anchor(list) = NULL;	// unlink anchor from list
-	lock_node(anchor);
-	unlock_container(list);
-	for(i=0;i<n;i++){
-		arr[i] = list_alloc();
-		if (!(arr[i])){
-			for(;i>=0;i--)
-				list_free(arr[i]);
-			return ALLOC_ERROR;
+	snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+	file = fopen(path, "r");
+	if(!file || !fgets(list, sizeof(list), file))
+		res = node ? PARAM_ERROR : SUCCES;	// no sysfs: a single node machine
+	if(file)
+		fclose(file);
+	CPU_ZERO(&(pool->cpus_));
+	if(res == SUCCES && file){
+		for(p=list;*p >= '0' && *p <= '9';){	// "0-3,8-11"
+			long first = strtol(p, &p, 10), last = first, cpu;
+			if(*p == '-')
+				last = strtol(p + 1, &p, 10);
+			for(cpu=first;cpu<=last && cpu<CPU_SETSIZE;cpu++)
+				CPU_SET(cpu, &(pool->cpus_));
+			if(*p == ',')
+				p++;
 		}
 	}
-	i=0;
-	curr = anchor->next_;
-	lock_node(curr);	// so if the node currently in use the process will wait.
-	while(curr != get_last_anchor(list)){
-		lock_node(curr->next_);
-		unlink_node(curr);
-		link_node(get_last_node(arr[i]),curr,get_last_anchor(arr[i]));
-		curr->list_=arr[i];
-		i++;
-		if(i == n)
-			i=0;
-		unlock_node(curr);
-		curr = anchor->next_;
+	else if(res == SUCCES && sched_getaffinity(0, sizeof(cpu_set_t), &(pool->cpus_)))
+		res = PARAM_ERROR;
+	if(res == SUCCES){
+		pthread_mutex_init(&(pool->lock_), NULL);
+		__atomic_store_n(&(pool->ready_), 1, __ATOMIC_RELEASE);
 	}
-	unlock_and_destroy(anchor);
-	unlock_and_destroy(curr);
-	destroy_cont_lock(list);
-	free(list);
-	return SUCCES;
+	pthread_mutex_unlock(&g_numa_lock);
+	return res;
 }
 
 /**
- * list_insert : Inserts new node with the given data and key into the given
- * list. If a node with the given key already exist the function will fail.
- *
- * input		: list 	- the given list.
- * 				: key 	- the given key for the new node.
- * 				: data 	- the given data for the new node.
- *
- * output		: N/A
- *
- * return value	: 0 in case of success or anything else in case of failure.
+ * numa_bind : prefers the given NUMA node for the pages of a fresh mapping.
+ * Called before the pages are touched, a failure only loses the placement.
  */
-int list_insert(linked_list_t* list, int key, void* data){
-	if (!list)	return PARAM_ERROR;
-	linked_list_node prev, curr, new_node;
-	new_node = (linked_list_node) malloc(sizeof(*new_node));
-	if(!new_node)
-		return ALLOC_ERROR;
-	new_node->data_ = data;
-	new_node->key_ 	= key;
-	new_node->list_ = list;
-	init_node_locks(new_node);
-	lock_container(list);
-	prev = get_first_anchor(list);
-	if(!prev){	// if the lock was acquired after the list was freed
-		unlock_container(list);
-		destroy_node(new_node);
+static void numa_bind(void* addr, size_t length, int node){
+	unsigned long mask[NUMA_MAX_NODES / (8 * sizeof(unsigned long))] = { 0 };
+	mask[node / (8 * sizeof(unsigned long))] = 1UL << (node % (8 * sizeof(unsigned long)));
+	syscall(SYS_mbind, addr, length, MPOL_PREFERRED, mask, NUMA_MAX_NODES + 1, 0);
+}
+
+/**
+ * numa_take_node : returns memory for a list node on the given NUMA node, or
+ * NULL if there is none left. Called with the lock of its pool held.
+ */
+static linked_list_node numa_take_node(int node){
+	numa_pool* pool = &g_numa_pools[node];
+	linked_list_node res = __atomic_load_n(&(pool->free_), __ATOMIC_ACQUIRE);
+	while(res && !__atomic_compare_exchange_n(&(pool->free_), &res, res->next_, 1,
+											  __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+	if(res)
+		return res;
+	if(pool->next_ + sizeof(*res) > pool->end_){
+		char* chunk = (char*) mmap(NULL, NUMA_CHUNK, PROT_READ | PROT_WRITE,
+								   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if(chunk == MAP_FAILED)
+			return NULL;
+		numa_bind(chunk, NUMA_CHUNK, node);
+		pool->next_ = chunk;
+		pool->end_ = chunk + NUMA_CHUNK;
+	}
+	res = (linked_list_node) pool->next_;
+	pool->next_ += sizeof(*res);
+	return res;
+}
+
+static linked_list_node numa_alloc_node(int node){
+	linked_list_node res;
+	pthread_mutex_lock(&(g_numa_pools[node].lock_));
+	res = numa_take_node(node);
+	pthread_mutex_unlock(&(g_numa_pools[node].lock_));
+	return res;
+}
+
+static void numa_free_node(linked_list_node node){
+	numa_pool* pool = &g_numa_pools[node->home_];
+	node->next_ = __atomic_load_n(&(pool->free_), __ATOMIC_RELAXED);
+	while(!__atomic_compare_exchange_n(&(pool->free_), &(node->next_), node, 1,
+									   __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/**
+ * numa_pin : pins the calling thread to the CPUs of the given NUMA node, or
+ * gives it back the CPUs it had before its first pin for -1. Cheap when
+ * nothing changes.
+ */
+static void numa_pin(int node){
+	if(node == tls_numa_pinned)
+		return;
+	if(node >= 0){
+		if(tls_numa_pinned < 0 && sched_getaffinity(0, sizeof(cpu_set_t), &tls_numa_cpus))
+			return;				// nothing to go back to, stays where it is
+		sched_setaffinity(0, sizeof(cpu_set_t), &(g_numa_pools[node].cpus_));
+	}
+	else
+		sched_setaffinity(0, sizeof(cpu_set_t), &tls_numa_cpus);
+	tls_numa_pinned = node;
+}
+
+//*****************************************************************************/
+//--------------------------------<COMPACTION>--------------------------------*/
+//*****************************************************************************/
+
+/*
+ * list_compact copies the nodes of a list, in key order, into chunks of
+ * COMPACT_CHUNK bytes aligned to their size, so a node finds its chunk by
+ * masking its address. A chunk counts the nodes still living in it and is
+ * unmapped with the last one, whichever list it ended up in.
+ */
+
+#define COMPACT_CHUNK	(1 << 16)
+#define CHUNK_NODES		((COMPACT_CHUNK - sizeof(node_chunk)) / sizeof(struct linked_list_node_t))
+
+#define chunk_of(node)		((node_chunk*)((uintptr_t)(node) & ~(uintptr_t)(COMPACT_CHUNK - 1)))
+#define chunk_node(chunk,i)	((linked_list_node)((chunk) + 1) + (i))
+
+/**
+ * node_chunk_t : the header of a chunk, followed by CHUNK_NODES nodes.
+ */
+typedef struct node_chunk_t{
+	int refs_;	// nodes in the chunk, plus one while list_compact fills it
+	int used_;	// nodes handed out so far
+} __attribute__((aligned(64))) node_chunk;
+
+/**
+ * chunk_create : maps a new chunk, on the given NUMA node unless it is -1.
+ * Returns NULL if the mapping failed.
+ */
+static node_chunk* chunk_create(int numa){
+	char *base, *chunk;
+	base = (char*) mmap(NULL, 2 * COMPACT_CHUNK, PROT_READ | PROT_WRITE,
+						MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(base == MAP_FAILED)
+		return NULL;
+	chunk = (char*)(((uintptr_t)base + COMPACT_CHUNK - 1) & ~(uintptr_t)(COMPACT_CHUNK - 1));
+	if(chunk != base)
+		munmap(base, chunk - base);
+	munmap(chunk + COMPACT_CHUNK, base + COMPACT_CHUNK - chunk);
+	if(numa >= 0)
+		numa_bind(chunk, COMPACT_CHUNK, numa);
+	((node_chunk*)chunk)->refs_ = 1;
+	((node_chunk*)chunk)->used_ = 0;
+	return (node_chunk*)chunk;
+}
+
+/**
+ * chunk_release : drops a reference to the given chunk.
+ */
+static void chunk_release(node_chunk* chunk){
+	if(!__atomic_sub_fetch(&(chunk->refs_), 1, __ATOMIC_ACQ_REL))
+		munmap(chunk, COMPACT_CHUNK);
+}
+
+//*****************************************************************************/
+//----------------------------<SKIP LIST INDEX>-------------------------------*/
+//*****************************************************************************/
+
+/*
+ * A list created with LIST_BACKEND_SKIPLIST keeps a skip list index over its
+ * nodes, so a walk can start next to its key instead of at the first anchor.
+ * The list itself stays the only authority on which keys are in it: the index
+ * only hands out a node to start from, which the walk locks and checks is
+ * still linked before trusting it, and every call keeps the semantics of the
+ * plain list. A node gets its levels when it is created, a quarter of the
+ * nodes one level or more, and is linked into the index and out of it by
+ * link_node and unlink_node, under its node locks. Each link of the index
+ * is changed under the lock of the node it belongs to (or of the head), one
+ * level and one lock at a time, so inserts and removes far apart do not wait
+ * for each other. A change first checks that the node it starts from is
+ * still linked in this index and still next to the key, and searches again
+ * if not. Searches read the index without locks: keys never change and
+ * unlinked nodes keep their links until they are reclaimed, so a search
+ * running in an epoch always ends at a node that was in the index during the
+ * search.
+ */
+
+static __thread unsigned long long tls_index_rng;
+
+/**
+ * index_levels : draws the number of index levels of a new node, i with
+ * probability 3/4^(i+1).
+ */
+static int index_levels(){
+	unsigned long long x = tls_index_rng;
+	unsigned bits;
+	int levels = 0;
+	if(!x)	// every thread starts from its own seed
+		x = (unsigned long long)(uintptr_t)&tls_index_rng ^ 0x9E3779B97F4A7C15ULL;
+	x ^= x >> 12;	// xorshift64*
+	x ^= x << 25;
+	x ^= x >> 27;
+	tls_index_rng = x;
+	bits = (unsigned)((x * 0x2545F4914F6CDD1DULL) >> 32);
+	while(levels < INDEX_LEVELS && !(bits & 3)){
+		levels++;
+		bits >>= 2;
+	}
+	return levels;
+}
+
+/**
+ * index_tower : gives a new node of the given list its index levels. A node
+ * without them is only left out of the index.
+ */
+static inline void index_tower(linked_list list, linked_list_node node){
+	int levels = list->index_ && list->backend_->levels_ ? list->backend_->levels_() : 0;
+	node->levels_ = 0;
+	node->up_lock_ = 0;
+	node->indexed_ = NULL;
+	node->up_ = levels ? (linked_list_node*) malloc(sizeof(linked_list_node) * levels) : NULL;
+	if(node->up_)
+		node->levels_ = levels;
+}
+
+static void* index_create(){
+	return calloc(1, sizeof(list_index));
+}
+
+static void index_destroy(void* index){
+	free(index);
+}
+
+#define index_next(index,node,level)	__atomic_load_n((node) ? &((node)->up_[level]) :\
+												&((index)->head_[level]), __ATOMIC_ACQUIRE)
+
+/**
+ * index_find : searches the given index for the last node whose key is
+ * smaller than the given one, storing the last such node of every level in
+ * preds if it is not NULL. Returns NULL if the index has no such node.
+ */
+static linked_list_node index_find(list_index* index, int key, linked_list_node* preds){
+	linked_list_node pred = NULL, next;
+	int level;
+	for(level=INDEX_LEVELS-1;level>=0;level--){
+		next = index_next(index, pred, level);
+		while(next && next->key_ < key){
+			pred = next;
+			next = index_next(index, pred, level);
+		}
+		if(preds)
+			preds[level] = pred;
+	}
+	return pred;
+}
+
+/**
+ * index_set : points the link of the given level of pred, or of the head of
+ * the index if pred is NULL, at node.
+ */
+static inline void index_set(list_index* index, linked_list_node pred, int level,
+							 linked_list_node node){
+	__atomic_store_n(pred ? &(pred->up_[level]) : &(index->head_[level]), node,
+					 __ATOMIC_RELEASE);
+}
+
+/**
+ * latch_lock : takes the given latch of an index. Latches are held for a few
+ * loads and stores without calls out of the list, so they spin.
+ */
+static inline void latch_lock(int* latch){
+	while(__atomic_exchange_n(latch, 1, __ATOMIC_ACQUIRE))
+		while(__atomic_load_n(latch, __ATOMIC_RELAXED))
+			sched_yield();
+}
+
+#define latch_unlock(latch)	__atomic_store_n((latch), 0, __ATOMIC_RELEASE)
+
+/**
+ * index_lock : locks the links of pred, or of the given level of the head of
+ * the index if pred is NULL, and checks pred is still linked in the index.
+ * Returns 0 with the lock held, or 1 with it released if pred is not linked.
+ * The lock is never held while taking another one.
+ */
+static int index_lock(list_index* index, linked_list_node pred, int level, int** lock){
+	*lock = pred ? &(pred->up_lock_) : &(index->head_locks_[level]);
+	latch_lock(*lock);
+	if(!pred || __atomic_load_n(&(pred->indexed_), __ATOMIC_RELAXED) == index)
+		return SUCCES;
+	latch_unlock(*lock);
+	return 1;
+}
+
+/**
+ * index_mark : sets the index the given node is linked in, under the lock of
+ * its links, so a change checking it in index_lock is not half done.
+ */
+static inline void index_mark(linked_list_node node, list_index* index){
+	latch_lock(&(node->up_lock_));
+	__atomic_store_n(&(node->indexed_), index, __ATOMIC_RELAXED);
+	latch_unlock(&(node->up_lock_));
+}
+
+/**
+ * index_link_slow / index_unlink_slow : link a node into the given index and
+ * out of it, from the bottom level up and from the top level down. Called with
+ * the node locks around the node held, by link_node and unlink_node, so the
+ * same node is never linked and unlinked at once. Nothing links after a
+ * node being unlinked, as it is marked first.
+ */
+static void index_link_slow(list_index* index, linked_list_node node){
+	linked_list_node preds[INDEX_LEVELS], next = NULL;
+	int level, *lock;
+	index_mark(node, index);
+	index_find(index, node->key_, preds);
+	for(level=0;level<node->levels_;level++){
+		while(1){
+			if(!index_lock(index, preds[level], level, &lock)){
+				next = index_next(index, preds[level], level);
+				if(!next || next->key_ > node->key_)
+					break;
+				latch_unlock(lock);	// a node came in between
+			}
+			index_find(index, node->key_, preds);
+		}
+		__atomic_store_n(&(node->up_[level]), next, __ATOMIC_RELAXED);
+		index_set(index, preds[level], level, node);	// the link of node comes first
+		latch_unlock(lock);
+	}
+}
+
+static void index_unlink_slow(list_index* index, linked_list_node node){
+	linked_list_node preds[INDEX_LEVELS];
+	int level, *lock;
+	index_mark(node, NULL);
+	index_find(index, node->key_, preds);
+	for(level=node->levels_-1;level>=0;level--){
+		while(1){
+			if(!index_lock(index, preds[level], level, &lock)){
+				if(index_next(index, preds[level], level) == node)
+					break;
+				latch_unlock(lock);	// a node came in between
+			}
+			index_find(index, node->key_, preds);
+		}
+		index_set(index, preds[level], level, node->up_[level]);	// node keeps its own
+		latch_unlock(lock);
+	}
+}
+
+static void skip_link(void* index, linked_list_node node){
+	if(node->levels_)
+		index_link_slow((list_index*) index, node);
+}
+
+static void skip_unlink(void* index, linked_list_node node){
+	index_unlink_slow((list_index*) index, node);
+}
+
+static linked_list_node skip_find(void* index, int key){
+	return index_find((list_index*) index, key, NULL);
+}
+
+static const index_backend g_skip_backend = { index_create, index_destroy, index_levels,
+											  skip_link, skip_unlink, skip_find };
+
+//*****************************************************************************/
+//----------------------------<B-LINK TREE INDEX>-----------------------------*/
+//*****************************************************************************/
+
+/*
+ * A list created with LIST_BACKEND_BLINK keeps a B-link tree (Lehman and
+ * Yao) over all of its nodes instead, for the same use as the skip list: it
+ * only hands out a node to start a walk from. Every page has a latch, a high
+ * key and a link to its right sibling. A descent couples latches, taking the
+ * child, or the right sibling if a split moved the key there, before letting
+ * the page go, so latches are only ever taken top-down and left to right and
+ * at most two at a time. A split moves the upper half of a full page into a
+ * new page linked right of it and lets both go before the separator goes
+ * into the parent, and until it does descents reach the new page through the
+ * right link. Removes only take the node out of its leaf, pages are never
+ * merged and only freed with the tree. A node that found no memory for a
+ * split is left out of the tree, as is a separator, whose page is then only
+ * reached through right links.
+ */
+
+#define BLINK_KEYS		64		// entries of a page
+#define BLINK_LEVELS	8		// of a tree, enough for 32^7 keys
+#define BLINK_MIN		((long long)INT_MIN - 1)	// low_ of the leftmost pages
+#define BLINK_MAX		((long long)INT_MAX + 1)	// high_ of the rightmost pages
+
+/**
+ * blink_page_t : a page of a B-link tree, covering the keys in [low_, high_).
+ * A leaf (level 0) holds nodes, the pages above hold children, the child of
+ * entry i covering the keys from keys_[i] up to keys_[i+1]. keys_[0] of a
+ * page above the leaves is its low_, or INT_MIN for the leftmost ones.
+ */
+typedef struct blink_page_t{
+	int 				 latch_;
+	int 				 level_;
+	int 				 count_;
+	long long 			 low_;
+	long long 			 high_;
+	struct blink_page_t* right_;
+	int 				 keys_[BLINK_KEYS];
+	void* 				 slots_[BLINK_KEYS];
+} blink_page;
+
+typedef struct blink_tree_t{
+	blink_page* root_;
+	int 		root_latch_;	// taken to grow the tree
+} blink_tree;
+
+static blink_page* blink_page_create(int level, long long low, long long high){
+	blink_page* page = (blink_page*) malloc(sizeof(blink_page));
+	if(!page)
+		return NULL;
+	page->latch_ = 0;
+	page->level_ = level;
+	page->count_ = 0;
+	page->low_ = low;
+	page->high_ = high;
+	page->right_ = NULL;
+	return page;
+}
+
+static void* blink_create(){
+	blink_tree* tree = (blink_tree*) malloc(sizeof(blink_tree));
+	if(!tree)
+		return NULL;
+	tree->root_latch_ = 0;
+	if(!(tree->root_ = blink_page_create(0, BLINK_MIN, BLINK_MAX))){
+		free(tree);
+		return NULL;
+	}
+	return tree;
+}
+
+/**
+ * blink_destroy : frees the given tree, level by level from the leftmost
+ * page of each, which the root and the first child of every leftmost page
+ * are.
+ */
+static void blink_destroy(void* index){
+	blink_tree* tree = (blink_tree*) index;
+	blink_page *level = tree->root_, *page, *next;
+	while(level){
+		page = level;
+		level = page->level_ ? (blink_page*) page->slots_[0] : NULL;
+		for( ; page ; page = next){
+			next = page->right_;
+			free(page);
+		}
+	}
+	free(tree);
+}
+
+/**
+ * blink_descend : latches the page of the given level covering the given
+ * key, starting from the latched page if it is not NULL or else from the
+ * root, and storing the page it went through on each level above in path if
+ * it is not NULL. Returns that page, with only its latch held.
+ */
+static blink_page* blink_descend(blink_tree* tree, blink_page* page, int level, long long key,
+								 blink_page** path){
+	blink_page* next;
+	int i;
+	if(!page){
+		page = __atomic_load_n(&(tree->root_), __ATOMIC_ACQUIRE);
+		latch_lock(&(page->latch_));
+	}
+	while(1){
+		while(key >= page->high_){	// split since the link to it was read
+			next = page->right_;
+			latch_lock(&(next->latch_));
+			latch_unlock(&(page->latch_));
+			page = next;
+		}
+		if(page->level_ == level)
+			return page;
+		if(path)
+			path[page->level_] = page;
+		for(i=page->count_-1;i>0 && page->keys_[i] > key;i--);
+		next = (blink_page*) page->slots_[i];
+		latch_lock(&(next->latch_));
+		latch_unlock(&(page->latch_));
+		page = next;
+	}
+}
+
+/**
+ * blink_put : puts the given entry into the given latched page, which has
+ * room for it.
+ */
+static void blink_put(blink_page* page, int key, void* slot){
+	int i;
+	for(i=page->count_;i>0 && page->keys_[i-1] > key;i--){
+		page->keys_[i] = page->keys_[i-1];
+		page->slots_[i] = page->slots_[i-1];
+	}
+	page->keys_[i] = key;
+	page->slots_[i] = slot;
+	page->count_++;
+}
+
+/**
+ * blink_split : moves the upper half of the given latched page into right,
+ * a new page, and links right after it. Returns the separator, the first key
+ * of right.
+ */
+static int blink_split(blink_page* page, blink_page* right){
+	int half = page->count_ / 2, sep = page->keys_[half];
+	right->count_ = page->count_ - half;
+	memcpy(right->keys_, page->keys_ + half, sizeof(int) * right->count_);
+	memcpy(right->slots_, page->slots_ + half, sizeof(void*) * right->count_);
+	right->low_ = sep;
+	right->high_ = page->high_;
+	right->right_ = page->right_;
+	page->count_ = half;
+	page->high_ = sep;
+	page->right_ = right;	// only read under the latch of page
+	return sep;
+}
+
+/**
+ * blink_grow : puts a new root above the given page and its new right
+ * sibling, if the page is still the root. Returns 1 if it did, 0 if the page
+ * is not the root anymore, and ALLOC_ERROR in case of failure.
+ */
+static int blink_grow(blink_tree* tree, blink_page* page, int sep, blink_page* right){
+	blink_page* root = NULL;
+	int res = 0;
+	latch_lock(&(tree->root_latch_));
+	if(tree->root_ == page){
+		res = ALLOC_ERROR;
+		if(page->level_ + 1 < BLINK_LEVELS &&
+		   (root = blink_page_create(page->level_ + 1, BLINK_MIN, BLINK_MAX))){
+			root->keys_[0] = INT_MIN;
+			root->slots_[0] = page;
+			root->keys_[1] = sep;
+			root->slots_[1] = right;
+			root->count_ = 2;
+			__atomic_store_n(&(tree->root_), root, __ATOMIC_RELEASE);
+			res = 1;
+		}
+	}
+	latch_unlock(&(tree->root_latch_));
+	return res;
+}
+
+/**
+ * blink_parent : latches the page of the given level covering the given key,
+ * going right from path[level] if the descent that stored path went through
+ * the level. Returns NULL if the tree has no such level yet: the page the
+ * descent found at the top was split into the one this is for, and the tree
+ * is not grown yet, or failed to.
+ */
+static blink_page* blink_parent(blink_tree* tree, int level, int key, blink_page** path){
+	blink_page* page = path[level];
+	if(!page){
+		page = __atomic_load_n(&(tree->root_), __ATOMIC_ACQUIRE);
+		if(page->level_ < level)
+			return NULL;
+	}
+	latch_lock(&(page->latch_));
+	return blink_descend(tree, page, level, key, NULL);
+}
+
+/**
+ * blink_insert : puts the given entry into the given latched page, splitting
+ * it if it is full and putting the separator into the page above, and so on
+ * up. path holds the pages the descent to the page went through. Returns
+ * SUCCES if the entry made it into the page, or ALLOC_ERROR if not.
+ */
+static int blink_insert(blink_tree* tree, blink_page* page, int key, void* slot,
+						blink_page** path){
+	blink_page* right;
+	int sep, level;
+	while(page->count_ == BLINK_KEYS){
+		if(!(right = blink_page_create(page->level_, 0, 0))){
+			latch_unlock(&(page->latch_));
+			return page->level_ ? SUCCES : ALLOC_ERROR;
+		}
+		sep = blink_split(page, right);
+		blink_put(key < sep ? page : right, key, slot);
+		latch_unlock(&(page->latch_));	// right is only reached through page yet
+		level = page->level_ + 1;
+		if(blink_grow(tree, page, sep, right) ||
+		   !(page = blink_parent(tree, level, sep, path)))
+			return SUCCES;
+		key = sep;
+		slot = right;
+	}
+	blink_put(page, key, slot);
+	latch_unlock(&(page->latch_));
+	return SUCCES;
+}
+
+/**
+ * blink_link / blink_unlink : put a node into its leaf and take it out. Keys
+ * never change and a node is in the tree once at most, so the leaf covering
+ * its key is the one it is in.
+ */
+static void blink_link(void* index, linked_list_node node){
+	blink_tree* tree = (blink_tree*) index;
+	blink_page* path[BLINK_LEVELS] = { NULL };
+	blink_page* page;
+	__atomic_store_n(&(node->indexed_), index, __ATOMIC_RELAXED);
+	page = blink_descend(tree, NULL, 0, node->key_, path);
+	if(blink_insert(tree, page, node->key_, node, path))
+		__atomic_store_n(&(node->indexed_), NULL, __ATOMIC_RELAXED);
+}
+
+static void blink_unlink(void* index, linked_list_node node){
+	blink_page* page;
+	int i;
+	__atomic_store_n(&(node->indexed_), NULL, __ATOMIC_RELAXED);
+	page = blink_descend((blink_tree*) index, NULL, 0, node->key_, NULL);
+	for(i=0;i<page->count_ && page->slots_[i] != node;i++);
+	if(i < page->count_){
+		page->count_--;
+		memmove(page->keys_ + i, page->keys_ + i + 1, sizeof(int) * (page->count_ - i));
+		memmove(page->slots_ + i, page->slots_ + i + 1, sizeof(void*) * (page->count_ - i));
+	}
+	latch_unlock(&(page->latch_));
+}
+
+/**
+ * blink_find : searches the given tree for the last node whose key is
+ * smaller than the given one, going on with the leaves left of the one
+ * covering it while they have none. Returns NULL if the tree has no such
+ * node.
+ */
+static linked_list_node blink_find(void* index, int key){
+	blink_page* page;
+	linked_list_node node = NULL;
+	long long low;
+	int i;
+	while(!node && key != INT_MIN){
+		page = blink_descend((blink_tree*) index, NULL, 0, (long long)key - 1, NULL);
+		for(i=page->count_-1;i>=0 && page->keys_[i] >= key;i--);
+		if(i >= 0)
+			node = (linked_list_node) page->slots_[i];
+		low = page->low_;
+		latch_unlock(&(page->latch_));
+		if(low == BLINK_MIN)
+			break;
+		key = (int)low;
+	}
+	return node;
+}
+
+static const index_backend g_blink_backend = { blink_create, blink_destroy, NULL,
+											   blink_link, blink_unlink, blink_find };
+
+//*****************************************************************************/
+//-------------------------------<INDEX BACKENDS>-----------------------------*/
+//*****************************************************************************/
+
+static const index_backend* const g_backends[LIST_BACKENDS] = { NULL, &g_skip_backend,
+																&g_blink_backend };
+
+static inline void index_link(linked_list_node node){
+	linked_list list = node->list_;
+	if(list->index_)
+		list->backend_->link_(list->index_, node);
+}
+
+static inline void index_unlink(linked_list_node node){
+	void* index = __atomic_load_n(&(node->indexed_), __ATOMIC_RELAXED);
+	if(index)
+		node->list_->backend_->unlink_(index, node);
+}
+
+/**
+ * index_find_start / index_holds : find the node of the given list closest
+ * before the given key that the index knows of, for a walk to start there,
+ * and check, once the node is locked, that the walk may. It may not if the
+ * node was unlinked or its list was freed before it was locked, or while a
+ * walk of walk_begin runs: a walk that got past the node has unlocked it
+ * since it counted itself in walkers_, so the count is seen here.
+ */
+static inline linked_list_node index_find_start(linked_list list, int key){
+	return list->index_ ? list->backend_->find_(list->index_, key) : NULL;
+}
+
+static inline int index_holds(linked_list list, linked_list_node node){
+	return __atomic_load_n(&(node->indexed_), __ATOMIC_RELAXED) == list->index_ &&
+		   __atomic_load_n(&(get_first_anchor(list)), __ATOMIC_RELAXED) &&
+		   !__atomic_load_n(&(list->walkers_), __ATOMIC_RELAXED);
+}
+
+/**
+ * index_start : locks and returns the node a walk to the given key starts
+ * from through the index of the given list, or NULL if there is none.
+ */
+static inline linked_list_node index_start(linked_list list, int key){
+	linked_list_node node = index_find_start(list, key);
+	if(!node)
+		return NULL;
+	lock_node(node);
+	if(index_holds(list, node))
+		return node;
+	unlock_node(node);
+	return NULL;
+}
+
+//*****************************************************************************/
+//------------------------------<WRITE-AHEAD LOG>-----------------------------*/
+//*****************************************************************************/
+
+static __thread wal_buffer 	tls_wal_own;	// the entries of a single call
+static __thread wal_buffer* tls_wal_buf;	// set while running a batch op
+
+static uint64_t wal_checksum(const char* data, size_t length){
+	uint64_t hash = 0xcbf29ce484222325ULL;	// FNV-1a
+	size_t i;
+	for(i=0;i<length;i++)
+		hash = (hash ^ (unsigned char)data[i]) * 0x100000001b3ULL;
+	return hash;
+}
+
+static int write_all(int fd, const char* data, size_t length){
+	while(length){
+		ssize_t done = write(fd, data, length);
+		if(done < 0 && errno == EINTR)
+			continue;
+		if(done <= 0)
+			return FILE_ERROR;
+		data += done;
+		length -= (size_t)done;
+	}
+	return SUCCES;
+}
+
+/**
+ * sync_parent : makes a rename into the directory of the given path durable.
+ */
+static void sync_parent(const char* path){
+	const char* slash = strrchr(path, '/');
+	char dir[PATH_MAX];
+	int fd;
+	if(!slash)
+		strcpy(dir, ".");
+	else if((size_t)(slash - path) < sizeof(dir)){
+		memcpy(dir, path, slash - path + 1);
+		dir[slash - path + 1] = '\0';
+	}
+	else
+		return;
+	fd = open(dir, O_RDONLY);
+	if(fd >= 0){
+		fsync(fd);
+		close(fd);
+	}
+}
+
+/**
+ * wal_note : logs the state a mutation left the given key in, into the
+ * entries of the calling thread. Called with the key's node locked, so the
+ * sequence numbers of every key are in the order its mutations happened.
+ */
+static void wal_note(list_wal* wal, int key, int present, void* data){
+	wal_buffer* buf = tls_wal_buf ? tls_wal_buf : &tls_wal_own;
+	int payload = present && data && wal->data_size_;
+	size_t need = sizeof(wal_entry) + (payload ? align8(wal->data_size_) : 0);
+	buf->wal_ = wal;
+	if(buf->len_ + need > buf->cap_){
+		size_t cap = buf->cap_ ? buf->cap_ : 256;
+		while(cap < buf->len_ + need)
+			cap *= 2;
+		char* more = (char*) realloc(buf->data_, cap);
+		if(!more){
+			buf->error_ = ALLOC_ERROR;
+			return;
+		}
+		buf->data_ = more;
+		buf->cap_ = cap;
+	}
+	wal_entry* entry = (wal_entry*)(buf->data_ + buf->len_);
+	entry->lsn = __atomic_add_fetch(&(wal->next_lsn_), 1, __ATOMIC_RELAXED);
+	entry->key = key;
+	entry->flags = (present ? WAL_PRESENT : 0) | (payload ? WAL_PAYLOAD : 0);
+	entry->value = (uint64_t)(uintptr_t)data;
+	if(payload){
+		memcpy(entry + 1, data, wal->data_size_);
+		memset((char*)(entry + 1) + wal->data_size_, 0,
+			   align8(wal->data_size_) - wal->data_size_);
+	}
+	buf->len_ += need;
+	buf->count_++;
+}
+
+/**
+ * wal_append : appends a record of the given entries to the log and returns
+ * once it is durable, syncing it together with every record appended by
+ * concurrent callers meanwhile (group commit).
+ */
+static int wal_append(list_wal* wal, const char* entries, size_t length,
+					  uint32_t count){
+	wal_record record = { count, (uint32_t)length, wal_checksum(entries, length) };
+	int res;
+	pthread_mutex_lock(&(wal->lock_));
+	if(wal->error_){
+		pthread_mutex_unlock(&(wal->lock_));
+		return wal->error_;
+	}
+	if(wal->len_ + sizeof(record) + length > wal->cap_){
+		size_t cap = wal->cap_ ? wal->cap_ : 4096;
+		while(cap < wal->len_ + sizeof(record) + length)
+			cap *= 2;
+		char* more = (char*) realloc(wal->buf_, cap);
+		if(!more){
+			pthread_mutex_unlock(&(wal->lock_));
+			return ALLOC_ERROR;
+		}
+		wal->buf_ = more;
+		wal->cap_ = cap;
+	}
+	memcpy(wal->buf_ + wal->len_, &record, sizeof(record));
+	memcpy(wal->buf_ + wal->len_ + sizeof(record), entries, length);
+	wal->len_ += sizeof(record) + length;
+	uint64_t ticket = ++(wal->appended_);
+	while(wal->durable_ < ticket && !wal->error_){
+		if(wal->syncing_){	// a leader is busy, it or the next one syncs us
+			pthread_cond_wait(&(wal->cond_), &(wal->lock_));
+			continue;
+		}
+		char* out = wal->buf_;
+		size_t out_len = wal->len_, out_cap = wal->cap_;
+		uint64_t upto = wal->appended_;
+		wal->buf_ = wal->spare_;
+		wal->cap_ = wal->spare_cap_;
+		wal->len_ = 0;
+		wal->syncing_ = 1;
+		pthread_mutex_unlock(&(wal->lock_));
+		res = write_all(wal->fd_, out, out_len);
+		if(res == SUCCES && fdatasync(wal->fd_))
+			res = FILE_ERROR;
+		pthread_mutex_lock(&(wal->lock_));
+		wal->spare_ = out;
+		wal->spare_cap_ = out_cap;
+		if(res != SUCCES)
+			wal->error_ = res;
+		wal->durable_ = upto;
+		wal->syncing_ = 0;
+		pthread_cond_broadcast(&(wal->cond_));
+	}
+	res = wal->error_;
+	pthread_mutex_unlock(&(wal->lock_));
+	return res;
+}
+
+/**
+ * wal_commit_own : makes the entries logged by the calling thread's last call
+ * durable. A call whose change could not be logged fails even though the
+ * change was applied, as it may not survive a crash.
+ */
+static int wal_commit_own(int res){
+	wal_buffer* buf = &tls_wal_own;
+	int err = buf->error_;
+	if(!err && buf->count_)
+		err = wal_append(buf->wal_, buf->data_, buf->len_, buf->count_);
+	free(buf->data_);
+	memset(buf, 0, sizeof(*buf));
+	return err && res >= 0 ? err : res;
+}
+
+/**
+ * wal_next / wal_next_entry : walk the records of a mapped log and the entries
+ * of a record, returning NULL at the end or at the first damaged one.
+ */
+static const wal_record* wal_next(const char* base, size_t length, size_t* offset){
+	const wal_record* record = (const wal_record*)(base + *offset);
+	if(length - *offset < sizeof(*record) ||
+	   record->length > length - *offset - sizeof(*record) ||
+	   record->checksum != wal_checksum((const char*)(record + 1), record->length))
+		return NULL;
+	*offset += sizeof(*record) + record->length;
+	return record;
+}
+
+static const wal_entry* wal_next_entry(const wal_record* record, size_t* offset,
+									   uint64_t data_size){
+	const wal_entry* entry = (const wal_entry*)((const char*)(record + 1) + *offset);
+	if(record->length - *offset < sizeof(*entry))
+		return NULL;
+	size_t size = sizeof(*entry) + (entry->flags & WAL_PAYLOAD ? align8(data_size) : 0);
+	if(record->length - *offset < size)
+		return NULL;
+	*offset += size;
+	return entry;
+}
+
+/**
+ * wal_map : maps the log at the given path and checks its header. Returns the
+ * mapping, or NULL if the file could not be mapped or is not a log of
+ * data_size payloads.
+ */
+static char* wal_map(int fd, uint64_t data_size, size_t* length){
+	struct stat st;
+	if(fstat(fd, &st) || (size_t)st.st_size < sizeof(wal_header))
+		return NULL;
+	char* base = (char*) mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE,
+							  MAP_PRIVATE, fd, 0);
+	if(base == MAP_FAILED)
+		return NULL;
+	wal_header* header = (wal_header*) base;
+	if(header->magic != WAL_MAGIC || header->version != WAL_VERSION ||
+	   header->data_size != data_size){
+		munmap(base, (size_t)st.st_size);
+		return NULL;
+	}
+	*length = (size_t)st.st_size;
+	return base;
+}
+
+/**
+ * wal_open : opens (or creates) the log at the given path for appending, cuts
+ * off a record torn by a crash and continues numbering after both min_lsn and
+ * the entries already in it.
+ */
+static list_wal* wal_open(const char* path, uint64_t data_size, uint64_t min_lsn){
+	wal_header header = { WAL_MAGIC, WAL_VERSION, data_size };
+	struct stat st;
+	size_t length, end = sizeof(header), offset = 0;
+	const wal_record* record;
+	const wal_entry* entry;
+	list_wal* wal = (list_wal*) calloc(1, sizeof(*wal));
+	if(!wal)
+		return NULL;
+	wal->path_ = strdup(path);
+	wal->fd_ = open(path, O_RDWR | O_CREAT, 0644);
+	if(!wal->path_ || wal->fd_ < 0 || fstat(wal->fd_, &st))
+		goto fail;
+	if(st.st_size == 0){	// a new log
+		if(write_all(wal->fd_, (const char*)&header, sizeof(header)) || fdatasync(wal->fd_))
+			goto fail;
+		sync_parent(path);
+	}
+	else{
+		char* base = wal_map(wal->fd_, data_size, &length);
+		if(!base)
+			goto fail;
+		while((record = wal_next(base, length, &end))){
+			uint32_t i;
+			for(i=0, offset=0;i<record->count;i++){
+				if(!(entry = wal_next_entry(record, &offset, data_size)))
+					break;
+				if(entry->lsn > min_lsn)
+					min_lsn = entry->lsn;
+			}
+		}
+		munmap(base, length);
+		if(end < length && ftruncate(wal->fd_, (off_t)end))
+			goto fail;
+	}
+	if(lseek(wal->fd_, 0, SEEK_END) < 0)
+		goto fail;
+	wal->data_size_ = data_size;
+	wal->next_lsn_ = min_lsn;
+	pthread_mutex_init(&(wal->lock_), NULL);
+	pthread_cond_init(&(wal->cond_), NULL);
+	return wal;
+
+fail:
+	if(wal->fd_ >= 0)
+		close(wal->fd_);
+	free(wal->path_);
+	free(wal);
+	return NULL;
+}
+
+static void wal_close(list_wal* wal){
+	if(!wal)
+		return;
+	close(wal->fd_);
+	pthread_mutex_destroy(&(wal->lock_));
+	pthread_cond_destroy(&(wal->cond_));
+	free(wal->buf_);
+	free(wal->spare_);
+	free(wal->path_);
+	free(wal);
+}
+
+/**
+ * wal_truncate : rewrites the log without the records whose entries are all
+ * covered by a snapshot of the given sequence number. Appenders keep
+ * buffering meanwhile, and are synced into the new log once it is in place.
+ */
+static int wal_truncate(list_wal* wal, uint64_t lsn){
+	wal_header header = { WAL_MAGIC, WAL_VERSION, wal->data_size_ };
+	size_t length, end = sizeof(header), offset, start;
+	const wal_record* record;
+	const wal_entry* entry;
+	char tmp[PATH_MAX];
+	int fd, res = FILE_ERROR;
+	if(snprintf(tmp, sizeof(tmp), "%s.tmp", wal->path_) >= (int)sizeof(tmp))
+		return FILE_ERROR;
+	pthread_mutex_lock(&(wal->lock_));
+	while(wal->syncing_)
+		pthread_cond_wait(&(wal->cond_), &(wal->lock_));
+	wal->syncing_ = 1;	// keeps leaders away from the log
+	pthread_mutex_unlock(&(wal->lock_));
+
+	char* base = wal_map(wal->fd_, wal->data_size_, &length);
+	fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if(base && fd >= 0 && !write_all(fd, (const char*)&header, sizeof(header))){
+		res = SUCCES;
+		for(start=end;res == SUCCES && (record = wal_next(base, length, &end));start=end){
+			uint32_t i, keep = 0;
+			for(i=0, offset=0;i<record->count && !keep;i++)
+				if((entry = wal_next_entry(record, &offset, wal->data_size_)) &&
+				   entry->lsn > lsn)
+					keep = 1;
+			if(keep)
+				res = write_all(fd, base + start, end - start);
+		}
+		if(res == SUCCES && (fdatasync(fd) || rename(tmp, wal->path_)))
+			res = FILE_ERROR;
+	}
+	if(base)
+		munmap(base, length);
+	if(res == SUCCES){
+		sync_parent(wal->path_);
+		close(wal->fd_);
+		wal->fd_ = fd;
+	}
+	else if(fd >= 0){
+		close(fd);
+		unlink(tmp);
+	}
+
+	pthread_mutex_lock(&(wal->lock_));
+	wal->syncing_ = 0;
+	pthread_cond_broadcast(&(wal->cond_));
+	pthread_mutex_unlock(&(wal->lock_));
+	return res;
+}
+
+//*****************************************************************************/
+//-----------------------------<STATIC FUNCTIONS>-----------------------------*/
+//*****************************************************************************/
+
+/**
+ * prefetch_ahead : starts loading the nodes a walk that just locked the
+ * given node will lock next, so the hops of long walks overlap their cache
+ * misses instead of stalling on every one. The node after next is reached
+ * through a racy read of next's successor, which is only used as a prefetch
+ * address and points to memory the epoch keeps alive.
+ */
+static inline void prefetch_ahead(linked_list_node node){
+	int distance = node->list_->prefetch_;
+	linked_list_node next = node->next_, after;
+	if(!distance || !next)
+		return;
+	__builtin_prefetch(next, 1, 3);
+	__builtin_prefetch(&(next->node_lock_), 1, 3);	// the second cache line
+	if(distance > 1 && (after = __atomic_load_n(&(next->next_), __ATOMIC_RELAXED))){
+		__builtin_prefetch(after, 1, 3);
+		__builtin_prefetch(&(after->node_lock_), 1, 3);
+	}
+}
+
+/**
+ * init_first_anchor : initializes the anchor at the beginning of the link list.
+ */
+static inline void init_first_anchor(linked_list list){
+	list->first_anchor_->prev_ 	= NULL;
+	list->first_anchor_->next_ 	= get_last_anchor(list);
+	list->first_anchor_->list_	= list;
+	list->first_anchor_->key_	= INT_MIN;
+	list->first_anchor_->home_	= HOME_HEAP;
+	list->first_anchor_->levels_	= 0;
+	list->first_anchor_->up_lock_	= 0;
+	list->first_anchor_->indexed_	= NULL;
+	list->first_anchor_->up_		= NULL;
+	init_node_locks(list->first_anchor_);
+}
+
+/**
+ * init_last_anchor : initializes the anchor at the end of the link list.
+ */
+static inline void init_last_anchor(linked_list list){
+	list->last_anchor_->prev_ 	= get_first_anchor(list);
+	list->last_anchor_->next_ 	= NULL;
+	list->last_anchor_->list_	= list;
+	list->last_anchor_->key_	= INT_MAX;
+	list->last_anchor_->home_	= HOME_HEAP;
+	list->last_anchor_->levels_	= 0;
+	list->last_anchor_->up_lock_	= 0;
+	list->last_anchor_->indexed_	= NULL;
+	list->last_anchor_->up_		= NULL;
+	init_node_locks(list->last_anchor_);
+}
+
+/**
+ * init_node : initializes the given memory from the given home as a new node
+ * with the given key and data, and returns it.
+ */
+static inline linked_list_node init_node(linked_list list, linked_list_node node, int home,
+										 int key, void* data){
+	node->home_ = home;
+	node->data_ = data;
+	node->version_ = 0;
+	node->memo_seq_ = 0;
+	node->memo_func_ = NULL;
+	node->key_ 	= key;
+	node->list_ = list;
+	index_tower(list, node);
+	init_node_locks(node);
+	return node;
+}
+
+/**
+ * create_node : allocates and initializes a new node with the given key and
+ * data. Returns NULL if the allocation failed.
+ */
+static inline linked_list_node create_node(linked_list list, int key, void* data){
+	int home = list->numa_;
+	linked_list_node node = home >= 0 ? numa_alloc_node(home) : NULL;
+	if(!node){	// or if the NUMA node is out of memory
+		node = (linked_list_node) malloc(sizeof(*node));
+		home = HOME_HEAP;
+	}
+	if(!node)
+		return NULL;
+	return init_node(list, node, home, key, data);
+}
+
+/**
+ * destroy_node : destroys the given node.
+ */
+static inline void destroy_node(linked_list_node node){
+	destroy_node_locks(node);
+	free(node->up_);
+	if(node->home_ >= 0)
+		numa_free_node(node);
+	else if(node->home_ == HOME_CHUNK)
+		chunk_release(chunk_of(node));
+	else
+		free(node);
+}
+
+/**
+ * image_release : drops a reference to the given snapshot mapping.
+ */
+static inline void image_release(list_image* image){
+	if(image && !__atomic_sub_fetch(&(image->refs_), 1, __ATOMIC_ACQ_REL)){
+		munmap(image->base_, image->length_);
+		image_release(image->next_);
+		free(image);
+	}
+}
+
+/**
+ * fc_create / fc_destroy : allocate and destroy the publication array of a
+ * list in flat-combining mode.
+ */
+static combiner* fc_create(){
+	combiner* fc;
+	if(posix_memalign((void**)&fc, 64, sizeof(*fc)))
+		return NULL;
+	memset(fc->slots_, 0, sizeof(fc->slots_));
+	pthread_mutex_init(&(fc->lock_), NULL);
+	return fc;
+}
+
+static void fc_destroy(combiner* fc){
+	if(!fc)
+		return;
+	pthread_mutex_destroy(&(fc->lock_));
+	free(fc);
+}
+
+/**
+ * destroy_list : destroys the given list, once all of its nodes are gone.
+ */
+static void destroy_list(linked_list list){
+	destroy_cont_lock(list);
+	image_release(list->image_);
+	wal_close(list->wal_);
+	fc_destroy(list->fc_);
+	if(list->index_)
+		list->backend_->destroy_(list->index_);
+	if(list->shm_)
+		munmap(list->shm_, list->shm_->size_);
+#ifdef LIST_STATS
+	free(list->stats_);
+#endif
+	free(list);
+}
+
+/**
+ * reclaim_node : destroys a retired node. The last anchor of a freed list is
+ * retired last and takes the list with it, so a call that raced with
+ * list_free or list_split can still find the list marked as freed.
+ */
+static void reclaim_node(linked_list_node node){
+	if(!node->next_)	// only the last anchor has no successor
+		destroy_list(node->list_);
+	destroy_node(node);
+}
+
+/**
+ * retire_list : retires the anchors of a list whose nodes are all gone, and
+ * the list with them.
+ */
+static inline void retire_list(linked_list_node first, linked_list_node last){
+	unlock_and_retire(first);
+	unlock_and_retire(last);
+}
+
+/**
+ * read_data : reads the data of the given locked node and its version. Every
+ * write of the data is made under the node lock by set_data, which bumps the
+ * version, so the two always match and the memo can tell a result on older
+ * data.
+ */
+static inline void* read_data(linked_list_node node, unsigned* version){
+	*version = node->version_;
+	return node->data_;
+}
+
+/**
+ * memo_lookup : fetches the result of compute_func on the current data of the
+ * given node from its memo, if it is there. The node is locked, so its data
+ * does not change, but the memo is written by computes that hold no lock of
+ * the node, so it is read like a seqlock. Returns 1 on a hit.
+ */
+static inline int memo_lookup(linked_list_node node, int (*compute_func) (void *),
+							  int* result){
+	unsigned seq = __atomic_load_n(&(node->memo_seq_), __ATOMIC_ACQUIRE);
+	int hit = !(seq & 1) &&
+			  __atomic_load_n(&(node->memo_func_), __ATOMIC_RELAXED) == compute_func &&
+			  __atomic_load_n(&(node->memo_version_), __ATOMIC_RELAXED) == node->version_;
+	int value = __atomic_load_n(&(node->memo_result_), __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if(!hit || __atomic_load_n(&(node->memo_seq_), __ATOMIC_RELAXED) != seq)
+		return 0;
+	*result = value;
+	return 1;
+}
+
+/**
+ * memo_store : remembers the result of compute_func on the given version of
+ * the data of the given node. Of computes storing at the same time, the one
+ * that makes the sequence odd first stores, the others give up.
+ */
+static inline void memo_store(linked_list_node node, int (*compute_func) (void *),
+							  unsigned version, int result){
+	unsigned seq = __atomic_load_n(&(node->memo_seq_), __ATOMIC_RELAXED);
+	if((seq & 1) || !__atomic_compare_exchange_n(&(node->memo_seq_), &seq, seq + 1, 0,
+												 __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		return;
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&(node->memo_func_), compute_func, __ATOMIC_RELAXED);
+	__atomic_store_n(&(node->memo_version_), version, __ATOMIC_RELAXED);
+	__atomic_store_n(&(node->memo_result_), result, __ATOMIC_RELAXED);
+	__atomic_store_n(&(node->memo_seq_), seq + 2, __ATOMIC_RELEASE);
+}
+
+/**
+ * lock_start : locks the node a walk to the given key starts from: the first
+ * anchor, or the closest node before the key the index of the list knows of.
+ */
+static inline int lock_start(linked_list list, int key, linked_list_node* prev_out){
+	linked_list_node prev = index_start(list, key);
+	if(!prev){
+		lock_container(list);
+		prev = get_first_anchor(list);
+		if(!prev){	// if the lock was acquired after the list was freed
+			unlock_container(list);
+			return LIST_FREE_ERROR;
+		}
+		lock_node(prev);
+		unlock_container(list);
+	}
+	*prev_out = prev;
+	return SUCCES;
+}
+
+/**
+ * lock_position : Walks the given list hand-over-hand, the same way
+ * list_insert does, until reaching the first node whose key is not smaller
+ * than the given key. On success prev and curr are both left locked and the
+ * key belongs between them (or to curr, if is_key_node holds for it).
+ */
+static inline int lock_position(linked_list list, int key,
+								linked_list_node* prev_out,
+								linked_list_node* curr_out){
+	linked_list_node prev, curr;
+	int res = lock_start(list, key, &prev);
+	if(res != SUCCES)
+		return res;
+	curr = prev->next_;
+	lock_node(curr);
+	while(curr != get_last_anchor(list) && curr->key_ < key){
+		advance_node(prev,curr);
+	}
+	*prev_out = prev;
+	*curr_out = curr;
+	return SUCCES;
+}
+
+/**
+ * walk_begin : locks the first anchor of the given list and its first node
+ * for a walk of the whole list, and keeps calls from entering through the
+ * index until walk_end. Calls then all enter through the anchor held by the
+ * walk, so none runs behind it and the walk sees the list as it is once the
+ * calls ahead of it are done.
+ */
+static inline int walk_begin(linked_list list, linked_list_node* prev_out,
+							 linked_list_node* curr_out){
+	__atomic_add_fetch(&(list->walkers_), 1, __ATOMIC_RELAXED);
+	int res = lock_position(list, INT_MIN, prev_out, curr_out);
+	if(res != SUCCES)
+		__atomic_sub_fetch(&(list->walkers_), 1, __ATOMIC_RELAXED);
+	return res;
+}
+
+/**
+ * walk_end : unlocks the last two nodes of a walk of walk_begin.
+ */
+static inline void walk_end(linked_list list, linked_list_node prev, linked_list_node curr){
+	unlock_pair(prev,curr);
+	__atomic_sub_fetch(&(list->walkers_), 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * export_nodes : walks the given list in key order with walk_begin, so the
+ * entries seen are a snapshot of the list. Stores up to *cap entries in the
+ * arrays that are not NULL, or grows both arrays as needed if grow is set.
+ * Returns the number of entries in the list.
+ */
+static int export_nodes(linked_list list, int** keys, void*** data, int* cap, int grow){
+	linked_list_node anchor, curr, next;
+	int count = 0, res = walk_begin(list, &anchor, &curr);
+	if(res != SUCCES)
+		return res;
+	while(curr != get_last_anchor(list)){
+		if(grow && count == *cap){
+			int more = *cap ? *cap * 2 : 1024;
+			int* more_keys = (int*) realloc(*keys, sizeof(int) * more);
+			if(more_keys)
+				*keys = more_keys;
+			void** more_data = (void**) realloc(*data, sizeof(void*) * more);
+			if(more_data)
+				*data = more_data;
+			if(!more_keys || !more_data){
+				res = ALLOC_ERROR;
+				break;
+			}
+			*cap = more;
+		}
+		if(count < *cap){
+			if(*keys)
+				(*keys)[count] = curr->key_;
+			if(*data)
+				(*data)[count] = curr->data_;
+		}
+		count++;
+		next = curr->next_;
+		lock_node(next);
+		prefetch_ahead(next);
+		unlock_node(curr);
+		curr = next;
+	}
+	walk_end(list,anchor,curr);
+	return res == SUCCES ? count : res;
+}
+
+//*****************************************************************************/
+//------------------------------<FLAT COMBINING>------------------------------*/
+//*****************************************************************************/
+
+/*
+ * In flat-combining mode, the single-key calls besides list_compute do not
+ * walk the list themselves. Each one publishes its op and the thread that
+ * gets the combiner lock applies all the published ops in one hand-over-hand
+ * sweep, sorted by key. Threads hammering the head of the list then hand the
+ * combiner lock around once per sweep instead of every node lock per call.
+ */
+
+static __thread unsigned int tls_fc_slot = UINT_MAX;	// first slot to try
+static unsigned int 		 g_fc_threads;
+
+/**
+ * fc_link : links a new node with the given key and data before curr, which
+ * becomes the new node. prev and curr are locked.
+ */
+static int fc_link(linked_list list, linked_list_node prev,
+				   linked_list_node* curr, int key, void* data){
+	linked_list_node node = create_node(list, key, data);
+	if(!node)
+		return ALLOC_ERROR;
+	link_node(prev,node,*curr);
+	wal_log(list,key,1,data);
+	unlock_node(*curr);
+	lock_node(node);	// nobody can reach it but through prev
+	*curr = node;
+	return SUCCES;
+}
+
+/**
+ * fc_apply : applies the given op, as the call it stands for would, to the
+ * key that belongs at curr. prev and curr stay locked, and curr is moved to
+ * the node the key belongs at after the op.
+ */
+static int fc_apply(linked_list list, op_t* op, linked_list_node prev,
+					linked_list_node* curr){
+	linked_list_node next, node = *curr;
+	int found = is_key_node(list,node,op->key);
+	switch(op->op){
+	case INSERT:
+		return found ? INSERT_ERROR : fc_link(list, prev, curr, op->key, op->data);
+	case REMOVE:
+		if(!found)
+			return REMOVE_ERROR;
+		next = node->next_;
+		lock_node(next);
+		unlink_node(node);
+		wal_log(list,op->key,0,NULL);
+		unlock_and_retire(node);	// computes still running on it go on
+		*curr = next;
+		return SUCCES;
+	case CONTAINS:
+		return found ? VALUE_FOUND : VALUE_NOT_FOUND;
+	case UPDATE:
+		if(!found)
+			return NOT_EX_ERROR;
+		set_data(node, op->data);
+		wal_log(list,op->key,1,op->data);
+		return SUCCES;
+	case UPSERT:
+		if(!found)
+			return fc_link(list, prev, curr, op->key, op->data);
+		set_data(node, op->data);
+		wal_log(list,op->key,1,op->data);
+		return VALUE_FOUND;
+	case UPDATE_IF:
+		if(!found)
+			return NOT_EX_ERROR;
+		if(node->data_ != op->expected)
+			return MISMATCH_ERROR;
+		set_data(node, op->data);
+		wal_log(list,op->key,1,op->data);
+		return SUCCES;
+	case GET_OR_INSERT:
+		if(!found)
+			return fc_link(list, prev, curr, op->key, op->data);
+		op->data = node->data_;
+		return VALUE_FOUND;
+	default:
+		return PARAM_ERROR;
+	}
+}
+
+/**
+ * fc_combine : applies every op published on the given list in one sweep.
+ * Called with the combiner lock held. The changes are made durable before
+ * any of their callers is released.
+ */
+static void fc_combine(linked_list list, combiner* fc){
+	op_t* ops[FC_SLOTS];
+	int slots[FC_SLOTS];
+	int logged[FC_SLOTS];
+	int i, j, n = 0, res;
+	linked_list_node prev = NULL, curr = NULL;
+	for(i=0;i<FC_SLOTS;i++){
+		op_t* op = __atomic_load_n(&(fc->slots_[i].op_), __ATOMIC_ACQUIRE);
+		if(!op)
+			continue;
+		for(j=n;j>0 && ops[j-1]->key > op->key;j--){	// insertion sort by key
+			ops[j] = ops[j-1];
+			slots[j] = slots[j-1];
+		}
+		ops[j] = op;
+		slots[j] = i;
+		n++;
+	}
+	if(!n)
+		return;
+	res = lock_position(list, ops[0]->key, &prev, &curr);
+	for(i=0;i<n;i++){
+		if(res != SUCCES){	// the list was freed
+			ops[i]->result = res;
+			logged[i] = 0;
+			continue;
+		}
+		while(curr != get_last_anchor(list) && curr->key_ < ops[i]->key){
+			advance_node(prev,curr);
+		}
+		uint32_t before = tls_wal_own.count_;
+		ops[i]->result = fc_apply(list, ops[i], prev, &curr);
+		logged[i] = tls_wal_own.count_ != before;
+	}
+	if(res == SUCCES){
+		unlock_pair(prev,curr);
+	}
+	if(tls_wal_own.count_ || tls_wal_own.error_){
+		res = wal_commit_own(SUCCES);
+		for(i=0;i<n;i++)
+			if(logged[i] && res < 0)
+				ops[i]->result = res;
+	}
+	for(i=0;i<n;i++)	// releases the callers
+		__atomic_store_n(&(fc->slots_[slots[i]].op_), NULL, __ATOMIC_RELEASE);
+}
+
+/**
+ * fc_execute : publishes the given op on a combining list and returns its
+ * result once some thread, maybe the calling one, has combined it.
+ */
+static int fc_execute(linked_list list, combiner* fc, op_t* op){
+	unsigned int i, slot;
+	op_t* expected;
+	if(tls_fc_slot == UINT_MAX)
+		tls_fc_slot = __atomic_fetch_add(&g_fc_threads, 1, __ATOMIC_RELAXED);
+	for(i=0;;i++){	// a free slot, starting from the thread's own
+		slot = (tls_fc_slot + i) % FC_SLOTS;
+		expected = NULL;
+		if(__atomic_compare_exchange_n(&(fc->slots_[slot].op_), &expected, op, 0,
+									   __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+			break;
+		if(i % FC_SLOTS == FC_SLOTS - 1)
+			sched_yield();
+	}
+	while(__atomic_load_n(&(fc->slots_[slot].op_), __ATOMIC_ACQUIRE) == op){
+		if(!pthread_mutex_trylock(&(fc->lock_))){
+			fc_combine(list, fc);
+			pthread_mutex_unlock(&(fc->lock_));
+		}
+		else
+			sched_yield();
+	}
+	return op->result;
+}
+
+/**
+ * fc_call : runs a single-key call through the combiner of the given list,
+ * unless the list is not in flat-combining mode or the call is part of a
+ * batch (whose changes are logged with the rest of the batch). Returns 1 if
+ * the call was combined.
+ */
+static inline int fc_call(linked_list list, int kind, int key, void* data,
+						  void* expected, op_t* op){
+	combiner* fc = list->fc_;
+	if(!fc || tls_wal_buf)
+		return 0;
+	op->op = kind;
+	op->key = key;
+	op->data = data;
+	op->expected = expected;
+	fc_execute(list, fc, op);
+	return 1;
+}
+
+//*****************************************************************************/
+//--------------------------------<DEADLINES>---------------------------------*/
+//*****************************************************************************/
+
+/*
+ * The _timed and list_try_ calls take every lock with a deadline, so a call
+ * stuck behind a slow compute gives up instead of waiting for it. On timeout
+ * every lock taken so far is released and nothing has changed. Deadlines are
+ * absolute CLOCK_REALTIME times, as for pthread_mutex_timedlock, and a NULL
+ * deadline means the call does not wait at all. That covers the node, data
+ * and main locks and the lock of a NUMA pool. The latches of an index are
+ * only held for a few loads and stores, never while waiting for anything,
+ * and are taken as they are. A logged list makes every change wait for its
+ * log to be synced, which no deadline can cut short, so its calls fail with
+ * DISABLED_ERROR, as do those of shared lists.
+ */
+
+/**
+ * deadline_lock : locks the given mutex unless the deadline passes first.
+ * Returns 0 once locked or TIMEOUT_ERROR.
+ */
+static inline int deadline_lock(pthread_mutex_t* mutex, const struct timespec* deadline){
+	if(!pthread_mutex_trylock(mutex))
+		return SUCCES;
+	if(!deadline || pthread_mutex_timedlock(mutex, deadline))
+		return TIMEOUT_ERROR;
+	return SUCCES;
+}
+
+/**
+ * deadline_start : lock_start with a deadline.
+ */
+static int deadline_start(linked_list list, int key, const struct timespec* deadline,
+						  linked_list_node* prev_out){
+	linked_list_node prev = index_find_start(list, key);
+	if(prev){
+		if(deadline_lock(&(prev->node_lock_), deadline))
+			return TIMEOUT_ERROR;
+		if(index_holds(list, prev)){
+			*prev_out = prev;
+			return SUCCES;
+		}
+		unlock_node(prev);
+	}
+	if(deadline_lock(&(list->main_lock_), deadline))
+		return TIMEOUT_ERROR;
+	prev = get_first_anchor(list);
+	if(!prev){	// if the lock was acquired after the list was freed
+		unlock_container(list);
+		return LIST_FREE_ERROR;
+	}
+	if(deadline_lock(&(prev->node_lock_), deadline)){
+		unlock_container(list);
+		return TIMEOUT_ERROR;
+	}
+	unlock_container(list);
+	*prev_out = prev;
+	return SUCCES;
+}
+
+/**
+ * deadline_position : lock_position with a deadline. On failure no node is
+ * left locked.
+ */
+static int deadline_position(linked_list list, int key, const struct timespec* deadline,
+							 linked_list_node* prev_out, linked_list_node* curr_out){
+	linked_list_node prev, curr, next;
+	int res = deadline_start(list, key, deadline, &prev);
+	if(res != SUCCES)
+		return res;
+	curr = prev->next_;
+	if(deadline_lock(&(curr->node_lock_), deadline)){
+		unlock_node(prev);
+		return TIMEOUT_ERROR;
+	}
+	while(curr != get_last_anchor(list) && curr->key_ < key){
+		stats_hop();
+		next = curr->next_;
+		if(deadline_lock(&(next->node_lock_), deadline)){
+			unlock_pair(prev,curr);
+			return TIMEOUT_ERROR;
+		}
+		prefetch_ahead(next);
+		unlock_node(prev);
+		prev = curr;
+		curr = next;
+	}
+	*prev_out = prev;
+	*curr_out = curr;
+	return SUCCES;
+}
+
+/**
+ * deadline_create : create_node with a deadline on the lock of the NUMA pool
+ * of the given list. Returns 0 with the node in node_out, TIMEOUT_ERROR or
+ * ALLOC_ERROR.
+ */
+static int deadline_create(linked_list list, int key, void* data,
+						   const struct timespec* deadline, linked_list_node* node_out){
+	int home = list->numa_;
+	linked_list_node node = NULL;
+	if(home >= 0){
+		if(deadline_lock(&(g_numa_pools[home].lock_), deadline))
+			return TIMEOUT_ERROR;
+		node = numa_take_node(home);
+		pthread_mutex_unlock(&(g_numa_pools[home].lock_));
+	}
+	if(!node){	// or if the NUMA node is out of memory
+		node = (linked_list_node) malloc(sizeof(*node));
+		home = HOME_HEAP;
+	}
+	if(!node)
+		return ALLOC_ERROR;
+	*node_out = init_node(list, node, home, key, data);
+	return SUCCES;
+}
+
+/**
+ * deadline_apply : runs the given single-key op as the call it stands for
+ * would, but with a deadline on every lock. The result of a compute goes to
+ * result.
+ */
+static int deadline_apply(linked_list list, op_t* op, const struct timespec* deadline,
+						  int* result){
+	linked_list_node prev, curr, node;
+	void* data;
+	unsigned version;
+	int exclusive, res = deadline_position(list, op->key, deadline, &prev, &curr);
+	if(res != SUCCES)
+		return res;
+	if(op->op == INSERT && !is_key_node(list,curr,op->key)){
+		res = deadline_create(list, op->key, op->data, deadline, &node);
+		if(res == SUCCES){
+			link_node(prev,node,curr);
+		}
+		unlock_pair(prev,curr);
+		return res;
+	}
+	if(op->op == REMOVE && is_key_node(list,curr,op->key)){
+		unlink_node(curr);
+		unlock_node(prev);
+		unlock_and_retire(curr);	// computes still running on it go on
+		return SUCCES;
+	}
+	if(op->op == COMPUTE && is_key_node(list,curr,op->key)){
+		if(list->memoize_ && memo_lookup(curr, op->compute_func, result)){
+			unlock_pair(prev,curr);
+			return SUCCES;
+		}
+		exclusive = list->exclusive_;
+		if(exclusive && deadline_lock(&(curr->data_lock_), deadline)){
+			unlock_pair(prev,curr);
+			return TIMEOUT_ERROR;
+		}
+		data = read_data(curr, &version);
+		unlock_pair(prev,curr);
+		*result = op->compute_func(data);
+		if(list->memoize_)
+			memo_store(curr, op->compute_func, version, *result);
+		if(exclusive)
+			unlock_data(curr);
+		return SUCCES;
+	}
+	if(op->op == REMOVE)
+		res = REMOVE_ERROR;
+	else if(op->op == COMPUTE)
+		res = NOT_EX_ERROR;
+	else
+		res = fc_apply(list, op, prev, &curr);	// a find or an update, which lock nothing
+	unlock_pair(prev,curr);
+	return res;
+}
+
+/**
+ * deadline_call : fills in an op for deadline_apply.
+ */
+static inline int deadline_call(linked_list list, int kind, int key, void* data,
+								int (*compute_func) (void *), int* result,
+								const struct timespec* deadline){
+	op_t op;
+	if(list->shm_ || list->wal_)
+		return DISABLED_ERROR;
+	op.op = kind;
+	op.key = key;
+	op.data = data;
+	op.compute_func = compute_func;
+	return deadline_apply(list, &op, deadline, result);
+}
+
+//*****************************************************************************/
+//-------------------------------<SHARED LISTS>-------------------------------*/
+//*****************************************************************************/
+
+/*
+ * A shared list lives in a named POSIX shared memory region that any number
+ * of processes map, each at an address of its own. The region holds the
+ * anchors and a fixed number of nodes, linked by offsets, with the locks
+ * made process-shared and robust. The handle of each process is local and
+ * routes the calls it supports into the region.
+ *
+ * Epochs only cover the threads of one process, so instead of retiring a
+ * node a remove waits for the compute running on it, which takes its data
+ * lock before releasing its node locks, and frees it right away, as the
+ * template does. A compute function must therefore not remove its own key.
+ *
+ * With a data_size the data of a node is a data_size byte payload copied
+ * into the region, and the calls hand out pointers into it: compute_func
+ * gets one, as does list_get_or_insert. Otherwise the data pointers are kept
+ * as they are, which only means the same in every process for values stored
+ * as pointers.
+ */
+
+#define shm_at(region,off)		((shm_node*)((char*)(region) + (off)))
+#define shm_off(region,node)	((uint64_t)((char*)(node) - (char*)(region)))
+#define shm_payload(node)		((char*)(node) + sizeof(shm_node))
+
+#define SHM_WAIT_SEC	5	// for the creator of a region to finish it
+
+/**
+ * shm_lock : locks a mutex of a shared list. If the process that held it
+ * died, the change it was making may be half done, but the list goes on.
+ */
+static inline void shm_lock(pthread_mutex_t* mutex){
+	if(pthread_mutex_lock(mutex) == EOWNERDEAD)
+		pthread_mutex_consistent(mutex);
+}
+
+#define shm_unlock(mutex)	(pthread_mutex_unlock(mutex))
+
+static void shm_init_mutex(pthread_mutex_t* mutex){
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+	pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+	pthread_mutex_init(mutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+}
+
+static void shm_init_node(shm_node* node){
+	shm_init_mutex(&(node->node_lock_));
+	shm_init_mutex(&(node->data_lock_));
+}
+
+/**
+ * shm_alloc_node : takes a node of the given region, or returns NULL if all
+ * of them are in use.
+ */
+static shm_node* shm_alloc_node(shm_region* region){
+	uint64_t off;
+	shm_lock(&(region->lock_));
+	off = region->free_;
+	if(off)
+		region->free_ = shm_at(region, off)->next_;
+	else if(region->brk_ + region->node_size_ <= region->size_){
+		off = region->brk_;
+		region->brk_ += region->node_size_;
+	}
+	shm_unlock(&(region->lock_));
+	if(!off)
+		return NULL;
+	shm_init_node(shm_at(region, off));
+	return shm_at(region, off);
+}
+
+static void shm_free_node(shm_region* region, shm_node* node){
+	pthread_mutex_destroy(&(node->node_lock_));
+	pthread_mutex_destroy(&(node->data_lock_));
+	shm_lock(&(region->lock_));
+	node->next_ = region->free_;
+	region->free_ = shm_off(region, node);
+	shm_unlock(&(region->lock_));
+}
+
+/**
+ * shm_get_data / shm_set_data / shm_has_data : read, write and compare the
+ * data of a node as the calls see it. A payload is written under the data
+ * lock, so computes never see it half written.
+ */
+static inline void* shm_get_data(shm_region* region, shm_node* node){
+	return region->data_size_ ? (void*)shm_payload(node) : *(void**)shm_payload(node);
+}
+
+static inline void shm_set_data(shm_region* region, shm_node* node, void* data){
+	if(!region->data_size_)
+		*(void**)shm_payload(node) = data;
+	else if(data)
+		memcpy(shm_payload(node), data, region->data_size_);
+	else
+		memset(shm_payload(node), 0, region->data_size_);
+}
+
+static inline int shm_has_data(shm_region* region, shm_node* node, void* data){
+	if(!region->data_size_)
+		return *(void**)shm_payload(node) == data;
+	return data && !memcmp(shm_payload(node), data, region->data_size_);
+}
+
+/**
+ * shm_create : creates the region of a shared list in the given file
+ * descriptor, which must be new. Returns NULL on failure.
+ */
+static shm_region* shm_create(int fd, size_t data_size, size_t capacity){
+	uint64_t node_size = align8(sizeof(shm_node) + (data_size ? data_size : sizeof(void*)));
+	uint64_t header = align8(sizeof(shm_region));
+	uint64_t size = header + (capacity + 2) * node_size;
+	shm_region* region;
+	shm_node *first, *last;
+	if(ftruncate(fd, size))
+		return NULL;
+	region = (shm_region*) mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(region == MAP_FAILED)
+		return NULL;
+	region->magic_ 		= SHM_MAGIC;
+	region->version_ 	= SHM_VERSION;
+	region->size_ 		= size;
+	region->data_size_ 	= data_size;
+	region->node_size_ 	= node_size;
+	region->first_ 		= header;
+	region->last_ 		= header + node_size;
+	region->brk_ 		= header + 2 * node_size;
+	region->free_ 		= 0;
+	shm_init_mutex(&(region->lock_));
+	first = shm_at(region, region->first_);
+	last = shm_at(region, region->last_);
+	shm_init_node(first);
+	shm_init_node(last);
+	first->prev_ = 0;
+	first->next_ = region->last_;
+	first->key_ = INT_MIN;
+	last->prev_ = region->first_;
+	last->next_ = 0;
+	last->key_ = INT_MAX;
+	__atomic_store_n(&(region->ready_), 1, __ATOMIC_RELEASE);
+	return region;
+}
+
+/**
+ * shm_attach : maps the region of an existing shared list, waiting for its
+ * creator to finish it if needed. Returns NULL on failure or if the region
+ * was made for another data_size.
+ */
+static shm_region* shm_attach(int fd, size_t data_size){
+	time_t give_up = time(NULL) + SHM_WAIT_SEC;
+	struct stat st;
+	shm_region* region;
+	while(!fstat(fd, &st) && st.st_size < (off_t)sizeof(shm_region)){
+		if(time(NULL) > give_up)
+			return NULL;
+		sched_yield();
+	}
+	if(st.st_size < (off_t)sizeof(shm_region))
+		return NULL;
+	region = (shm_region*) mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(region == MAP_FAILED)
+		return NULL;
+	while(!__atomic_load_n(&(region->ready_), __ATOMIC_ACQUIRE) && time(NULL) <= give_up)
+		sched_yield();
+	if(!region->ready_ || region->magic_ != SHM_MAGIC || region->version_ != SHM_VERSION
+	   || region->size_ != (uint64_t)st.st_size || region->data_size_ != data_size){
+		munmap(region, st.st_size);
+		return NULL;
+	}
+	return region;
+}
+
+/**
+ * shm_position : lock_position in the region of a shared list.
+ */
+static void shm_position(shm_region* region, int key, shm_node** prev_out,
+						 shm_node** curr_out){
+	shm_node *prev, *curr, *next, *last = shm_at(region, region->last_);
+	prev = shm_at(region, region->first_);
+	shm_lock(&(prev->node_lock_));
+	curr = shm_at(region, prev->next_);
+	shm_lock(&(curr->node_lock_));
+	while(curr != last && curr->key_ < key){
+		stats_hop();
+		next = shm_at(region, curr->next_);
+		shm_lock(&(next->node_lock_));
+		shm_unlock(&(prev->node_lock_));
+		prev = curr;
+		curr = next;
+	}
+	*prev_out = prev;
+	*curr_out = curr;
+}
+
+/**
+ * shm_link : links a new node with the given key and data between prev and
+ * curr, both locked.
+ */
+static int shm_link(shm_region* region, shm_node* prev, shm_node* curr, int key,
+					void* data){
+	shm_node* node = shm_alloc_node(region);
+	if(!node)
+		return ALLOC_ERROR;
+	node->key_ = key;
+	shm_set_data(region, node, data);
+	node->prev_ = shm_off(region, prev);
+	node->next_ = shm_off(region, curr);
+	prev->next_ = shm_off(region, node);
+	curr->prev_ = shm_off(region, node);
+	return SUCCES;
+}
+
+/**
+ * shm_open_list : checks that the given handle was not freed. The calls on a
+ * shared list run inside an epoch, so the region stays mapped until they are
+ * done even if the handle is freed meanwhile.
+ */
+static inline int shm_open_list(linked_list list){
+	int res;
+	lock_container(list);
+	res = get_first_anchor(list) ? SUCCES : LIST_FREE_ERROR;
+	unlock_container(list);
+	return res;
+}
+
+/**
+ * shm_apply : runs the given op on a shared list, as the call it stands for
+ * would. The result of a compute goes to result.
+ */
+static int shm_apply(linked_list list, op_t* op, int* result){
+	shm_region* region = list->shm_;
+	shm_node *prev, *curr;
+	int res = shm_open_list(list), found;
+	if(res != SUCCES)
+		return res;
+	shm_position(region, op->key, &prev, &curr);
+	found = curr != shm_at(region, region->last_) && curr->key_ == op->key;
+	switch(op->op){
+	case INSERT:
+		res = found ? INSERT_ERROR : shm_link(region, prev, curr, op->key, op->data);
+		break;
+	case REMOVE:
+		if(!found){
+			res = REMOVE_ERROR;
+			break;
+		}
+		prev->next_ = curr->next_;
+		shm_at(region, curr->next_)->prev_ = curr->prev_;
+		shm_unlock(&(prev->node_lock_));
+		shm_lock(&(curr->data_lock_));	// waits for a compute still running on it
+		shm_unlock(&(curr->data_lock_));
+		shm_unlock(&(curr->node_lock_));
+		shm_free_node(region, curr);
+		return SUCCES;
+	case CONTAINS:
+		res = found ? VALUE_FOUND : VALUE_NOT_FOUND;
+		break;
+	case UPDATE:
+	case UPSERT:
+		if(!found){
+			res = op->op == UPDATE ? NOT_EX_ERROR :
+				  shm_link(region, prev, curr, op->key, op->data);
+			break;
+		}
+		shm_lock(&(curr->data_lock_));
+		shm_set_data(region, curr, op->data);
+		shm_unlock(&(curr->data_lock_));
+		res = op->op == UPDATE ? SUCCES : VALUE_FOUND;
+		break;
+	case UPDATE_IF:
+		if(!found){
+			res = NOT_EX_ERROR;
+			break;
+		}
+		shm_lock(&(curr->data_lock_));
+		res = shm_has_data(region, curr, op->expected) ? SUCCES : MISMATCH_ERROR;
+		if(res == SUCCES)
+			shm_set_data(region, curr, op->data);
+		shm_unlock(&(curr->data_lock_));
+		break;
+	case GET_OR_INSERT:
+		res = found ? VALUE_FOUND : shm_link(region, prev, curr, op->key, op->data);
+		if(res >= 0)
+			op->data = shm_get_data(region, shm_at(region, prev->next_));
+		break;
+	case COMPUTE:
+		if(!found){
+			res = NOT_EX_ERROR;
+			break;
+		}
+		shm_lock(&(curr->data_lock_));	// before a remove can get to the node
+		shm_unlock(&(curr->node_lock_));
+		shm_unlock(&(prev->node_lock_));
+		*result = op->compute_func(shm_get_data(region, curr));
+		shm_unlock(&(curr->data_lock_));
+		return SUCCES;
+	default:
+		res = PARAM_ERROR;
+	}
+	shm_unlock(&(curr->node_lock_));
+	shm_unlock(&(prev->node_lock_));
+	return res;
+}
+
+/**
+ * shm_call : runs a single-key call on a shared list, like fc_call. Returns
+ * 1 if the list is shared.
+ */
+static inline int shm_call(linked_list list, int kind, int key, void* data,
+						   void* expected, op_t* op){
+	if(!list->shm_)
+		return 0;
+	op->op = kind;
+	op->key = key;
+	op->data = data;
+	op->expected = expected;
+	op->result = shm_apply(list, op, NULL);
+	return 1;
+}
+
+/**
+ * shm_size : list_size on a shared list.
+ */
+static int shm_size(linked_list list){
+	shm_region* region = list->shm_;
+	shm_node *prev, *curr, *last = shm_at(region, region->last_);
+	int size = 0, res = shm_open_list(list);
+	if(res != SUCCES)
+		return res;
+	prev = shm_at(region, region->first_);
+	shm_lock(&(prev->node_lock_));
+	curr = shm_at(region, prev->next_);
+	shm_lock(&(curr->node_lock_));
+	while(curr != last){
+		shm_node* next = shm_at(region, curr->next_);
+		size++;
+		shm_lock(&(next->node_lock_));
+		shm_unlock(&(prev->node_lock_));
+		prev = curr;
+		curr = next;
+	}
+	shm_unlock(&(curr->node_lock_));
+	shm_unlock(&(prev->node_lock_));
+	return size;
+}
+
+//*****************************************************************************/
+//--------------------------------<FUNCTIONS>---------------------------------*/
+//*****************************************************************************/
+
+/**
+ * list_alloc : Creates a new linked list.
+ *
+ * input		: N/A
+ *
+ * output		: N/A
+ *
+ * return value	: A new linked list.
+ */
+linked_list_t* list_alloc(){
+	linked_list list = (linked_list) malloc(sizeof(*list));
+	if(!list)
+		return NULL;
+	list->first_anchor_	= (linked_list_node) malloc(sizeof(*(list->first_anchor_)));
+	list->last_anchor_	= (linked_list_node) malloc(sizeof(*(list->last_anchor_)));
+	if(!list->last_anchor_ || !list->first_anchor_){
+		free(list);
+		return NULL;
+	}
+#ifdef LIST_STATS
+	if(posix_memalign((void**)&(list->stats_), CACHE_LINE, STATS_SLOTS * sizeof(stats_slot)))
+		list->stats_ = NULL;
+	else
+		memset(list->stats_, 0, STATS_SLOTS * sizeof(stats_slot));
+	if(!list->stats_){
+		free(list->first_anchor_);
+		free(list->last_anchor_);
+		free(list);
+		return NULL;
+	}
+#endif
+	init_first_anchor(list);
+	init_last_anchor(list);
+	init_cont_lock(list);
+	list->image_ = NULL;
+	list->wal_ = NULL;
+	list->fc_ = NULL;
+	list->eliminate_ = 0;
+	list->numa_ = -1;
+	list->prefetch_ = 1;
+	list->memoize_ = 0;
+	list->exclusive_ = 0;
+	list->shm_ = NULL;
+	list->index_ = NULL;
+	list->backend_ = NULL;
+	list->walkers_ = 0;
+	list->batch_ns_ = BATCH_FIRST_NS;
+	return list;
+}
+
+/**
+ * list_alloc_backend : Creates a new linked list on the given backend. Every
+ * backend keeps the semantics of every call, they only differ in speed:
+ * LIST_BACKEND_LIST is the plain list, LIST_BACKEND_SKIPLIST keeps a skip
+ * list index over it and LIST_BACKEND_BLINK a B-link tree, so calls on a key
+ * walk O(log n) nodes instead of O(n), at the cost of some memory and of
+ * keeping the index up to date on inserts and removes. The skip list indexes
+ * a quarter of the nodes and reads without locks, the tree indexes all of
+ * them and starts walks right before their key, but latches its pages on
+ * the way down. Lists split from a list keep its backend.
+ *
+ * input		: backend - LIST_BACKEND_*.
+ *
+ * output		: N/A
+ *
+ * return value	: A new linked list or NULL in case of failure.
+ */
+linked_list_t* list_alloc_backend(int backend){
+	if (backend < 0 || backend >= LIST_BACKENDS)	return NULL;
+	linked_list list = list_alloc();
+	if(list && (list->backend_ = g_backends[backend]) && !(list->index_ = list->backend_->create_())){
+		list_free(list);
+		return NULL;
+	}
+	return list;
+}
+
+/**
+ * list_free : Free the given list.
+ *
+ * input		: list - the given list to free.
+ *
+ * output		: N/A
+ *
+ * return value	: N/A
+ */
+void list_free(linked_list_t* list){
+	if (!list) return;
+	linked_list_node anchor, prev, curr;
+	epoch_enter();
+	lock_container(list);
+	anchor = get_first_anchor(list);
+	if(!anchor){	// if the lock was acquired after the list was freed
+		unlock_container(list);
+		epoch_exit();
+		return;
+	}
+	// unlink anchor from list, index_start reads it without the lock
+	__atomic_store_n(&(get_first_anchor(list)), NULL, __ATOMIC_RELAXED);
+	lock_node(anchor);
+	unlock_container(list);
+	prev = anchor;
+	curr = anchor->next_;
+	lock_node(curr);	// so if the node currently in use the process will wait.
+	while(curr != get_last_anchor(list)){
+		prev = curr;
+		curr = curr->next_;
+		lock_node(curr);
+		prefetch_ahead(curr);
+		unlock_and_retire(prev);	// computes still running on it go on
+	}
+	retire_list(anchor, curr);
+	epoch_exit();
+	epoch_advance();	// reclaims right away if no other call is running
+	epoch_advance();
+}
+
+/**
+ * list_open_shared : Opens the shared list of the given name, creating it if
+ * it does not exist yet. Every process that opens the same name works on the
+ * same list, each through a handle of its own to be released with list_free.
+ * A shared list supports the single-key calls, list_size and list_batch; the
+ * other calls fail on it with DISABLED_ERROR. Its nodes live in the shared
+ * region, so the data passed to it is stored as bytes, not pointers, and
+ * list_get_or_insert and the compute functions get pointers into the region.
+ *
+ * input		: name 		- the POSIX shared memory name ("/something").
+ * 				: data_size - the size of the data of each node, or 0 to
+ * 							  store the data pointers themselves.
+ * 				: capacity 	- the maximal number of nodes, used only when
+ * 							  the list is created.
+ *
+ * output		: N/A
+ *
+ * return value	: A handle of the shared list or NULL in case of failure or
+ * 				  if the existing list has another data size.
+ */
+linked_list_t* list_open_shared(const char* name, size_t data_size, size_t capacity){
+	if (!name)	return NULL;
+	linked_list list;
+	shm_region* region = NULL;
+	int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if(fd >= 0){
+		region = capacity ? shm_create(fd, data_size, capacity) : NULL;
+		if(!region)
+			shm_unlink(name);
+	}
+	else if(errno == EEXIST && (fd = shm_open(name, O_RDWR, 0600)) >= 0)
+		region = shm_attach(fd, data_size);
+	if(fd >= 0)
+		close(fd);
+	if(!region)
+		return NULL;
+	list = list_alloc();
+	if(!list){
+		munmap(region, region->size_);
+		return NULL;
+	}
+	list->shm_ = region;
+	return list;
+}
+
+/**
+ * list_unlink_shared : Removes the name of a shared list. Handles already
+ * open keep working, and the list is gone once the last of them is freed.
+ *
+ * input		: name - the name the list was opened with.
+ *
+ * output		: N/A
+ *
+ * return value	: 0 in case of success or anything else in case of failure.
+ */
+int list_unlink_shared(const char* name){
+	if (!name)	return PARAM_ERROR;
+	return shm_unlink(name) ? FILE_ERROR : SUCCES;
+}
+
+/**
+ * list_split : Splits the given array into n new lists alternately.
+ * the new lists will be stored in the given array and the original array will
+ * be free. If there are fewer than n elements in the original list, an empty
+ * lists will be generated up to a total of n lists.
+ *
+ * input		: list 	- the given list.
+ * 				: n 	- the number of lists to split to.
+ *
+ * output		: arr 	- an array to add the new lists to.
+ *
+ * return value	: 0 in case of success or anything else in case of failure.
+ */
+int list_split(linked_list_t* list, int n, linked_list_t** arr){
+	if (!list || !arr || n <=0)	return PARAM_ERROR;
+	if (list->shm_)	return DISABLED_ERROR;
+	int i;
+	linked_list_node anchor, curr;
+	epoch_enter();
+	lock_container(list);
+	anchor = get_first_anchor(list);
+	if(!anchor){	// if the lock was acquired after the list was freed
+		unlock_container(list);
+		epoch_exit();
 		return LIST_FREE_ERROR;
 	}
-	lock_node(prev);
-	unlock_container(list);
-	curr = get_first_node(list);
-	lock_node(curr);
-	while(curr){
-		if(key == curr->key_){
-			unlock_node(curr);
-			unlock_node(prev);
-			destroy_node_locks(new_node);
-			free (new_node);
-			return INSERT_ERROR;	// key already in use
-		}
-		if(key < curr->key_){
-			link_node(prev,new_node,curr);
-			unlock_node(prev);
-			unlock_node(curr);
-			return SUCCES;
-		}
-		curr = curr->next_;
-		lock_node(curr);
-		unlock_node(prev);
-		prev = curr->prev_;
+	// unlink anchor from list, index_start reads it without the lock
+	__atomic_store_n(&(get_first_anchor(list)), NULL, __ATOMIC_RELAXED);
+	lock_node(anchor);
+	unlock_container(list);
+	for(i=0;i<n;i++){
+		arr[i] = list_alloc();
+		if (!(arr[i])){
+			for(;i>=0;i--)
+				list_free(arr[i]);
+			epoch_exit();
+			return ALLOC_ERROR;
+		}
+		if(list->fc_)
+			arr[i]->fc_ = fc_create();
+		arr[i]->eliminate_ = list->eliminate_;
+		arr[i]->numa_ = list->numa_;
+		arr[i]->prefetch_ = list->prefetch_;
+		arr[i]->memoize_ = list->memoize_;
+		arr[i]->exclusive_ = list->exclusive_;
+		arr[i]->backend_ = list->backend_;
+		if(list->index_)
+			arr[i]->index_ = list->backend_->create_();
+		arr[i]->batch_ns_ = list->batch_ns_;
+		if(list->image_){	// moved nodes may point into the mapping
+			__atomic_add_fetch(&(list->image_->refs_), 1, __ATOMIC_RELAXED);
+			arr[i]->image_ = list->image_;
+		}
+	}
+	i=0;
+	curr = anchor->next_;
+	lock_node(curr);	// so if the node currently in use the process will wait.
+	while(curr != get_last_anchor(list)){
+		lock_node(curr->next_);
+		prefetch_ahead(curr->next_);
+		unlink_node(curr);
+		curr->list_=arr[i];
+		link_node(get_last_node(arr[i]),curr,get_last_anchor(arr[i]));
+		i++;
+		if(i == n)
+			i=0;
+		unlock_node(curr);
+		curr = anchor->next_;
+	}
+	retire_list(anchor, curr);
+	epoch_exit();
+	return SUCCES;
+}
+
+/**
+ * list_insert : Inserts new node with the given data and key into the given
+ * list. If a node with the given key already exist the function will fail.
+ *
+ * input		: list 	- the given list.
+ * 				: key 	- the given key for the new node.
+ * 				: data 	- the given data for the new node.
+ *
+ * output		: N/A
+ *
+ * return value	: 0 in case of success or anything else in case of failure.
+ */
+int list_insert(linked_list_t* list, int key, void* data){
+	if (!list)	return PARAM_ERROR;
+	op_begin(LIST_OP_INSERT, key);
+	op_t fc_op;
+	if(fc_call(list, INSERT, key, data, NULL, &fc_op) ||
+	   shm_call(list, INSERT, key, data, NULL, &fc_op)){
+		op_return(list, fc_op.result);
+	}
+	linked_list_node prev, curr, new_node;
+	new_node = create_node(list, key, data);
+	if(!new_node)
+		op_return(list, ALLOC_ERROR);
+	int res = lock_start(list, key, &prev);
+	if(res != SUCCES){
+		destroy_node(new_node);
+		op_return(list, res);
+	}
+	curr = prev->next_;
+	lock_node(curr);
+	while(curr){
+		if(key == curr->key_){
+			unlock_node(curr);
+			unlock_node(prev);
+			destroy_node(new_node);
+			op_return(list, INSERT_ERROR);	// key already in use
+		}
+		if(key < curr->key_){
+			link_node(prev,new_node,curr);
+			wal_log(list,key,1,data);
+			unlock_node(prev);
+			unlock_node(curr);
+			op_return(list, SUCCES);
+		}
+		advance_node(prev,curr);
+	}
+	// never gets here
+	op_return(list, FAILURE_ERROR);
+}
+
+/**
+ * list_remove : Removes a new node with the given key from the given list.
+ * If a node with the given key does not exist the function will fail.
+ *
+ * input		: list 	- the given list.
+ * 				: key 	- the given key.
+ *
+ * output		: N/A
+ *
+ * return value	: 0 in case of success or anything else in case of failure.
+ */
+int list_remove(linked_list_t* list, int key){
+	if (!list)	return PARAM_ERROR;
+	op_begin(LIST_OP_REMOVE, key);
+	op_t fc_op;
+	if(fc_call(list, REMOVE, key, NULL, NULL, &fc_op) ||
+	   shm_call(list, REMOVE, key, NULL, NULL, &fc_op)){
+		op_return(list, fc_op.result);
+	}
+	linked_list_node prev, curr;
+	int res = lock_start(list, key, &prev);
+	if(res != SUCCES)
+		op_return(list, res);
+	curr = prev->next_;
+	lock_node(curr);
+	while(curr != get_last_anchor(list) && curr->key_ <= key){
+		if(key == curr->key_){
+			unlink_node(curr);
+			wal_log(list,key,0,NULL);
+			unlock_node(prev);
+			unlock_and_retire(curr);	// computes still running on it go on
+			op_return(list, SUCCES);
+		}
+		advance_node(prev,curr);
+	}
+	unlock_node(curr);
+	unlock_node(prev);
+	op_return(list, REMOVE_ERROR);
+}
+
+/**
+ * list_find : Checks if a node with the given key exist in the given list.
+ *
+ * input		: list 	- the given list.
+ * 				: key 	- the given key.
+ *
+ * output		: N/A
+ *
+ * return value	: 1 in case a node with the given key found or 0 otherwise.
+ */
+int list_find(linked_list_t* list, int key){
+	if (!list)
+		return PARAM_ERROR;
+	op_begin(LIST_OP_FIND, key);
+	op_t fc_op;
+	if(fc_call(list, CONTAINS, key, NULL, NULL, &fc_op) ||
+	   shm_call(list, CONTAINS, key, NULL, NULL, &fc_op)){
+		op_return(list, fc_op.result);
+	}
+	linked_list_node prev, curr;
+	int res = lock_start(list, key, &prev);
+	if(res != SUCCES)
+		op_return(list, res);
+	curr = prev->next_;
+	lock_node(curr);
+	while(curr != get_last_anchor(list) && curr->key_ <= key){
+		if(key == curr->key_){
+			unlock_node(curr);
+			unlock_node(prev);
+			op_return(list, VALUE_FOUND);
+		}
+		advance_node(prev,curr);
+	}
+	unlock_node(curr);
+	unlock_node(prev);
+	op_return(list, VALUE_NOT_FOUND);
+}
+
+/**
+ * list_size : Returns the number of nodes in the given list.
+ *
+ * input		: list 	- the given list.
+ *
+ * output		: N/A
+ *
+ * return value	: The number of nodes in the given list.
+ */
+int list_size(linked_list_t* list){
+	if (!list)	return PARAM_ERROR;
+	op_begin(LIST_OP_SIZE, 0);
+	if(list->shm_)
+		op_return(list, shm_size(list));
+	linked_list_node prev, curr;
+	int size=0;
+	lock_container(list);
+	prev = get_first_anchor(list);
+	if(!prev){	// if the lock was acquired after the list was freed
+		unlock_container(list);
+		op_return(list, LIST_FREE_ERROR);
+	}
+	lock_node(prev);
+	unlock_container(list);
+	curr = get_first_node(list);
+	lock_node(curr);
+	while(curr != get_last_anchor(list)){
+		size++;
+		advance_node(prev,curr);
+	}
+	unlock_node(curr);
+	unlock_node(prev);
+	op_return(list, size);
+}
+
+/**
+ * list_export : Copies the keys and data pointers of the given list, in key
+ * order, into two plain arrays, for scans that want dense memory rather than
+ * the chain of nodes. The data itself is not copied. The export is a snapshot
+ * of the list at a single point in time: new calls wait at the head of the
+ * list until the walk is over, while calls already inside it go on ahead.
+ * Like snprintf, the number of entries in the list is returned even if only
+ * cap of them fit, so a second call can be given big enough arrays.
+ *
+ * input		: list 	- the given list.
+ * 				: cap 	- the number of entries the arrays can hold.
+ *
+ * output		: keys 	- the keys (may be NULL).
+ * 				: data 	- the data pointers of the keys (may be NULL).
+ *
+ * return value	: The number of nodes in the given list or a negative value
+ * 				  in case of failure.
+ */
+int list_export(linked_list_t* list, int* keys, void** data, int cap){
+	if (!list || cap < 0)	return PARAM_ERROR;
+	if (list->shm_)	return DISABLED_ERROR;
+	int res;
+	epoch_enter();
+	res = export_nodes(list, &keys, &data, &cap, 0);
+	epoch_exit();
+	return res;
+}
+
+/**
+ * list_export_alloc : list_export into arrays allocated to the exact size of
+ * the list, to be released with free(). An empty list yields NULL arrays.
+ *
+ * input		: list 	- the given list.
+ *
+ * output		: keys 	- the array of keys (may be NULL if not wanted).
+ * 				: data 	- the array of data pointers (may be NULL if not
+ * 						  wanted).
+ *
+ * return value	: The number of entries exported or a negative value in case
+ * 				  of failure.
+ */
+int list_export_alloc(linked_list_t* list, int** keys, void*** data){
+	if (!list)	return PARAM_ERROR;
+	if (list->shm_)	return DISABLED_ERROR;
+	int* all_keys = NULL;
+	void** all_data = NULL;
+	int cap = 0, count;
+	epoch_enter();
+	count = export_nodes(list, &all_keys, &all_data, &cap, 1);
+	epoch_exit();
+	if(count <= 0){
+		free(all_keys);
+		free(all_data);
+		all_keys = NULL;
+		all_data = NULL;
+	}
+	else if(count < cap){	// trims both arrays to the exact size
+		int* fit_keys = (int*) realloc(all_keys, sizeof(int) * count);
+		void** fit_data = (void**) realloc(all_data, sizeof(void*) * count);
+		if(fit_keys)
+			all_keys = fit_keys;
+		if(fit_data)
+			all_data = fit_data;
+	}
+	if(keys)
+		*keys = all_keys;
+	else
+		free(all_keys);
+	if(data)
+		*data = all_data;
+	else
+		free(all_data);
+	return count;
+}
+
+/**
+ * list_update : Sets the given data as the new data of the node with the given
+ * key.
+ *
+ * input		: list 	- the given list.
+ * 				: key 	- the given key.
+ * 				: data 	- the given data to set.
+ *
+ * output		: N/A
+ *
+ * return value	: 0 in case of success or anything else in case of failure.
+ */
+int list_update(linked_list_t* list, int key, void* data){
+	if (!list || !data)	return PARAM_ERROR;
+	op_begin(LIST_OP_UPDATE, key);
+	op_t fc_op;
+	if(fc_call(list, UPDATE, key, data, NULL, &fc_op) ||
+	   shm_call(list, UPDATE, key, data, NULL, &fc_op)){
+		op_return(list, fc_op.result);
+	}
+	linked_list_node prev, curr;
+	int res = lock_start(list, key, &prev);
+	if(res != SUCCES)
+		op_return(list, res);
+	curr = prev->next_;
+	lock_node(curr);
+	while(curr != get_last_anchor(list) && curr->key_ <= key){
+		if(key == curr->key_){
+			set_data(curr, data);
+			wal_log(list,key,1,data);
+			unlock_node(curr);
+			unlock_node(prev);
+			op_return(list, SUCCES);
+		}
+		advance_node(prev,curr);
+	}
+	unlock_node(curr);
+	unlock_node(prev);
+	op_return(list, NOT_EX_ERROR);
+}
+
+/**
+ * list_compute : Computes the data of the node with the given key, using the
+ * user provided function.
+ *
+ * input		: list 			- the given list.
+ * 				: key 			- the given key.
+ * 				: compute_func 	- the computetion function.
+ * 				:
+ *
+ * output		: result		- the result of the computetion on the data.
+ *
+ * 			compute_func runs with no lock of the list held, side by side
+ * 			with other computes on the same node, unless the list has
+ * 			LIST_OPT_EXCLUSIVE_COMPUTE set. It then runs under the data lock
+ * 			of the node.
+ *
+ * return value	: 0 in case of success or anything else in case of failure.
+ */
+int list_compute(linked_list_t* list, int key, int (*compute_func) (void *), int* result){
+	if (!list || !compute_func || !result)	return PARAM_ERROR;
+	op_begin(LIST_OP_COMPUTE, key);
+	if(list->shm_){
+		op_t shm_op = {.op = COMPUTE, .key = key, .compute_func = compute_func};
+		op_return(list, shm_apply(list, &shm_op, result));
+	}
+	linked_list_node prev, curr;
+	int res = lock_start(list, key, &prev);
+	if(res != SUCCES)
+		op_return(list, res);
+	curr = prev->next_;
+	lock_node(curr);
+	while(curr != get_last_anchor(list) && curr->key_ <= key){
+		if(key == curr->key_){
+			if(list->memoize_ && memo_lookup(curr, compute_func, result)){
+				unlock_node(curr);
+				unlock_node(prev);
+				op_return(list, SUCCES);
+			}
+			int exclusive = list->exclusive_;
+			unsigned version;
+			if(exclusive)
+				lock_data(curr);	// before the node is let go, so computes queue in order
+			void* data = read_data(curr, &version);
+			unlock_node(curr);
+			unlock_node(prev);
+			*result = compute_func(data);
+			if(list->memoize_)
+				memo_store(curr, compute_func, version, *result);
+			if(exclusive)
+				unlock_data(curr);
+			op_return(list, SUCCES);
+		}
+		advance_node(prev,curr);
+	}
+	unlock_node(curr);
+	unlock_node(prev);
+	op_return(list, NOT_EX_ERROR);
+}
+
+/**
+ * list_upsert : Sets the given data as the data of the node with the given key,
+ * inserting a new node if no such node exists. Done in a single traversal.
+ *
+ * input		: list 	- the given list.
+ * 				: key 	- the given key.
+ * 				: data 	- the given data to set.
+ *
+ * output		: N/A
+ *
+ * return value	: 0 if a new node was inserted, 1 if an existing node was
+ * 				  updated or a negative value in case of failure.
+ */
+int list_upsert(linked_list_t* list, int key, void* data){
+	if (!list || !data)	return PARAM_ERROR;
+	op_begin(LIST_OP_UPSERT, key);
+	op_t fc_op;
+	if(fc_call(list, UPSERT, key, data, NULL, &fc_op) ||
+	   shm_call(list, UPSERT, key, data, NULL, &fc_op)){
+		op_return(list, fc_op.result);
+	}
+	linked_list_node prev, curr, new_node;
+	int res = lock_position(list, key, &prev, &curr);
+	if(res != SUCCES)
+		op_return(list, res);
+	if(is_key_node(list,curr,key)){
+		set_data(curr, data);
+		wal_log(list,key,1,data);
+		unlock_pair(prev,curr);
+		op_return(list, VALUE_FOUND);
+	}
+	new_node = create_node(list, key, data);
+	if(!new_node){
+		unlock_pair(prev,curr);
+		op_return(list, ALLOC_ERROR);
+	}
+	link_node(prev,new_node,curr);
+	wal_log(list,key,1,data);
+	unlock_pair(prev,curr);
+	op_return(list, SUCCES);
+}
+
+/**
+ * list_update_if : Sets the given data as the new data of the node with the
+ * given key, only if the node's current data is the expected one.
+ *
+ * input		: list 		- the given list.
+ * 				: key 		- the given key.
+ * 				: expected 	- the data the node is expected to hold.
+ * 				: data 		- the given data to set.
+ *
+ * output		: N/A
+ *
+ * return value	: 0 in case of success, MISMATCH_ERROR if the node holds other
+ * 				  data or anything else in case of failure.
+ */
+int list_update_if(linked_list_t* list, int key, void* expected, void* data){
+	if (!list || !data)	return PARAM_ERROR;
+	op_begin(LIST_OP_UPDATE_IF, key);
+	op_t fc_op;
+	if(fc_call(list, UPDATE_IF, key, data, expected, &fc_op) ||
+	   shm_call(list, UPDATE_IF, key, data, expected, &fc_op)){
+		op_return(list, fc_op.result);
+	}
+	linked_list_node prev, curr;
+	int res = lock_position(list, key, &prev, &curr);
+	if(res != SUCCES)
+		op_return(list, res);
+	if(!is_key_node(list,curr,key))
+		res = NOT_EX_ERROR;
+	else if(curr->data_ != expected)
+		res = MISMATCH_ERROR;
+	else{
+		set_data(curr, data);
+		wal_log(list,key,1,data);
 	}
-	// never gets here
-	return FAILURE_ERROR;
+	unlock_pair(prev,curr);
+	op_return(list, res);
 }
 
 /**
- * list_remove : Removes a new node with the given key from the given list.
- * If a node with the given key does not exist the function will fail.
+ * list_get_or_insert : Returns the data of the node with the given key,
+ * inserting a new node with the given data if no such node exists. Done in a
+ * single traversal.
  *
  * input		: list 	- the given list.
  * 				: key 	- the given key.
+ * 				: data 	- the data for the new node, if one is inserted.
+ *
+ * output		: result - the data the node holds after the call (optional).
+ *
+ * return value	: 0 if a new node was inserted, 1 if the node already existed
+ * 				  or a negative value in case of failure.
+ */
+int list_get_or_insert(linked_list_t* list, int key, void* data, void** result){
+	if (!list)	return PARAM_ERROR;
+	op_begin(LIST_OP_GET_OR_INSERT, key);
+	op_t fc_op;
+	if(fc_call(list, GET_OR_INSERT, key, data, NULL, &fc_op) ||
+	   shm_call(list, GET_OR_INSERT, key, data, NULL, &fc_op)){
+		if(result && fc_op.result >= 0)
+			*result = fc_op.data;
+		op_return(list, fc_op.result);
+	}
+	linked_list_node prev, curr, new_node;
+	int res = lock_position(list, key, &prev, &curr);
+	if(res != SUCCES)
+		op_return(list, res);
+	if(is_key_node(list,curr,key)){
+		if(result)
+			*result = curr->data_;
+		unlock_pair(prev,curr);
+		op_return(list, VALUE_FOUND);
+	}
+	new_node = create_node(list, key, data);
+	if(!new_node){
+		unlock_pair(prev,curr);
+		op_return(list, ALLOC_ERROR);
+	}
+	link_node(prev,new_node,curr);
+	wal_log(list,key,1,data);
+	unlock_pair(prev,curr);
+	if(result)
+		*result = data;
+	op_return(list, SUCCES);
+}
+
+/**
+ * list_insert_timed / list_remove_timed / list_find_timed / list_update_timed
+ * / list_compute_timed : The same as list_insert, list_remove, list_find,
+ * list_update and list_compute, except that every lock is waited for only
+ * until the given deadline. A call that runs out of time releases what it
+ * holds, changes nothing and fails with a timeout. Computes of the list are
+ * the usual reason to wait: a compute blocks the others on its node for as
+ * long as compute_func runs, and a walk past the node while they wait.
+ * These calls always walk the list themselves, even in flat-combining mode.
+ * A list with a write-ahead log waits for the disk on every change, so they
+ * are disabled for it, as for shared lists.
+ *
+ * input		: the input of the plain call, and
+ * 				: deadline 	- an absolute CLOCK_REALTIME time, or NULL not to
+ * 							  wait for any lock.
+ *
+ * output		: the output of the plain call.
+ *
+ * return value	: the return value of the plain call, -12 if the deadline
+ * 				  passed first, or -11 for a logged or shared list.
+ */
+int list_insert_timed(linked_list_t* list, int key, void* data,
+					  const struct timespec* deadline){
+	if (!list)	return PARAM_ERROR;
+	op_begin(LIST_OP_INSERT, key);
+	op_return(list, deadline_call(list, INSERT, key, data, NULL, NULL, deadline));
+}
+
+int list_remove_timed(linked_list_t* list, int key, const struct timespec* deadline){
+	if (!list)	return PARAM_ERROR;
+	op_begin(LIST_OP_REMOVE, key);
+	op_return(list, deadline_call(list, REMOVE, key, NULL, NULL, NULL, deadline));
+}
+
+int list_find_timed(linked_list_t* list, int key, const struct timespec* deadline){
+	if (!list)	return PARAM_ERROR;
+	op_begin(LIST_OP_FIND, key);
+	op_return(list, deadline_call(list, CONTAINS, key, NULL, NULL, NULL, deadline));
+}
+
+int list_update_timed(linked_list_t* list, int key, void* data,
+					  const struct timespec* deadline){
+	if (!list || !data)	return PARAM_ERROR;
+	op_begin(LIST_OP_UPDATE, key);
+	op_return(list, deadline_call(list, UPDATE, key, data, NULL, NULL, deadline));
+}
+
+int list_compute_timed(linked_list_t* list, int key, int (*compute_func) (void *),
+					   int* result, const struct timespec* deadline){
+	if (!list || !compute_func || !result)	return PARAM_ERROR;
+	op_begin(LIST_OP_COMPUTE, key);
+	op_return(list, deadline_call(list, COMPUTE, key, NULL, compute_func, result,
+								  deadline));
+}
+
+/**
+ * list_try_insert / list_try_remove / list_try_find / list_try_update /
+ * list_try_compute : The _timed calls with a NULL deadline. They fail with
+ * a timeout as soon as any lock they need is taken.
+ */
+int list_try_insert(linked_list_t* list, int key, void* data){
+	return list_insert_timed(list, key, data, NULL);
+}
+
+int list_try_remove(linked_list_t* list, int key){
+	return list_remove_timed(list, key, NULL);
+}
+
+int list_try_find(linked_list_t* list, int key){
+	return list_find_timed(list, key, NULL);
+}
+
+int list_try_update(linked_list_t* list, int key, void* data){
+	return list_update_timed(list, key, data, NULL);
+}
+
+int list_try_compute(linked_list_t* list, int key, int (*compute_func) (void *),
+					 int* result){
+	return list_compute_timed(list, key, compute_func, result, NULL);
+}
+
+/**
+ * list_synchronize : Waits until every API call that was running when it was
+ * called has returned. list_remove and list_free do not wait for computes
+ * still running on the removed nodes, so data must not be freed after its
+ * node was removed before list_synchronize returns. Calling it from inside a
+ * compute function is a no-op, as it would wait for itself.
+ *
+ * input		: N/A
+ *
+ * output		: N/A
+ *
+ * return value	: N/A
+ */
+void list_synchronize(){
+	if(tls_epoch_nest)
+		return;
+	unsigned long target = __atomic_load_n(&g_epoch, __ATOMIC_ACQUIRE) + 2;
+	while(__atomic_load_n(&g_epoch, __ATOMIC_ACQUIRE) < target)
+		if(!epoch_advance())
+			sched_yield();
+}
+
+/**
+ * list_set_option : Sets an execution option of the given list. Options must
+ * be set while no other call runs on the list, and are inherited by the
+ * lists list_split creates.
+ *
+ * LIST_OPT_COMBINING	- 1 to run the single-key calls besides list_compute
+ * 						  through a combiner (flat combining), 0 (the
+ * 						  default) to have every call walk the list itself.
+ * 						  Pays off when many threads write near each other.
+ * LIST_OPT_ELIMINATION	- 1 to have list_batch and list_batch_submit run the
+ * 						  ops of a batch that share a key, besides computes,
+ * 						  as one op in batch order, that only makes their net
+ * 						  change to the list. 0 (the default) to run every op
+ * 						  on its own.
+ * LIST_OPT_NUMA_NODE	- a NUMA node to place the nodes of the list on and
+ * 						  to pin the batch threads of the library to, or -1
+ * 						  (the default) for no placement. Only nodes
+ * 						  inserted afterwards are placed.
+ * LIST_OPT_PREFETCH	- how many nodes ahead walks prefetch: 0 for none,
+ * 						  1 (the default) or 2. Prefetching further hides
+ * 						  more of the memory latency of lists that do not
+ * 						  fit in cache, at the price of a racy read (benign,
+ * 						  but reported by ThreadSanitizer).
+ * LIST_OPT_MEMOIZE		- 1 to have every node remember the result of the
+ * 						  last compute on it, which further computes with
+ * 						  the same function return without running it,
+ * 						  until the data is set again by a call of the
+ * 						  list. Only for compute functions that depend on
+ * 						  nothing but the data and do not change it. 0 (the
+ * 						  default) to always run.
+ * LIST_OPT_EXCLUSIVE_COMPUTE
+ * 						- 1 to run the computes on a node one at a time,
+ * 						  under its data lock, for compute functions that
+ * 						  change what the data points to. 0 (the default)
+ * 						  to let computes on a node run side by side.
+ *
+ * input		: list 		- the given list.
+ * 				: option 	- one of LIST_OPT_*.
+ * 				: value 	- the value to set.
  *
  * output		: N/A
  *
  * return value	: 0 in case of success or anything else in case of failure.
  */
-int list_remove(linked_list_t* list, int key){
+int list_set_option(linked_list_t* list, int option, long value){
 	if (!list)	return PARAM_ERROR;
-	linked_list_node prev, curr;
-	lock_container(list);
-	prev = get_first_anchor(list);
-	if(!prev){	// if the lock was acquired after the list was freed
-		unlock_container(list);
-		return LIST_FREE_ERROR;
-	}
-	lock_node(prev);
-	unlock_container(list);
-	curr = get_first_node(list);
-	lock_node(curr);
-	while(curr != get_last_anchor(list)){
-		if(key == curr->key_){
-			unlink_node(curr);
-			unlock_node(prev);
-			lock_data(curr);
-			unlock_data(curr);
-			unlock_and_destroy(curr);
-			return SUCCES;
+	if (list->shm_)	return DISABLED_ERROR;
+	switch(option){
+	case LIST_OPT_COMBINING:
+		if(value && !list->fc_){
+			list->fc_ = fc_create();
+			if(!list->fc_)
+				return ALLOC_ERROR;
 		}
-		curr = curr->next_;
-		lock_node(curr);
-		unlock_node(prev);
-		prev = curr->prev_;
+		else if(!value && list->fc_){
+			fc_destroy(list->fc_);
+			list->fc_ = NULL;
+		}
+		return SUCCES;
+	case LIST_OPT_ELIMINATION:
+		list->eliminate_ = value != 0;
+		return SUCCES;
+	case LIST_OPT_NUMA_NODE:
+		if(value < -1 || value >= NUMA_MAX_NODES)
+			return PARAM_ERROR;
+		if(value >= 0 && numa_init_node((int)value) != SUCCES)
+			return PARAM_ERROR;
+		list->numa_ = (int)value;
+		return SUCCES;
+	case LIST_OPT_PREFETCH:
+		if(value < 0 || value > 2)
+			return PARAM_ERROR;
+		list->prefetch_ = (int)value;
+		return SUCCES;
+	case LIST_OPT_MEMOIZE:
+		list->memoize_ = value != 0;
+		return SUCCES;
+	case LIST_OPT_EXCLUSIVE_COMPUTE:
+		list->exclusive_ = value != 0;
+		return SUCCES;
+	default:
+		return PARAM_ERROR;
 	}
-	unlock_node(curr);
-	unlock_node(prev);
-	return REMOVE_ERROR;
 }
 
 /**
- * list_find : Checks if a node with the given key exist in the given list.
+ * list_compact : Moves the nodes of the given list into contiguous chunks of
+ * memory in key order, so walks read memory sequentially and the hardware
+ * prefetcher can follow them. Nodes already next to their neighbour in a
+ * chunk stay in place, so after some churn another pass only moves the nodes
+ * that came since. The pass walks hand-over-hand like any other call, holding
+ * at most three nodes at a time, so it may run from a background thread while
+ * the list is in use. Keys and data are kept, and computes still running on
+ * a moved node go on. A node an exclusive compute runs on is left in place.
  *
  * input		: list 	- the given list.
- * 				: key 	- the given key.
  *
  * output		: N/A
  *
- * return value	: 1 in case a node with the given key found or 0 otherwise.
+ * return value	: the number of nodes moved or a negative value in case of
+ * 				  failure.
  */
-int list_find(linked_list_t* list, int key){
-	if (!list)
-		return PARAM_ERROR;
-	linked_list_node prev, curr;
+int list_compact(linked_list_t* list){
+	if (!list)	return PARAM_ERROR;
+	if (list->shm_)	return DISABLED_ERROR;
+	linked_list_node prev, curr, next, copy;
+	node_chunk* chunk = NULL;
+	int moved = 0;
+	epoch_enter();
 	lock_container(list);
 	prev = get_first_anchor(list);
 	if(!prev){	// if the lock was acquired after the list was freed
 		unlock_container(list);
+		epoch_exit();
 		return LIST_FREE_ERROR;
 	}
 	lock_node(prev);
@@ -386,160 +3805,785 @@ int list_find(linked_list_t* list, int key){
 	curr = get_first_node(list);
 	lock_node(curr);
 	while(curr != get_last_anchor(list)){
-		if(key == curr->key_){
-			unlock_node(curr);
-			unlock_node(prev);
-			return VALUE_FOUND;
+		if(curr->home_ == HOME_CHUNK && (curr == prev + 1 || curr + 1 == curr->next_)){
+			advance_node(prev,curr);	// already in place
+			continue;
 		}
-		curr = curr->next_;
-		lock_node(curr);
+		if(pthread_mutex_trylock(&(curr->data_lock_))){
+			advance_node(prev,curr);	// an exclusive compute runs on it, a copy
+			continue;					// would let the next one run alongside
+		}
+		unlock_data(curr);	// none can take it while the node is locked
+		if(!chunk || chunk->used_ == CHUNK_NODES){
+			if(chunk){
+				chunk_release(chunk);
+				epoch_exit();	// the locked nodes stay linked, so the nodes
+				epoch_enter();	// moved so far can be reclaimed meanwhile
+			}
+			chunk = chunk_create(list->numa_);
+			if(!chunk){
+				unlock_pair(prev,curr);
+				epoch_exit();
+				return ALLOC_ERROR;
+			}
+		}
+		copy = chunk_node(chunk, chunk->used_++);
+		__atomic_add_fetch(&(chunk->refs_), 1, __ATOMIC_RELAXED);
+		copy->home_ = HOME_CHUNK;
+		copy->key_ 	= curr->key_;
+		copy->data_ = curr->data_;	// only written under the node lock
+		copy->version_ = curr->version_;
+		copy->memo_seq_ = 0;
+		copy->memo_func_ = NULL;
+		copy->list_ = list;
+		index_tower(list, copy);
+		init_node_locks(copy);
+		lock_node(copy);	// not reachable yet
+		next = curr->next_;
+		lock_node(next);
+		index_unlink(curr);
+		link_node(prev,copy,next);
+		unlock_and_retire(curr);	// computes still running on it go on
 		unlock_node(prev);
-		prev = curr->prev_;
+		prev = copy;
+		curr = next;
+		moved++;
 	}
-	unlock_node(curr);
-	unlock_node(prev);
-	return VALUE_NOT_FOUND;
+	unlock_pair(prev,curr);
+	if(chunk)
+		chunk_release(chunk);
+	epoch_exit();
+	return moved;
 }
 
 /**
- * list_size : Returns the number of nodes in the given list.
+ * list_stats : Collects the contention and traversal statistics of the given
+ * list. Only available when my_list.c is built with -DLIST_STATS, otherwise
+ * the output is zeroed and the call fails.
  *
  * input		: list 	- the given list.
  *
+ * output		: out 	- the accumulated statistics.
+ *
+ * return value	: 0 in case of success or anything else in case of failure.
+ */
+int list_stats(linked_list_t* list, list_stats_t* out){
+	if (!list || !out)	return PARAM_ERROR;
+	memset(out, 0, sizeof(*out));
+#ifdef LIST_STATS
+	unsigned long long* sum = (unsigned long long*) out;
+	size_t i, slot, n = sizeof(*out) / sizeof(unsigned long long);
+	for(slot=0;slot<STATS_SLOTS;slot++){
+		unsigned long long* counters = (unsigned long long*) &(list->stats_[slot].counters_);
+		for(i=0;i<n;i++)
+			sum[i] += __atomic_load_n(&counters[i], __ATOMIC_RELAXED);
+	}
+	return SUCCES;
+#else
+	return DISABLED_ERROR;
+#endif
+}
+
+/**
+ * list_trace_dump : Writes the most recent calls recorded by every thread to
+ * the given file, in the format of list_trace.h. Only available when my_list.c
+ * is built with -DLIST_TRACE. Records that are overwritten while being copied
+ * are left out, so the dump may be taken while the lists are in use.
+ *
+ * input		: path 	- the file to write.
+ *
  * output		: N/A
  *
- * return value	: The number of nodes in the given list.
+ * return value	: 0 in case of success or anything else in case of failure.
  */
-int list_size(linked_list_t* list){
-	if (!list)	return PARAM_ERROR;
+int list_trace_dump(const char* path){
+	if (!path)	return PARAM_ERROR;
+#ifdef LIST_TRACE
+	trace_header_t header = { TRACE_MAGIC, TRACE_VERSION, sizeof(trace_record_t), 0 };
+	trace_record_t* copy = (trace_record_t*) malloc(sizeof(trace_record_t) * TRACE_RING);
+	FILE* file = fopen(path, "wb");
+	trace_ring* ring;
+	if(!copy || !file){
+		free(copy);
+		if(file)
+			fclose(file);
+		return copy ? FILE_ERROR : ALLOC_ERROR;
+	}
+	fwrite(&header, sizeof(header), 1, file);
+	for(ring = __atomic_load_n(&g_trace_rings, __ATOMIC_ACQUIRE); ring; ring = ring->next_){
+		unsigned long long head = __atomic_load_n(&(ring->head_), __ATOMIC_ACQUIRE);
+		unsigned long long first = head > TRACE_RING ? head - TRACE_RING : 0, i;
+		for(i=first;i<head;i++)
+			copy[i - first] = ring->records_[i & (TRACE_RING - 1)];
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		// records the owner may have overwritten during the copy are dropped
+		unsigned long long now = __atomic_load_n(&(ring->head_), __ATOMIC_RELAXED);
+		unsigned long long skip = now + 1 > TRACE_RING + first ?
+								  now + 1 - TRACE_RING - first : 0;
+		if(skip >= head - first)
+			continue;
+		fwrite(copy + skip, sizeof(trace_record_t), head - first - skip, file);
+		header.count += (uint32_t)(head - first - skip);
+	}
+	rewind(file);
+	fwrite(&header, sizeof(header), 1, file);
+	free(copy);
+	return fclose(file) ? FILE_ERROR : SUCCES;
+#else
+	return DISABLED_ERROR;
+#endif
+}
+
+/**
+ * save_image : writes the snapshot of list_save, syncing it to disk if asked
+ * to. The list is walked with walk_begin and the payloads are copied while
+ * their node is locked, so the snapshot is the list at a single point in
+ * time. A list with a log records the last sequence number handed out before
+ * the walk, each mutation up to it is reflected by the snapshot.
+ */
+static int save_image(linked_list list, const char* path, size_t data_size, int sync){
 	linked_list_node prev, curr;
-	int size=0;
-	lock_container(list);
-	prev = get_first_anchor(list);
-	if(!prev){	// if the lock was acquired after the list was freed
-		unlock_container(list);
-		return LIST_FREE_ERROR;
+	uint64_t lsn = list->wal_ ? __atomic_load_n(&(list->wal_->next_lsn_), __ATOMIC_RELAXED) : 0;
+	uint64_t stride = align8(data_size), zero = 0;
+	size_t count = 0, capacity = 1024, i;
+	int* keys = (int*) malloc(sizeof(int) * capacity);
+	void** data = (void**) malloc(sizeof(void*) * capacity);
+	char* payloads = data_size ? (char*) malloc(stride * capacity) : NULL;
+	int res = SUCCES;
+	if(!keys || !data || (data_size && !payloads)){
+		free(keys);
+		free(data);
+		free(payloads);
+		return ALLOC_ERROR;
+	}
+	res = walk_begin(list, &prev, &curr);
+	if(res != SUCCES){
+		free(keys);
+		free(data);
+		free(payloads);
+		return res;
 	}
-	lock_node(prev);
-	unlock_container(list);
-	curr = get_first_node(list);
-	lock_node(curr);
 	while(curr != get_last_anchor(list)){
-		size++;
-		curr = curr->next_;
-		lock_node(curr);
-		unlock_node(prev);
-		prev = curr->prev_;
+		if(count == capacity){
+			int* more_keys = (int*) realloc(keys, sizeof(int) * capacity * 2);
+			if(more_keys)
+				keys = more_keys;
+			void** more_data = (void**) realloc(data, sizeof(void*) * capacity * 2);
+			if(more_data)
+				data = more_data;
+			char* more_payloads = data_size ? (char*) realloc(payloads, stride * capacity * 2)
+											: NULL;
+			if(more_payloads)
+				payloads = more_payloads;
+			if(!more_keys || !more_data || (data_size && !more_payloads)){
+				res = ALLOC_ERROR;
+				break;
+			}
+			capacity *= 2;
+		}
+		keys[count] = curr->key_;
+		data[count] = curr->data_;
+		if(data_size && data[count])
+			memcpy(payloads + stride * count, data[count], data_size);
+		count++;
+		advance_node(prev,curr);
 	}
-	unlock_node(curr);
-	unlock_node(prev);
-	return size;
+	walk_end(list, prev, curr);
+
+	FILE* file = res == SUCCES ? fopen(path, "wb") : NULL;
+	if(file){
+		image_header header = { IMAGE_MAGIC, IMAGE_VERSION, data_size, count, lsn };
+		uint64_t offset = sizeof(header) + align8(sizeof(int) * count) +
+						  sizeof(uint64_t) * count;
+		fwrite(&header, sizeof(header), 1, file);
+		fwrite(keys, sizeof(int), count, file);
+		fwrite(&zero, 1, align8(sizeof(int) * count) - sizeof(int) * count, file);
+		for(i=0;i<count;i++){
+			uint64_t value = (uint64_t)(uintptr_t)data[i];
+			if(data_size && data[i]){
+				value = offset;
+				offset += stride;
+			}
+			fwrite(&value, sizeof(value), 1, file);
+		}
+		for(i=0;data_size && i<count;i++){
+			if(!data[i])
+				continue;
+			fwrite(payloads + stride * i, 1, data_size, file);
+			fwrite(&zero, 1, stride - data_size, file);
+		}
+		if(fflush(file) || ferror(file) || (sync && fdatasync(fileno(file))))
+			res = FILE_ERROR;
+		if(fclose(file))
+			res = FILE_ERROR;
+	}
+	else if(res == SUCCES)
+		res = FILE_ERROR;
+	free(keys);
+	free(data);
+	free(payloads);
+	return res;
 }
 
 /**
- * list_update : Sets the given data as the new data of the node with the given
- * key.
+ * list_save : Writes a key-sorted snapshot of the given list to a file, which
+ * list_load can map back. Other threads may keep using the list meanwhile:
+ * the snapshot is the list at a single point in time during the call, with
+ * every payload as it was then.
  *
- * input		: list 	- the given list.
- * 				: key 	- the given key.
- * 				: data 	- the given data to set.
+ * input		: list 		- the given list.
+ * 				: path 		- the file to write.
+ * 				: data_size - the size of the payload every data pointer points
+ * 							  to, which is copied into the file. If 0 the
+ * 							  pointers themselves are saved instead.
  *
  * output		: N/A
  *
  * return value	: 0 in case of success or anything else in case of failure.
  */
-int list_update(linked_list_t* list, int key, void* data){
-	if (!list || !data)	return PARAM_ERROR;
-	linked_list_node prev, curr;
-	lock_container(list);
-	prev = get_first_anchor(list);
-	if(!prev){	// if the lock was acquired after the list was freed
-		unlock_container(list);
-		return LIST_FREE_ERROR;
+int list_save(linked_list_t* list, const char* path, size_t data_size){
+	if (!list || !path)	return PARAM_ERROR;
+	if (list->shm_)	return DISABLED_ERROR;
+	return save_image(list, path, data_size, 0);
+}
+
+/**
+ * load_image : builds the list of list_load and hands back the snapshot
+ * header, which tells how to recover the list's log.
+ */
+static linked_list load_image(const char* path, image_header* out){
+	struct stat st;
+	int fd = open(path, O_RDONLY);
+	if(fd < 0)
+		return NULL;
+	if(fstat(fd, &st) || (size_t)st.st_size < sizeof(image_header)){
+		close(fd);
+		return NULL;
 	}
-	lock_node(prev);
-	unlock_container(list);
-	curr = get_first_node(list);
-	lock_node(curr);
-	while(curr != get_last_anchor(list)){
-		if(key == curr->key_){
-			curr->data_ = data;
-			unlock_node(curr);
-			unlock_node(prev);
-			return SUCCES;
+	size_t length = (size_t)st.st_size;
+	char* base = (char*) mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(base == MAP_FAILED)
+		return NULL;
+	madvise(base, length, MADV_SEQUENTIAL);
+	image_header* header = (image_header*) base;
+	uint64_t count = header->count, i;
+	uint64_t values_at = sizeof(*header) + align8(sizeof(int) * count);
+	linked_list list = NULL;
+	list_image* image = NULL;
+	if(header->magic != IMAGE_MAGIC || header->version != IMAGE_VERSION ||
+	   count > length / sizeof(uint64_t) ||
+	   values_at + sizeof(uint64_t) * count > length)
+		goto fail;
+	list = list_alloc();
+	if(!list)
+		goto fail;
+	if(header->data_size){
+		image = (list_image*) malloc(sizeof(*image));
+		if(!image)
+			goto fail;
+		image->base_ = base;
+		image->length_ = length;
+		image->refs_ = 1;
+		image->next_ = NULL;
+		list->image_ = image;
+	}
+	int* keys = (int*)(base + sizeof(*header));
+	uint64_t* values = (uint64_t*)(base + values_at);
+	for(i=0;i<count;i++){
+		void* data = (void*)(uintptr_t)values[i];
+		if(i && keys[i] <= keys[i-1])
+			goto fail;	// keys must be strictly ascending
+		if(header->data_size && values[i]){
+			if(values[i] < values_at || values[i] > length ||
+			   length - values[i] < header->data_size)
+				goto fail;
+			data = base + values[i];
 		}
-		curr = curr->next_;
-		lock_node(curr);
-		unlock_node(prev);
-		prev = curr->prev_;
+		linked_list_node node = create_node(list, keys[i], data);
+		if(!node)
+			goto fail;
+		link_node(get_last_node(list),node,get_last_anchor(list));
 	}
-	unlock_node(curr);
-	unlock_node(prev);
-	return NOT_EX_ERROR;
+	*out = *header;
+	if(!image)
+		munmap(base, length);
+	return list;
+
+fail:
+	if(list)
+		list_free(list);	// also unmaps the image, if it was attached
+	if(!image)
+		munmap(base, length);
+	return NULL;
 }
 
 /**
- * list_compute : Computes the data of the node with the given key, using the
- * user provided function.
+ * list_load : Creates a new list from a snapshot written by list_save. The
+ * file is mapped and the list is built in a single pass over it, without any
+ * traversal. Saved payloads are served directly from the (private, copy on
+ * write) mapping, which lives as long as any list holding its nodes.
  *
- * input		: list 			- the given list.
- * 				: key 			- the given key.
- * 				: compute_func 	- the computetion function.
- * 				:
+ * input		: path 	- the snapshot file.
  *
- * output		: result		- the result of the computetion on the data.
+ * output		: N/A
+ *
+ * return value	: A new linked list or NULL in case of failure.
+ */
+linked_list_t* list_load(const char* path){
+	image_header header;
+	if (!path)	return NULL;
+	return load_image(path, &header);
+}
+
+/**
+ * list_wal_attach : Starts logging every change of the given list into a
+ * write-ahead log, so it survives a crash. Each call (and each list_batch)
+ * returns only once its changes are on disk, and concurrent callers share
+ * the disk syncs. Must be called before the list is shared between threads.
+ * The log is closed by list_free and list_split, the lists list_split
+ * creates are not logged.
+ *
+ * input		: list 		- the given list.
+ * 				: path 		- the log file, created if it does not exist.
+ * 				: data_size - the size of the payload every data pointer points
+ * 							  to, as for list_save. If 0 only the pointers are
+ * 							  logged.
+ *
+ * output		: N/A
+ *
+ * return value	: 0 in case of success or anything else in case of failure.
+ */
+int list_wal_attach(linked_list_t* list, const char* path, size_t data_size){
+	if (!list || !path || list->wal_)	return PARAM_ERROR;
+	if (list->shm_)	return DISABLED_ERROR;
+	list->wal_ = wal_open(path, data_size, 0);
+	return list->wal_ ? SUCCES : FILE_ERROR;
+}
+
+/**
+ * list_checkpoint : Durably replaces the given snapshot file with a snapshot
+ * of the given logged list, then drops the log records it covers. Other
+ * threads may keep modifying the list meanwhile.
+ *
+ * input		: list 	- the given list.
+ * 				: path 	- the snapshot file to replace.
+ *
+ * output		: N/A
  *
  * return value	: 0 in case of success or anything else in case of failure.
  */
-int list_compute(linked_list_t* list, int key, int (*compute_func) (void *), int* result){
-	if (!list || !compute_func || !result)	return PARAM_ERROR;
-	linked_list_node prev, curr;
-	lock_container(list);
-	prev = get_first_anchor(list);
-	if(!prev){	// if the lock was acquired after the list was freed
-		unlock_container(list);
-		return LIST_FREE_ERROR;
+int list_checkpoint(linked_list_t* list, const char* path){
+	if (!list || !path || !list->wal_)	return PARAM_ERROR;
+	list_wal* wal = list->wal_;
+	uint64_t lsn = __atomic_load_n(&(wal->next_lsn_), __ATOMIC_RELAXED);
+	char tmp[PATH_MAX];
+	int res;
+	if(snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp))
+		return PARAM_ERROR;
+	res = save_image(list, tmp, wal->data_size_, 1);
+	if(res == SUCCES && rename(tmp, path))
+		res = FILE_ERROR;
+	if(res != SUCCES){
+		unlink(tmp);
+		return res;
+	}
+	sync_parent(path);
+	return wal_truncate(wal, lsn);
+}
+
+/**
+ * apply_entry : sets the key of the given log entry to the state it logged.
+ */
+static int apply_entry(linked_list list, const wal_entry* entry){
+	linked_list_node prev, curr, node;
+	void* data = entry->flags & WAL_PAYLOAD ? (void*)(entry + 1) :
+											  (void*)(uintptr_t)entry->value;
+	int res = lock_position(list, entry->key, &prev, &curr);
+	if(res != SUCCES)
+		return res;
+	if(is_key_node(list,curr,entry->key)){
+		if(entry->flags & WAL_PRESENT)
+			set_data(curr, data);
+		else{
+			node = curr;
+			unlink_node(node);
+			curr = node->next_;
+			lock_node(curr);
+			unlock_and_destroy(node);
+		}
+	}
+	else if(entry->flags & WAL_PRESENT){
+		node = create_node(list, entry->key, data);
+		if(!node)
+			res = ALLOC_ERROR;
+		else{
+			link_node(prev,node,curr);
+		}
+	}
+	unlock_pair(prev,curr);
+	return res;
+}
+
+static int compare_lsn(const void* a, const void* b){
+	uint64_t x = (*(const wal_entry* const*)a)->lsn, y = (*(const wal_entry* const*)b)->lsn;
+	return x < y ? -1 : x > y;
+}
+
+/**
+ * list_recover : Rebuilds a logged list after a crash or a restart: maps the
+ * snapshot last written by list_checkpoint (if any), replays the log entries
+ * it does not cover in sequence order and attaches the log to the new list,
+ * to keep logging its changes. Replayed payloads are served from a private
+ * mapping of the log, the same way list_load serves snapshot payloads.
+ *
+ * input		: snapshot 	- the snapshot file, or NULL if there is none.
+ * 				: path 		- the log file.
+ * 				: data_size - the payload size the log was attached with.
+ *
+ * output		: N/A
+ *
+ * return value	: The recovered list or NULL in case of failure.
+ */
+linked_list_t* list_recover(const char* snapshot, const char* path, size_t data_size){
+	if (!path)	return NULL;
+	image_header header = { IMAGE_MAGIC, IMAGE_VERSION, data_size, 0, 0 };
+	linked_list list = snapshot ? load_image(snapshot, &header) : list_alloc();
+	const wal_entry** entries = NULL;
+	size_t count = 0, capacity = 0, length = 0, end = sizeof(wal_header), offset, i;
+	const wal_record* record;
+	const wal_entry* entry;
+	list_image* image = NULL;
+	char* base = NULL;
+	int fd, payloads = 0;
+	if(!list || header.data_size != data_size)
+		goto fail;
+	fd = open(path, O_RDONLY);
+	if(fd >= 0){
+		base = wal_map(fd, data_size, &length);
+		close(fd);
+		if(!base)
+			goto fail;
 	}
-	lock_node(prev);
-	unlock_container(list);
-	curr = get_first_node(list);
-	lock_node(curr);
-	while(curr != get_last_anchor(list)){
-		if(key == curr->key_){
-			lock_data(curr);
-			void* data = curr->data_;
-			unlock_data(curr);
-			unlock_node(curr);
-			unlock_node(prev);
-			lock_data(curr);
-			*result = compute_func(data);
-			unlock_data(curr);
-			return SUCCES;
+	while(base && (record = wal_next(base, length, &end))){
+		uint32_t j;
+		for(j=0, offset=0;j<record->count;j++){
+			if(!(entry = wal_next_entry(record, &offset, data_size)))
+				break;
+			if(entry->lsn <= header.lsn)
+				continue;	// already in the snapshot
+			if(count == capacity){
+				capacity = capacity ? capacity * 2 : 1024;
+				const wal_entry** more = (const wal_entry**) realloc(entries,
+											sizeof(*entries) * capacity);
+				if(!more)
+					goto fail;
+				entries = more;
+			}
+			entries[count++] = entry;
+			payloads |= entry->flags & WAL_PAYLOAD;
 		}
-		curr = curr->next_;
-		lock_node(curr);
-		unlock_node(prev);
-		prev = curr->prev_;
 	}
-	unlock_node(curr);
-	unlock_node(prev);
-	return NOT_EX_ERROR;
+	qsort(entries, count, sizeof(*entries), compare_lsn);
+	for(i=0;i<count;i++)
+		if(apply_entry(list, entries[i]) != SUCCES)
+			goto fail;
+	free(entries);
+	entries = NULL;
+	if(payloads){	// replayed nodes point into the log mapping
+		image = (list_image*) malloc(sizeof(*image));
+		if(!image)
+			goto fail;
+		image->base_ = base;
+		image->length_ = length;
+		image->refs_ = 1;
+		image->next_ = NULL;
+		if(list->image_)
+			list->image_->next_ = image;
+		else
+			list->image_ = image;
+	}
+	else if(base)
+		munmap(base, length);
+	base = NULL;
+	list->wal_ = wal_open(path, data_size, header.lsn);
+	if(!list->wal_)
+		goto fail;
+	return list;
+
+fail:
+	free(entries);
+	if(base)
+		munmap(base, length);
+	if(list)
+		list_free(list);
+	return NULL;
 }
 
 typedef struct op_wrapper_t
 {
 	linked_list_t* list;
 	op_t* op;
+	wal_buffer wal;		// the changes op made to a logged list
+	struct list_ticket_t* ticket;	// the submitted batch op belongs to
+	struct op_wrapper_t* next;		// in the executor queue
+	struct op_wrapper_t* leader;	// runs op with the rest of its group
+	struct op_wrapper_t* group;		// the next op of the group, if leading
 } op_wrapper;
 
 /**
- * wrapper function to be used for pthread_create in list_batch
+ * list_ticket_t : a batch handed to the executor by list_batch_submit. Its
+ * ops run on the executor's workers, the last one to finish completes it.
  */
-void* batch_wrapper(void* param){
+struct list_ticket_t{
+	linked_list 		list_;
+	op_t* 				ops_;
+	int 				num_ops_;
+	int 				pending_;	// ops not done yet
+	int 				done_;
+	pthread_mutex_t 	lock_;
+	pthread_cond_t 		cond_;
+	list_batch_callback callback_;	// if set, nobody waits for the ticket
+	void* 				arg_;
+	op_wrapper 			wrappers_[];
+};
+
+/**
+ * executor_t : the library's pool of worker threads, started on the first
+ * submitted batch and kept for the life of the process. Workers take single
+ * ops from a FIFO queue, so the ops of a batch run in parallel.
+ */
+typedef struct executor_t{
+	pthread_mutex_t lock_;
+	pthread_cond_t 	cond_;
+	op_wrapper* 	head_;
+	op_wrapper* 	tail_;
+	int 			workers_;
+} executor;
+
+static executor 		g_executor = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+									   NULL, NULL, 0 };
+static pthread_once_t 	g_executor_once = PTHREAD_ONCE_INIT;
+static __thread int 	tls_executor_worker;	// set on the executor's threads
+static __thread int 	tls_batch_thread;		// set on the threads batch_run may pin
+
+/*
+ * list_batch picks how to run a batch from its size and the recent time per
+ * op of its list. A batch expected to take less time than handing it over to
+ * other threads runs in the calling thread, a bigger one on the executor's
+ * workers, one per core, and ops slow enough to be blocked on something get
+ * a thread each, as a pool of one thread per core would leave cores idle.
+ */
+enum { BATCH_INLINE, BATCH_POOL, BATCH_FAN_OUT };
+
+static int ticket_submit(linked_list list, int num_ops, op_t* ops,
+						 list_batch_callback callback, void* arg,
+						 list_ticket_t** out);
+
+static inline unsigned long long batch_now(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * batch_strategy : picks the way list_batch runs a batch of the given size.
+ * The executor's workers never wait for the pool, which they may be all of.
+ */
+static int batch_strategy(linked_list list, int num_ops){
+	unsigned long long per_op = __atomic_load_n(&(list->batch_ns_), __ATOMIC_RELAXED);
+	if(num_ops == 1 || per_op * num_ops < BATCH_INLINE_NS)
+		return BATCH_INLINE;
+	if(per_op >= BATCH_FAN_OUT_NS || tls_executor_worker)
+		return BATCH_FAN_OUT;
+	return BATCH_POOL;
+}
+
+/**
+ * compare_wrapper_keys : orders the ops of a batch by key, then by position.
+ */
+static int compare_wrapper_keys(const void* a, const void* b){
+	const op_wrapper* x = *(op_wrapper* const*)a;
+	const op_wrapper* y = *(op_wrapper* const*)b;
+	if(x->op->key != y->op->key)
+		return x->op->key < y->op->key ? -1 : 1;
+	return x < y ? -1 : (x > y);
+}
+
+/**
+ * batch_group : on a list with LIST_OPT_ELIMINATION set, gathers the ops of
+ * a batch that share a key, besides computes, into groups led by the first
+ * of them in the batch. The leaders are chained through next, and only they
+ * are run. Returns the first leader.
+ */
+static op_wrapper* batch_group(linked_list list, int num_ops, op_wrapper* wrappers){
+	int i, j;
+	op_wrapper** sorted = list->eliminate_ && num_ops > 1 ?
+						  (op_wrapper**) malloc(sizeof(op_wrapper*) * num_ops) : NULL;
+	if(sorted){	// or every op runs on its own
+		for(i=0;i<num_ops;i++)
+			sorted[i] = &wrappers[i];
+		qsort(sorted, num_ops, sizeof(op_wrapper*), compare_wrapper_keys);
+		for(i=0;i<num_ops;i=j){
+			op_wrapper* last = NULL;
+			for(j=i;j<num_ops && sorted[j]->op->key == sorted[i]->op->key;j++){
+				if(sorted[j]->op->op == COMPUTE)
+					continue;	// user code, not worth holding the key for
+				if(last){
+					sorted[j]->leader = last->leader ? last->leader : last;
+					last->group = sorted[j];
+				}
+				last = sorted[j];
+			}
+		}
+		free(sorted);
+	}
+	op_wrapper *first = NULL, *prev = NULL;
+	for(i=0;i<num_ops;i++){
+		if(wrappers[i].leader)
+			continue;
+		if(prev)
+			prev->next = &wrappers[i];
+		else
+			first = &wrappers[i];
+		prev = &wrappers[i];
+	}
+	prev->next = NULL;
+	return first;
+}
+
+/**
+ * batch_eliminate : runs a group of ops on a single key with one traversal.
+ * The ops are played in batch order against the state of the key, each one
+ * getting the result it would have gotten on its own, and only the net
+ * change is made to the list: an INSERT that a later REMOVE cancels never
+ * links a node, and of several UPDATEs only the last data is stored.
+ */
+static void batch_eliminate(linked_list list, op_wrapper* leader){
+	int key = leader->op->key;
+	int present, inserts = 0, written = 0, res;
+	void* data;
+	op_wrapper* w;
+	linked_list_node prev, curr, node = NULL;
+	epoch_enter();
+	for(w=leader;w;w=w->group)
+		inserts |= w->op->op == INSERT || w->op->op == UPSERT || w->op->op == GET_OR_INSERT;
+	res = lock_position(list, key, &prev, &curr);
+	if(res != SUCCES){
+		for(w=leader;w;w=w->group)
+			w->op->result = res;
+		epoch_exit();
+		return;
+	}
+	present = is_key_node(list,curr,key);
+	data = present ? curr->data_ : NULL;
+	if(inserts && !present)	// before the ops, so the results stand
+		node = create_node(list, key, NULL);
+	int linkable = present || node;	// a node for the key to end up in
+	for(w=leader;w;w=w->group){
+		op_t* op = w->op;
+		switch(op->op){
+		case INSERT:
+			op->result = present ? INSERT_ERROR : !linkable ? ALLOC_ERROR : SUCCES;
+			if(op->result == SUCCES){
+				present = 1;
+				data = op->data;
+				written = 1;
+			}
+			break;
+		case REMOVE:
+			op->result = present ? SUCCES : REMOVE_ERROR;
+			present = 0;
+			break;
+		case CONTAINS:
+			op->result = present ? VALUE_FOUND : VALUE_NOT_FOUND;
+			break;
+		case UPDATE:
+			op->result = !op->data ? PARAM_ERROR : present ? SUCCES : NOT_EX_ERROR;
+			if(op->result == SUCCES){
+				data = op->data;
+				written = 1;
+			}
+			break;
+		case UPSERT:
+			op->result = !op->data ? PARAM_ERROR : present ? VALUE_FOUND :
+						 !linkable ? ALLOC_ERROR : SUCCES;
+			if(op->result >= 0){
+				present = 1;
+				data = op->data;
+				written = 1;
+			}
+			break;
+		case UPDATE_IF:
+			op->result = !op->data ? PARAM_ERROR : !present ? NOT_EX_ERROR :
+						 data != op->expected ? MISMATCH_ERROR : SUCCES;
+			if(op->result == SUCCES){
+				data = op->data;
+				written = 1;
+			}
+			break;
+		case GET_OR_INSERT:
+			if(present){
+				op->result = VALUE_FOUND;
+				op->data = data;
+			}
+			else{
+				op->result = linkable ? SUCCES : ALLOC_ERROR;
+				present = op->result == SUCCES;
+				if(present){
+					data = op->data;
+					written = 1;
+				}
+			}
+			break;
+		default:
+			break;
+		}
+	}
+	if(is_key_node(list,curr,key)){
+		if(!present){
+			unlink_node(curr);
+			wal_log(list,key,0,NULL);
+			unlock_node(prev);
+			unlock_and_retire(curr);	// computes still running on it go on
+			curr = NULL;
+		}
+		else if(written){	// even with the same pointer, for the memo
+			if(curr->data_ != data)
+				wal_log(list,key,1,data);
+			set_data(curr, data);
+		}
+	}
+	else if(present){
+		node->data_ = data;
+		link_node(prev,node,curr);
+		wal_log(list,key,1,data);
+		node = NULL;
+	}
+	if(curr){
+		unlock_pair(prev,curr);
+	}
+	if(node)
+		destroy_node(node);
+	epoch_exit();
+}
+
+/**
+ * batch_run : runs a single op of a batch, or the group it leads.
+ */
+static void batch_run(void* param){
 	linked_list_t* list=(((op_wrapper*)param)->list);
 	op_t* curr_op=(((op_wrapper*)param)->op);
 	int current_key = curr_op->key;
 	int res;
+	tls_wal_buf = &(((op_wrapper*)param)->wal);
+	if(tls_batch_thread && (list->numa_ >= 0 || tls_numa_pinned >= 0))
+		numa_pin(list->numa_);
+	if(((op_wrapper*)param)->group){
+		batch_eliminate(list, (op_wrapper*)param);
+		tls_wal_buf = NULL;
+		return;
+	}
 		switch(curr_op->op){
 		case INSERT:
 			curr_op->result =  list_insert(list, current_key, (curr_op->data));
@@ -557,8 +4601,116 @@ void* batch_wrapper(void* param){
 			curr_op->result = list_compute(list,current_key,curr_op->compute_func, &res);
 			curr_op->data = (void*)(long long)res;
 			break;
+		case UPSERT:
+			curr_op->result = list_upsert(list, current_key, curr_op->data);
+			break;
+		case UPDATE_IF:
+			curr_op->result = list_update_if(list, current_key,
+											curr_op->expected, curr_op->data);
+			break;
+		case GET_OR_INSERT:
+			curr_op->result = list_get_or_insert(list, current_key,
+											curr_op->data, &(curr_op->data));
+			break;
 		}
-		return NULL;
+		tls_wal_buf = NULL;
+}
+
+/**
+ * wrapper function to be used for pthread_create in list_batch. It also
+ * keeps the time per op of the list up to date, as a moving average.
+ */
+void* batch_wrapper(void* param){
+	linked_list list = ((op_wrapper*)param)->list;
+	unsigned long long start = batch_now(), average;
+	long long spent;
+	batch_run(param);
+	spent = (long long)(batch_now() - start);
+	average = __atomic_load_n(&(list->batch_ns_), __ATOMIC_RELAXED);
+	__atomic_store_n(&(list->batch_ns_), average + (spent - (long long)average) / 8,
+					 __ATOMIC_RELAXED);	// a lost update only slows the average down
+	return NULL;
+}
+
+/**
+ * batch_thread : entry of a thread a batch is fanned out to.
+ */
+static void* batch_thread(void* param){
+	tls_batch_thread = 1;
+	return batch_wrapper(param);
+}
+
+/**
+ * batch_commit : appends the changes of a whole batch to the log as a single
+ * record. The ops whose changes could not be logged fail, as they may not
+ * survive a crash.
+ */
+static void batch_commit(list_wal* wal, int num_ops, op_wrapper* wrappers){
+	size_t length = 0;
+	uint32_t count = 0;
+	int i, res = SUCCES;
+	for(i=0;i<num_ops;i++){
+		length += wrappers[i].wal.len_;
+		count += wrappers[i].wal.count_;
+		if(wrappers[i].wal.error_)
+			res = wrappers[i].wal.error_;
+	}
+	char* entries = (char*) malloc(length ? length : 1);
+	if(!entries)
+		res = ALLOC_ERROR;
+	if(res == SUCCES && count){
+		for(i=0, length=0;i<num_ops;i++){
+			if(wrappers[i].wal.len_)
+				memcpy(entries + length, wrappers[i].wal.data_, wrappers[i].wal.len_);
+			length += wrappers[i].wal.len_;
+		}
+		res = wal_append(wal, entries, length, count);
+	}
+	free(entries);
+	for(i=0;res != SUCCES && i<num_ops;i++){
+		op_wrapper* runner = wrappers[i].leader ? wrappers[i].leader : &wrappers[i];
+		if(runner->wal.wal_ && wrappers[i].op->result >= 0)
+			wrappers[i].op->result = res;
+	}
+}
+
+/**
+ * batch_local : runs a batch in the calling thread, or on a thread per op or
+ * group when fan_out is set, and logs it as a single record.
+ */
+static void batch_local(linked_list list, int num_ops, op_t* ops, int fan_out){
+	int i, n = 0;
+	op_wrapper local[BATCH_LOCAL_OPS], *wrappers = local, *w;
+	if(num_ops > BATCH_LOCAL_OPS)
+		wrappers = (op_wrapper*) calloc(num_ops, sizeof(op_wrapper));
+	else
+		memset(local, 0, sizeof(op_wrapper) * num_ops);
+	if (!wrappers)
+		return;
+	for(i=0;i<num_ops;i++){
+		wrappers[i].list= list;
+		wrappers[i].op=&(ops[i]);
+	}
+	if(fan_out){
+		pthread_t threads[num_ops];
+		for(w=batch_group(list, num_ops, wrappers);w;w=w->next)
+			if(pthread_create(&(threads[n]), NULL, batch_thread, (void*)w))
+				batch_wrapper(w);	// out of threads, it runs here instead
+			else
+				n++;
+		for(i=0;i<n;i++)
+			pthread_join(threads[i], NULL);
+	}
+	else{
+		for(w=batch_group(list, num_ops, wrappers);w;w=w->next)
+			batch_wrapper(w);
+	}
+	if(list->wal_)
+		batch_commit(list->wal_, num_ops, wrappers);
+	for(i=0;i<num_ops;i++)
+		free(wrappers[i].wal.data_);
+	if(wrappers != local)
+		free(wrappers);
 }
 
 /**
@@ -572,11 +4724,21 @@ void* batch_wrapper(void* param){
  * 			typedef struct op_t {
  *				int key;
  *				void* data;
- *				enum {INSERT, REMOVE, CONTAINS, UPDATE, COMPUTE} op;
+ *				enum {INSERT, REMOVE, CONTAINS, UPDATE, COMPUTE,
+ *					  UPSERT, UPDATE_IF, GET_OR_INSERT} op;
  * 				int (*compute_func) (void *);
  * 				int result;
+ * 				void* expected;
  * 			} op_t;
  *
+ * 			For GET_OR_INSERT the data the node holds after the operation is
+ * 			stored back into data. UPDATE_IF compares against expected.
+ *
+ * 			Depending on the size of the batch and on how long the recent
+ * 			ops on the list took, the ops run one after the other in the
+ * 			calling thread, on the executor's workers or on a thread each,
+ * 			which the ops of a batch cannot tell apart.
+ *
  * output		: N/A.
  *
  * return value	: 0 in case of success or anything else in case of failure.
@@ -584,20 +4746,490 @@ void* batch_wrapper(void* param){
 void list_batch(linked_list_t* list, int num_ops, op_t* ops){
 	if (!list || num_ops<=0 || !ops)
 		return;
+	op_begin(LIST_OP_BATCH, num_ops);
+	int strategy = batch_strategy(list, num_ops);
+	list_ticket_t* ticket;
+	if(strategy == BATCH_POOL && ticket_submit(list, num_ops, ops, NULL, NULL, &ticket) == SUCCES){
+		list_batch_wait(ticket);
+		op_return_void(list);
+	}
+	batch_local(list, num_ops, ops, strategy == BATCH_FAN_OUT);	// or the pool
+	op_return_void(list);										// could not take it
+}
+
+/**
+ * ticket_complete : finishes a submitted batch once all of its ops are done:
+ * logs it as a single record, then wakes its waiter or runs its callback.
+ */
+static void ticket_complete(list_ticket_t* ticket){
 	int i;
-	pthread_t threads[num_ops];
-	op_wrapper* wrappers[num_ops];
-	for(i=0;i<num_ops;i++){
-		wrappers[i]=(op_wrapper*)malloc(sizeof(op_wrapper));
-		if (!wrappers[i])
-			return;
-		wrappers[i]->list= list;
-		wrappers[i]->op=&(ops[i]);
-		pthread_create(&(threads[i]), NULL, batch_wrapper, (void*)(wrappers[i]));
+	if(ticket->list_->wal_)
+		batch_commit(ticket->list_->wal_, ticket->num_ops_, ticket->wrappers_);
+	for(i=0;i<ticket->num_ops_;i++)
+		free(ticket->wrappers_[i].wal.data_);
+	if(ticket->callback_){
+		ticket->callback_(ticket->ops_, ticket->num_ops_, ticket->arg_);
+		pthread_mutex_destroy(&(ticket->lock_));
+		pthread_cond_destroy(&(ticket->cond_));
+		free(ticket);
+		return;
 	}
+	pthread_mutex_lock(&(ticket->lock_));
+	__atomic_store_n(&(ticket->done_), 1, __ATOMIC_RELEASE);
+	pthread_cond_broadcast(&(ticket->cond_));
+	pthread_mutex_unlock(&(ticket->lock_));
+}
+
+static void* executor_worker(void* param){
+	executor* exec = (executor*) param;
+	op_wrapper* task;
+	tls_executor_worker = 1;
+	tls_batch_thread = 1;
+	while(1){
+		pthread_mutex_lock(&(exec->lock_));
+		while(!exec->head_)
+			pthread_cond_wait(&(exec->cond_), &(exec->lock_));
+		task = exec->head_;
+		exec->head_ = task->next;
+		if(!exec->head_)
+			exec->tail_ = NULL;
+		pthread_mutex_unlock(&(exec->lock_));
+		batch_wrapper(task);
+		if(!__atomic_sub_fetch(&(task->ticket->pending_), 1, __ATOMIC_ACQ_REL))
+			ticket_complete(task->ticket);
+	}
+	return NULL;
+}
+
+static void executor_start(){
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int i;
+	pthread_t thread;
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	for(i=0;i<(cpus > 2 ? cpus : 2);i++)	// two at least, so a slow op never
+		if(!pthread_create(&thread, &attr, executor_worker, &g_executor))
+			g_executor.workers_++;			// holds up a whole batch alone
+	pthread_attr_destroy(&attr);
+}
+
+/**
+ * ticket_submit : creates the ticket of a batch and queues its ops.
+ */
+static int ticket_submit(linked_list list, int num_ops, op_t* ops,
+						 list_batch_callback callback, void* arg,
+						 list_ticket_t** out){
+	int i;
+	pthread_once(&g_executor_once, executor_start);
+	if(!g_executor.workers_)
+		return ALLOC_ERROR;
+	list_ticket_t* ticket = (list_ticket_t*) calloc(1, sizeof(*ticket) +
+											sizeof(op_wrapper) * num_ops);
+	if(!ticket)
+		return ALLOC_ERROR;
+	ticket->list_ = list;
+	ticket->ops_ = ops;
+	ticket->num_ops_ = num_ops;
+	ticket->callback_ = callback;
+	ticket->arg_ = arg;
+	pthread_mutex_init(&(ticket->lock_), NULL);
+	pthread_cond_init(&(ticket->cond_), NULL);
 	for(i=0;i<num_ops;i++){
-		pthread_join(threads[i], NULL);
-		free(wrappers[i]);
+		ticket->wrappers_[i].list = list;
+		ticket->wrappers_[i].op = &ops[i];
+		ticket->wrappers_[i].ticket = ticket;
+	}
+	op_wrapper *first = batch_group(list, num_ops, ticket->wrappers_), *last;
+	for(last=first;;last=last->next){
+		ticket->pending_++;
+		if(!last->next)
+			break;
+	}
+	if(out)
+		*out = ticket;	// before the batch may complete
+	pthread_mutex_lock(&(g_executor.lock_));
+	if(g_executor.tail_)
+		g_executor.tail_->next = first;
+	else
+		g_executor.head_ = first;
+	g_executor.tail_ = last;
+	if(ticket->pending_ == 1)
+		pthread_cond_signal(&(g_executor.cond_));
+	else
+		pthread_cond_broadcast(&(g_executor.cond_));
+	pthread_mutex_unlock(&(g_executor.lock_));
+	return SUCCES;
+}
+
+/**
+ * list_batch_submit : Hands a batch over to the library's executor and
+ * returns right away. The ops run as in list_batch, on the executor's worker
+ * threads. ops must stay valid until the batch is done.
+ *
+ * input		: list 		- the given list.
+ * 				: ops 		- the batch, as for list_batch.
+ * 				: num_ops 	- the number of operations in the batch.
+ *
+ * output		: ticket 	- the ticket to poll or wait for the batch with.
+ * 							  It must be released by list_batch_wait.
+ *
+ * return value	: 0 in case of success or anything else in case of failure.
+ */
+int list_batch_submit(linked_list_t* list, op_t* ops, int num_ops, list_ticket_t** ticket){
+	if (!list || !ops || num_ops <= 0 || !ticket)	return PARAM_ERROR;
+	return ticket_submit(list, num_ops, ops, NULL, NULL, ticket);
+}
+
+/**
+ * list_batch_submit_cb : Like list_batch_submit, but instead of a ticket the
+ * given callback is called with the batch once it is done, on a worker
+ * thread. The callback must not wait for other batches.
+ *
+ * input		: list 		- the given list.
+ * 				: ops 		- the batch, as for list_batch.
+ * 				: num_ops 	- the number of operations in the batch.
+ * 				: callback 	- called with ops, num_ops and arg when done.
+ * 				: arg 		- passed to the callback.
+ *
+ * output		: N/A
+ *
+ * return value	: 0 in case of success or anything else in case of failure.
+ */
+int list_batch_submit_cb(linked_list_t* list, op_t* ops, int num_ops,
+						 list_batch_callback callback, void* arg){
+	if (!list || !ops || num_ops <= 0 || !callback)	return PARAM_ERROR;
+	return ticket_submit(list, num_ops, ops, callback, arg, NULL);
+}
+
+/**
+ * list_batch_poll : Checks whether a submitted batch is done, without
+ * blocking. The ticket must still be released with list_batch_wait.
+ *
+ * input		: ticket - the ticket of the batch.
+ *
+ * output		: N/A
+ *
+ * return value	: 1 if the batch is done, 0 if it is still running or a
+ * 				  negative value in case of failure.
+ */
+int list_batch_poll(list_ticket_t* ticket){
+	if (!ticket)	return PARAM_ERROR;
+	return __atomic_load_n(&(ticket->done_), __ATOMIC_ACQUIRE) ? VALUE_FOUND : VALUE_NOT_FOUND;
+}
+
+/**
+ * list_batch_wait : Waits for a submitted batch to be done and releases its
+ * ticket. The results are then in the batch's ops.
+ *
+ * input		: ticket - the ticket of the batch.
+ *
+ * output		: N/A
+ *
+ * return value	: 0 in case of success or anything else in case of failure.
+ */
+int list_batch_wait(list_ticket_t* ticket){
+	if (!ticket)	return PARAM_ERROR;
+	pthread_mutex_lock(&(ticket->lock_));
+	while(!ticket->done_)
+		pthread_cond_wait(&(ticket->cond_), &(ticket->lock_));
+	pthread_mutex_unlock(&(ticket->lock_));
+	pthread_mutex_destroy(&(ticket->lock_));
+	pthread_cond_destroy(&(ticket->cond_));
+	free(ticket);
+	return SUCCES;
+}
+
+/*
+ * list_batch_multi splits the batches of several lists into tasks of a few
+ * ops of a single list and runs them on a second pool of workers, one per
+ * core and pinned to it. Every worker owns a deque: it takes its own tasks
+ * from the bottom and, once out of them, steals the oldest tasks of the
+ * others from the top, so a list with more ops than the rest is worked on by
+ * every idle core instead of by one. The calling thread steals as well until
+ * no task is left, which keeps nested calls from waiting on a busy pool.
+ */
+
+/**
+ * steal_task_t : ops of a single list, few enough to run as an inline batch.
+ */
+typedef struct steal_task_t{
+	linked_list 			list_;
+	op_t* 					ops_;
+	int 					num_ops_;
+	struct steal_job_t* 	job_;
+	struct steal_task_t* 	prev_;	// towards the top of the deque
+	struct steal_task_t* 	next_;	// towards the bottom of the deque
+} steal_task;
+
+/**
+ * steal_job_t : a list_batch_multi call, done once all of its tasks are.
+ */
+typedef struct steal_job_t{
+	int 			pending_;	// tasks not done yet
+	int 			done_;
+	pthread_mutex_t lock_;
+	pthread_cond_t 	cond_;
+} steal_job;
+
+/**
+ * steal_deque_t : the tasks of a worker of the stealer.
+ */
+typedef struct steal_deque_t{
+	pthread_mutex_t lock_;
+	steal_task* 	top_;
+	steal_task* 	bottom_;
+	int 			count_;		// read without the lock to skip empty deques
+	int 			cpu_;		// the worker is pinned to, -1 if none
+} __attribute__((aligned(64))) steal_deque;
+
+/**
+ * stealer_t : the pool of list_batch_multi, started on its first call and
+ * kept for the life of the process.
+ */
+typedef struct stealer_t{
+	pthread_mutex_t lock_;		// idle workers wait on cond_ under it
+	pthread_cond_t 	cond_;
+	int 			queued_;	// tasks in the deques
+	int 			num_deques_;
+	steal_deque* 	deques_;
+} stealer;
+
+static stealer 			g_stealer = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+									  0, 0, NULL };
+static pthread_once_t 	g_stealer_once = PTHREAD_ONCE_INIT;
+
+/**
+ * steal_push : adds a task at the bottom of a deque.
+ */
+static void steal_push(steal_deque* deque, steal_task* task){
+	pthread_mutex_lock(&(deque->lock_));
+	task->prev_ = deque->bottom_;
+	task->next_ = NULL;
+	if(deque->bottom_)
+		deque->bottom_->next_ = task;
+	else
+		deque->top_ = task;
+	deque->bottom_ = task;
+	__atomic_store_n(&(deque->count_), deque->count_ + 1, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&(deque->lock_));
+}
+
+/**
+ * steal_pop : takes a task off a deque, the newest one for its owner and the
+ * oldest one for anybody else.
+ */
+static steal_task* steal_pop(steal_deque* deque, int owner){
+	steal_task* task;
+	if(!__atomic_load_n(&(deque->count_), __ATOMIC_RELAXED))
+		return NULL;
+	pthread_mutex_lock(&(deque->lock_));
+	task = owner ? deque->bottom_ : deque->top_;
+	if(task){
+		if(task->prev_)
+			task->prev_->next_ = task->next_;
+		else
+			deque->top_ = task->next_;
+		if(task->next_)
+			task->next_->prev_ = task->prev_;
+		else
+			deque->bottom_ = task->prev_;
+		__atomic_store_n(&(deque->count_), deque->count_ - 1, __ATOMIC_RELAXED);
+		__atomic_sub_fetch(&(g_stealer.queued_), 1, __ATOMIC_RELAXED);
+	}
+	pthread_mutex_unlock(&(deque->lock_));
+	return task;
+}
+
+/**
+ * steal_take : takes a task for the worker of the given deque, from its own
+ * deque first and then from the others in turn. Threads of no deque pass -1.
+ */
+static steal_task* steal_take(int own){
+	steal_task* task;
+	int i, n = g_stealer.num_deques_;
+	if(own >= 0 && (task = steal_pop(&(g_stealer.deques_[own]), 1)))
+		return task;
+	for(i=1;i<=n;i++)
+		if((task = steal_pop(&(g_stealer.deques_[(own + i) % n]), 0)))
+			return task;
+	return NULL;
+}
+
+/**
+ * steal_batch : runs the ops of a task as an inline batch of its list.
+ */
+static void steal_batch(linked_list list, int num_ops, op_t* ops){
+	op_begin(LIST_OP_BATCH, num_ops);
+	batch_local(list, num_ops, ops, 0);
+	op_return_void(list);
+}
+
+/**
+ * steal_run : runs a task, completing its job if it was the last one.
+ */
+static void steal_run(steal_task* task){
+	steal_job* job = task->job_;
+	steal_batch(task->list_, task->num_ops_, task->ops_);
+	if(__atomic_sub_fetch(&(job->pending_), 1, __ATOMIC_ACQ_REL))
+		return;
+	pthread_mutex_lock(&(job->lock_));
+	job->done_ = 1;
+	pthread_cond_broadcast(&(job->cond_));
+	pthread_mutex_unlock(&(job->lock_));
+}
+
+/**
+ * steal_pin : pins the calling thread to a single CPU.
+ */
+static void steal_pin(int cpu){
+	cpu_set_t set;
+	if(cpu < 0)
+		return;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	sched_setaffinity(0, sizeof(cpu_set_t), &set);
+}
+
+static void* steal_worker(void* param){
+	int own = (int)(long)param;
+	steal_task* task;
+	tls_batch_thread = 1;
+	steal_pin(g_stealer.deques_[own].cpu_);
+	while(1){
+		if((task = steal_take(own))){
+			steal_run(task);
+			numa_pin(-1);				// the list of the task may have moved it
+			continue;
+		}
+		pthread_mutex_lock(&(g_stealer.lock_));
+		while(__atomic_load_n(&(g_stealer.queued_), __ATOMIC_RELAXED) <= 0)
+			pthread_cond_wait(&(g_stealer.cond_), &(g_stealer.lock_));
+		pthread_mutex_unlock(&(g_stealer.lock_));
+	}
+	return NULL;
+}
+
+static void steal_start(){
+	cpu_set_t cpus;
+	int i, cpu = 0, n = 1, pinned = !sched_getaffinity(0, sizeof(cpu_set_t), &cpus);
+	pthread_t thread;
+	pthread_attr_t attr;
+	if(pinned && CPU_COUNT(&cpus) > 1)
+		n = CPU_COUNT(&cpus);
+	steal_deque* deques;
+	if(posix_memalign((void**)&deques, 64, n * sizeof(steal_deque)))
+		return;				// list_batch_multi runs its tasks itself
+	memset(deques, 0, n * sizeof(steal_deque));
+	for(i=0;i<n;i++){
+		pthread_mutex_init(&(deques[i].lock_), NULL);
+		while(pinned && cpu < CPU_SETSIZE && !CPU_ISSET(cpu, &cpus))
+			cpu++;
+		deques[i].cpu_ = pinned && cpu < CPU_SETSIZE ? cpu++ : -1;
 	}
+	g_stealer.deques_ = deques;
+	g_stealer.num_deques_ = n;
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	for(i=0;i<n;i++)		// a deque left without a worker is stolen from
+		pthread_create(&thread, &attr, steal_worker, (void*)(long)i);
+	pthread_attr_destroy(&attr);
+}
+
+/**
+ * steal_ops : the number of ops of a list that make up a task, about as many
+ * as a batch that list_batch would run inline.
+ */
+static int steal_ops(linked_list list){
+	unsigned long long per_op = __atomic_load_n(&(list->batch_ns_), __ATOMIC_RELAXED);
+	unsigned long long ops = per_op ? BATCH_INLINE_NS / per_op : BATCH_LOCAL_OPS;
+	return ops < 1 ? 1 : (ops > BATCH_LOCAL_OPS ? BATCH_LOCAL_OPS : (int)ops);
 }
 
+/**
+ * list_batch_multi : Performs a batch on each of several lists, such as the
+ * lists of list_split, balancing the ops of all of them over the cores. The
+ * ops of a list run as in list_batch, split into inline batches of a few ops
+ * each, which the pool's workers steal from each other, so one list with
+ * most of the ops does not leave the other cores idle. Each of these small
+ * batches is a record of its own in the log of its list.
+ *
+ * input		: lists 	- the given lists.
+ * 				: n 		- the number of lists.
+ * 				: ops 		- ops[i] is the batch of lists[i], as for
+ * 							  list_batch. It may be NULL if counts[i] is 0.
+ * 				: counts 	- counts[i] is the number of ops in ops[i].
+ *
+ * output		: N/A
+ *
+ * return value	: 0 in case of success or anything else in case of failure.
+ */
+int list_batch_multi(linked_list_t** lists, int n, op_t** ops, int* counts){
+	int i, j, tasks = 0, size, *per_task;
+	size_t offset;
+	char *block, *more;
+	steal_job job;
+	steal_task *all, *task;
+	if (!lists || n <= 0 || !ops || !counts)	return PARAM_ERROR;
+	for(i=0;i<n;i++)
+		if(counts[i] < 0 || (counts[i] && (!lists[i] || !ops[i])))
+			return PARAM_ERROR;
+	block = (char*) malloc(sizeof(int) * n);		// the tasks follow once counted
+	if(!block)
+		return ALLOC_ERROR;
+	per_task = (int*) block;
+	for(i=0;i<n;i++){
+		per_task[i] = counts[i] ? steal_ops(lists[i]) : 1;
+		tasks += (counts[i] + per_task[i] - 1) / per_task[i];
+	}
+	if(!tasks){
+		free(block);
+		return SUCCES;
+	}
+	offset = align8(sizeof(int) * n);
+	more = (char*) realloc(block, offset + sizeof(steal_task) * tasks);
+	if(!more){
+		free(block);
+		return ALLOC_ERROR;
+	}
+	block = more;
+	per_task = (int*) block;
+	all = (steal_task*) (block + offset);
+	memset(all, 0, sizeof(steal_task) * tasks);
+	job.pending_ = tasks;
+	job.done_ = 0;
+	pthread_mutex_init(&(job.lock_), NULL);
+	pthread_cond_init(&(job.cond_), NULL);
+	for(i=0, task=all;i<n;i++)
+		for(j=0;j<counts[i];j+=size, task++){
+			size = counts[i] - j < per_task[i] ? counts[i] - j : per_task[i];
+			task->list_ = lists[i];
+			task->ops_ = ops[i] + j;
+			task->num_ops_ = size;
+			task->job_ = &job;
+		}
+	pthread_once(&g_stealer_once, steal_start);
+	if(!g_stealer.num_deques_){
+		for(i=0;i<tasks;i++)
+			steal_run(&all[i]);
+	}
+	else{
+		pthread_mutex_lock(&(g_stealer.lock_));	// pops may run ahead of queued_,
+		for(i=0, task=all;i<n;i++)				// not the sleepers
+			for(j=0;j<counts[i];j+=per_task[i], task++)
+				steal_push(&(g_stealer.deques_[i % g_stealer.num_deques_]), task);
+		__atomic_add_fetch(&(g_stealer.queued_), tasks, __ATOMIC_RELAXED);
+		pthread_cond_broadcast(&(g_stealer.cond_));
+		pthread_mutex_unlock(&(g_stealer.lock_));
+		while((task = steal_take(-1)))
+			steal_run(task);
+	}
+	pthread_mutex_lock(&(job.lock_));
+	while(!job.done_)
+		pthread_cond_wait(&(job.cond_), &(job.lock_));
+	pthread_mutex_unlock(&(job.lock_));
+	pthread_mutex_destroy(&(job.lock_));
+	pthread_cond_destroy(&(job.cond_));
+	free(block);
+	return SUCCES;
+}
@@ -1,28 +1,106 @@
 #ifndef __MYLIST_H_
 #define __MYLIST_H_
 
+#include <stddef.h>
+
 struct linked_list_t;
 typedef struct linked_list_t linked_list_t;
 
+struct timespec;
+
+struct list_ticket_t;
+typedef struct list_ticket_t list_ticket_t;
+
 typedef struct op_t
 {
 	int key;
 	void* data;
-	enum {INSERT, REMOVE, CONTAINS, UPDATE, COMPUTE} op;
+	enum {INSERT, REMOVE, CONTAINS, UPDATE, COMPUTE,
+		  UPSERT, UPDATE_IF, GET_OR_INSERT} op;
 	int (*compute_func) (void *);
 	int result;
+	void* expected;
 } op_t;
 
+typedef void (*list_batch_callback) (op_t* ops, int num_ops, void* arg);
+
+enum { LIST_BACKEND_LIST, LIST_BACKEND_SKIPLIST, LIST_BACKEND_BLINK, LIST_BACKENDS };
+
+enum { LIST_OPT_COMBINING, LIST_OPT_ELIMINATION, LIST_OPT_NUMA_NODE, LIST_OPT_PREFETCH,
+	   LIST_OPT_MEMOIZE, LIST_OPT_EXCLUSIVE_COMPUTE, LIST_OPTIONS };
+
+#define LIST_STATS_BUCKETS	32
+
+enum { LIST_LOCK_NODE, LIST_LOCK_DATA, LIST_LOCK_MAIN, LIST_LOCK_CLASSES };
+
+enum { LIST_OP_INSERT, LIST_OP_REMOVE, LIST_OP_FIND, LIST_OP_SIZE, LIST_OP_UPDATE,
+	   LIST_OP_COMPUTE, LIST_OP_UPSERT, LIST_OP_UPDATE_IF, LIST_OP_GET_OR_INSERT,
+	   LIST_OP_BATCH, LIST_OP_KINDS };
+
+/* Statistics gathered when my_list.c is built with -DLIST_STATS. Bucket i of
+ * every histogram counts values v with 2^(i-1) <= v < 2^i (bucket 0 is v = 0),
+ * latencies and wait times are in nanoseconds. */
+typedef struct list_stats_t
+{
+	unsigned long long ops[LIST_OP_KINDS];
+	unsigned long long op_errors[LIST_OP_KINDS];	/* calls returning < 0 */
+	unsigned long long op_ns[LIST_OP_KINDS];
+	unsigned long long op_latency_hist[LIST_OP_KINDS][LIST_STATS_BUCKETS];
+	unsigned long long traversal_hist[LIST_STATS_BUCKETS];	/* nodes per walk */
+	unsigned long long lock_acquires[LIST_LOCK_CLASSES];
+	unsigned long long lock_contended[LIST_LOCK_CLASSES];
+	unsigned long long lock_wait_ns[LIST_LOCK_CLASSES];
+	unsigned long long lock_wait_hist[LIST_LOCK_CLASSES][LIST_STATS_BUCKETS];
+} list_stats_t;
+
 linked_list_t* list_alloc();
+linked_list_t* list_alloc_backend(int backend);
 void list_free(linked_list_t* list);
+linked_list_t* list_open_shared(const char* name, size_t data_size, size_t capacity);
+int list_unlink_shared(const char* name);
 int list_split(linked_list_t* list, int n, linked_list_t** arr);
 int list_insert(linked_list_t* list, int key, void* data);
 int list_remove(linked_list_t* list, int key);
 int list_find(linked_list_t* list, int key);
 int list_size(linked_list_t* list);
+int list_export(linked_list_t* list, int* keys, void** data, int cap);
+int list_export_alloc(linked_list_t* list, int** keys, void*** data);
 int list_update(linked_list_t* list, int key, void* data);
 int list_compute(linked_list_t* list, int key, 
 						int (*compute_func) (void *), int* result);
+int list_upsert(linked_list_t* list, int key, void* data);
+int list_update_if(linked_list_t* list, int key, void* expected, void* data);
+int list_get_or_insert(linked_list_t* list, int key, void* data, void** result);
+int list_insert_timed(linked_list_t* list, int key, void* data,
+					  const struct timespec* deadline);
+int list_remove_timed(linked_list_t* list, int key, const struct timespec* deadline);
+int list_find_timed(linked_list_t* list, int key, const struct timespec* deadline);
+int list_update_timed(linked_list_t* list, int key, void* data,
+					  const struct timespec* deadline);
+int list_compute_timed(linked_list_t* list, int key, int (*compute_func) (void *),
+					   int* result, const struct timespec* deadline);
+int list_try_insert(linked_list_t* list, int key, void* data);
+int list_try_remove(linked_list_t* list, int key);
+int list_try_find(linked_list_t* list, int key);
+int list_try_update(linked_list_t* list, int key, void* data);
+int list_try_compute(linked_list_t* list, int key, int (*compute_func) (void *),
+					 int* result);
 void list_batch(linked_list_t* list, int num_ops, op_t* ops);
+void list_synchronize();
+int list_set_option(linked_list_t* list, int option, long value);
+int list_compact(linked_list_t* list);
+int list_batch_submit(linked_list_t* list, op_t* ops, int num_ops, list_ticket_t** ticket);
+int list_batch_submit_cb(linked_list_t* list, op_t* ops, int num_ops,
+						 list_batch_callback callback, void* arg);
+int list_batch_poll(list_ticket_t* ticket);
+int list_batch_wait(list_ticket_t* ticket);
+int list_batch_multi(linked_list_t** lists, int n, op_t** ops, int* counts);
+int list_stats(linked_list_t* list, list_stats_t* out);
+int list_trace_dump(const char* path);
+int list_save(linked_list_t* list, const char* path, size_t data_size);
+linked_list_t* list_load(const char* path);
+int list_wal_attach(linked_list_t* list, const char* path, size_t data_size);
+int list_checkpoint(linked_list_t* list, const char* path);
+linked_list_t* list_recover(const char* snapshot, const char* path, size_t data_size);
 
 #endif /* __MYLIST_ */
\ No newline at end of file
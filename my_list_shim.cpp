@@ -0,0 +1,356 @@
+// my_list.h on top of ConcurrentSortedList<int, void*>, for C code that wants
+// the template's algorithms without changing. Link it instead of my_list.c:
+//
+// build : g++ -std=c++11 -O2 -c my_list_shim.cpp
+//         gcc -std=c99 -O2 -o test HW3_Sequential_Test_A.c my_list_shim.o -lstdc++ -lpthread
+//
+// Only the list itself is provided. Stats, traces, snapshots, compaction,
+// deadlines, shared lists and the write-ahead log are features of my_list.c,
+// their calls fail here with DISABLED_ERROR. list_batch runs its ops one
+// after the other instead of on a thread each, which the ops of a batch
+// cannot tell apart, and a submitted batch runs the same way before
+// list_batch_submit returns. list_batch_multi runs the batches of its lists
+// one list after the other. Unlike my_list.c, list_free and list_split free
+// the list right away: no other call may run on it at the same time or come
+// after, there is no LIST_FREE_ERROR for them here.
+
+#include <new>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "concurrent_sorted_list.hpp"
+
+extern "C" {
+#include "my_list.h"
+}
+
+// result codes of my_list.c
+#define SUCCES			0
+#define PARAM_ERROR 	-1
+#define ALLOC_ERROR 	-2
+#define INSERT_ERROR	-3
+#define REMOVE_ERROR	-4
+#define NOT_EX_ERROR	-5
+#define MISMATCH_ERROR	-7
+#define DISABLED_ERROR	-11
+#define VALUE_FOUND 	1
+#define VALUE_NOT_FOUND	0
+
+typedef ConcurrentSortedList<int, void*> int_list;
+
+struct linked_list_t{
+  int_list list;
+};
+
+struct list_ticket_t{
+};
+
+extern "C" {
+
+linked_list_t* list_alloc(){
+  return new (std::nothrow) linked_list_t;
+}
+
+// the template is the plain list only
+linked_list_t* list_alloc_backend(int backend){
+  return backend == LIST_BACKEND_LIST ? list_alloc() : nullptr;
+}
+
+// must not race with other calls on the list, see above
+void list_free(linked_list_t* list){
+  delete list;
+}
+
+linked_list_t* list_open_shared(const char*, size_t, size_t){
+  return nullptr;
+}
+
+int list_unlink_shared(const char* name){
+  return name ? DISABLED_ERROR : PARAM_ERROR;
+}
+
+int list_split(linked_list_t* list, int n, linked_list_t** arr){
+  if(!list || !arr || n <= 0) return PARAM_ERROR;
+  std::vector<int_list*> lists(n);
+  for(int i = 0 ; i < n ; i++){
+    arr[i] = list_alloc();
+    if(!arr[i]){
+      for( ; i >= 0 ; i--)
+        list_free(arr[i]);
+      return ALLOC_ERROR;
+    }
+    lists[i] = &(arr[i]->list);
+  }
+  list->list.splitInto(lists.data(), n);
+  delete list;
+  return SUCCES;
+}
+
+int list_insert(linked_list_t* list, int key, void* data){
+  if(!list) return PARAM_ERROR;
+  try{
+    return list->list.insert(key, data) ? SUCCES : INSERT_ERROR;
+  }
+  catch(const std::bad_alloc&){
+    return ALLOC_ERROR;
+  }
+}
+
+int list_remove(linked_list_t* list, int key){
+  if(!list) return PARAM_ERROR;
+  return list->list.remove(key) ? SUCCES : REMOVE_ERROR;
+}
+
+int list_find(linked_list_t* list, int key){
+  if(!list) return PARAM_ERROR;
+  return list->list.contains(key) ? VALUE_FOUND : VALUE_NOT_FOUND;
+}
+
+int list_size(linked_list_t* list){
+  if(!list) return PARAM_ERROR;
+  return (int)list->list.size();
+}
+
+// walks hand-over-hand, so unlike my_list.c the arrays are not a snapshot of
+// the list at a single point in time
+int list_export(linked_list_t* list, int* keys, void** data, int cap){
+  if(!list || cap < 0) return PARAM_ERROR;
+  int count = 0;
+  list->list.forEach([&](const int& key, void*& value){
+    if(count < cap){
+      if(keys) keys[count] = key;
+      if(data) data[count] = value;
+    }
+    count++;
+  });
+  return count;
+}
+
+int list_export_alloc(linked_list_t* list, int** keys, void*** data){
+  if(!list) return PARAM_ERROR;
+  std::vector<int> all_keys;
+  std::vector<void*> all_data;
+  bool failed = false;
+  list->list.forEach([&](const int& key, void*& value){
+    if(failed) return;
+    try{                            // not thrown through the locks of the walk
+      all_keys.push_back(key);
+      all_data.push_back(value);
+    }
+    catch(const std::bad_alloc&){
+      failed = true;
+    }
+  });
+  if(failed) return ALLOC_ERROR;
+  size_t count = all_keys.size();
+  int* out_keys = count ? (int*)malloc(sizeof(int) * count) : nullptr;
+  void** out_data = count ? (void**)malloc(sizeof(void*) * count) : nullptr;
+  if(count && (!out_keys || !out_data)){
+    free(out_keys);
+    free(out_data);
+    return ALLOC_ERROR;
+  }
+  if(count){
+    memcpy(out_keys, all_keys.data(), sizeof(int) * count);
+    memcpy(out_data, all_data.data(), sizeof(void*) * count);
+  }
+  if(keys) *keys = out_keys; else free(out_keys);
+  if(data) *data = out_data; else free(out_data);
+  return (int)count;
+}
+
+int list_update(linked_list_t* list, int key, void* data){
+  if(!list || !data) return PARAM_ERROR;
+  return list->list.update(key, data) ? SUCCES : NOT_EX_ERROR;
+}
+
+int list_compute(linked_list_t* list, int key, int (*compute_func) (void *), int* result){
+  if(!list || !compute_func || !result) return PARAM_ERROR;
+  bool found = list->list.compute(key, [=](void* data){ *result = compute_func(data); });
+  return found ? SUCCES : NOT_EX_ERROR;
+}
+
+int list_upsert(linked_list_t* list, int key, void* data){
+  if(!list || !data) return PARAM_ERROR;
+  try{
+    return list->list.upsert(key, data) ? SUCCES : VALUE_FOUND;
+  }
+  catch(const std::bad_alloc&){
+    return ALLOC_ERROR;
+  }
+}
+
+int list_update_if(linked_list_t* list, int key, void* expected, void* data){
+  if(!list || !data) return PARAM_ERROR;
+  switch(list->list.updateIf(key, expected, data)){
+    case UpdateResult::UPDATED: return SUCCES;
+    case UpdateResult::MISMATCH: return MISMATCH_ERROR;
+    default: return NOT_EX_ERROR;
+  }
+}
+
+int list_get_or_insert(linked_list_t* list, int key, void* data, void** result){
+  if(!list) return PARAM_ERROR;
+  try{
+    return list->list.getOrInsert(key, data, result) ? SUCCES : VALUE_FOUND;
+  }
+  catch(const std::bad_alloc&){
+    return ALLOC_ERROR;
+  }
+}
+
+// the template only has blocking locks
+int list_insert_timed(linked_list_t* list, int, void*, const struct timespec*){
+  return list ? DISABLED_ERROR : PARAM_ERROR;
+}
+
+int list_remove_timed(linked_list_t* list, int, const struct timespec*){
+  return list ? DISABLED_ERROR : PARAM_ERROR;
+}
+
+int list_find_timed(linked_list_t* list, int, const struct timespec*){
+  return list ? DISABLED_ERROR : PARAM_ERROR;
+}
+
+int list_update_timed(linked_list_t* list, int, void* data, const struct timespec*){
+  return list && data ? DISABLED_ERROR : PARAM_ERROR;
+}
+
+int list_compute_timed(linked_list_t* list, int, int (*compute_func) (void *), int* result,
+                       const struct timespec*){
+  return list && compute_func && result ? DISABLED_ERROR : PARAM_ERROR;
+}
+
+int list_try_insert(linked_list_t* list, int key, void* data){
+  return list_insert_timed(list, key, data, nullptr);
+}
+
+int list_try_remove(linked_list_t* list, int key){
+  return list_remove_timed(list, key, nullptr);
+}
+
+int list_try_find(linked_list_t* list, int key){
+  return list_find_timed(list, key, nullptr);
+}
+
+int list_try_update(linked_list_t* list, int key, void* data){
+  return list_update_timed(list, key, data, nullptr);
+}
+
+int list_try_compute(linked_list_t* list, int key, int (*compute_func) (void *), int* result){
+  return list_compute_timed(list, key, compute_func, result, nullptr);
+}
+
+void list_batch(linked_list_t* list, int num_ops, op_t* ops){
+  if(!list || num_ops <= 0 || !ops) return;
+  for(int i = 0 ; i < num_ops ; i++){
+    op_t* op = &ops[i];
+    int res;
+    switch(op->op){
+      case op_t::INSERT: op->result = list_insert(list, op->key, op->data); break;
+      case op_t::REMOVE: op->result = list_remove(list, op->key); break;
+      case op_t::CONTAINS: op->result = list_find(list, op->key); break;
+      case op_t::UPDATE: op->result = list_update(list, op->key, op->data); break;
+      case op_t::COMPUTE:
+        op->result = list_compute(list, op->key, op->compute_func, &res);
+        op->data = (void*)(long long)res;
+        break;
+      case op_t::UPSERT: op->result = list_upsert(list, op->key, op->data); break;
+      case op_t::UPDATE_IF:
+        op->result = list_update_if(list, op->key, op->expected, op->data);
+        break;
+      case op_t::GET_OR_INSERT:
+        op->result = list_get_or_insert(list, op->key, op->data, &(op->data));
+        break;
+    }
+  }
+}
+
+// a removed node goes once the computes on it return, with no reader left
+// to wait for
+void list_synchronize(){
+}
+
+// the template has no flat-combining mode, batch elimination, NUMA placement
+// or memoized computes, its computes are always exclusive, and prefetching is
+// only a hint
+int list_set_option(linked_list_t* list, int option, long value){
+  if(!list || option < 0 || option >= LIST_OPTIONS) return PARAM_ERROR;
+  if(option == LIST_OPT_PREFETCH) return value >= 0 && value <= 2 ? SUCCES : PARAM_ERROR;
+  bool off = option == LIST_OPT_NUMA_NODE ? value == -1 :
+             option == LIST_OPT_EXCLUSIVE_COMPUTE ? value != 0 : !value;
+  return off ? SUCCES : DISABLED_ERROR;
+}
+
+int list_compact(linked_list_t* list){
+  return list ? DISABLED_ERROR : PARAM_ERROR;
+}
+
+int list_batch_submit(linked_list_t* list, op_t* ops, int num_ops, list_ticket_t** ticket){
+  if(!list || !ops || num_ops <= 0 || !ticket) return PARAM_ERROR;
+  *ticket = new (std::nothrow) list_ticket_t;
+  if(!*ticket) return ALLOC_ERROR;
+  list_batch(list, num_ops, ops);
+  return SUCCES;
+}
+
+int list_batch_submit_cb(linked_list_t* list, op_t* ops, int num_ops,
+                         list_batch_callback callback, void* arg){
+  if(!list || !ops || num_ops <= 0 || !callback) return PARAM_ERROR;
+  list_batch(list, num_ops, ops);
+  callback(ops, num_ops, arg);
+  return SUCCES;
+}
+
+int list_batch_poll(list_ticket_t* ticket){
+  return ticket ? VALUE_FOUND : PARAM_ERROR;
+}
+
+int list_batch_wait(list_ticket_t* ticket){
+  if(!ticket) return PARAM_ERROR;
+  delete ticket;
+  return SUCCES;
+}
+
+int list_batch_multi(linked_list_t** lists, int n, op_t** ops, int* counts){
+  if(!lists || n <= 0 || !ops || !counts) return PARAM_ERROR;
+  for(int i = 0 ; i < n ; i++)
+    if(counts[i] < 0 || (counts[i] && (!lists[i] || !ops[i]))) return PARAM_ERROR;
+  for(int i = 0 ; i < n ; i++)
+    if(counts[i])
+      list_batch(lists[i], counts[i], ops[i]);
+  return SUCCES;
+}
+
+int list_stats(linked_list_t* list, list_stats_t* out){
+  if(!list || !out) return PARAM_ERROR;
+  memset(out, 0, sizeof(*out));
+  return DISABLED_ERROR;
+}
+
+int list_trace_dump(const char*){
+  return DISABLED_ERROR;
+}
+
+int list_save(linked_list_t* list, const char* path, size_t){
+  return list && path ? DISABLED_ERROR : PARAM_ERROR;
+}
+
+linked_list_t* list_load(const char*){
+  return nullptr;
+}
+
+int list_wal_attach(linked_list_t* list, const char* path, size_t){
+  return list && path ? DISABLED_ERROR : PARAM_ERROR;
+}
+
+int list_checkpoint(linked_list_t* list, const char* path){
+  return list && path ? DISABLED_ERROR : PARAM_ERROR;
+}
+
+linked_list_t* list_recover(const char*, const char*, size_t){
+  return nullptr;
+}
+
+} // extern "C"